@@ -0,0 +1,152 @@
+/******************************************************/
+/*                                                    */
+/* arena.h - arrays whose elements don't move         */
+/*                                                    */
+/******************************************************/
+/* Copyright 2026 Pierre Abbat.
+ * This file is part of Bezitopo.
+ *
+ * Bezitopo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Bezitopo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License and Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * and Lesser General Public License along with Bezitopo. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+#include <vector>
+#include <new>
+#include <cstddef>
+#include <functional>
+#include <algorithm>
+#include <utility>
+
+#define ARENA_SHIFT 10
+#define ARENA_CHUNK (1<<ARENA_SHIFT)
+
+/* An Arena is an array whose elements never move once they're made, so
+ * pointers to them stay valid as it grows. It's stored in chunks of
+ * ARENA_CHUNK elements, so indexing takes constant time, unlike a map,
+ * and neighboring elements are next to each other in memory. Indexing
+ * past the end makes the array longer, as with the maps it replaces, so
+ * an element can be made by assigning to it.
+ */
+template <class T> class Arena
+{
+public:
+  Arena()
+  {
+    count=0;
+  }
+  Arena(const Arena &b)
+  {
+    int i;
+    count=0;
+    resize(b.count);
+    for (i=0;i<count;i++)
+      (*this)[i]=b[i];
+  }
+  ~Arena()
+  {
+    clear();
+  }
+  Arena &operator=(const Arena &b)
+  {
+    int i;
+    if (this!=&b)
+    {
+      clear();
+      resize(b.count);
+      for (i=0;i<count;i++)
+        (*this)[i]=b[i];
+    }
+    return *this;
+  }
+  T &operator[](int n)
+  {
+    if (n>=count)
+      resize(n+1);
+    return chunks[n>>ARENA_SHIFT][n&(ARENA_CHUNK-1)];
+  }
+  const T &operator[](int n) const
+  {
+    return chunks[n>>ARENA_SHIFT][n&(ARENA_CHUNK-1)];
+  }
+  size_t size() const
+  {
+    return count;
+  }
+  void resize(int n)
+  /* Shrinking destroys the elements past the end, but keeps their chunks
+   * for when the Arena grows again.
+   */
+  {
+    while ((chunks.size()<<ARENA_SHIFT)<n)
+    {
+      chunks.push_back(static_cast<T *>(::operator new(sizeof(T)*ARENA_CHUNK)));
+      byAddress.insert(std::upper_bound(byAddress.begin(),byAddress.end(),
+        std::make_pair((const T *)chunks.back(),0),lessAddress),
+        std::make_pair((const T *)chunks.back(),(int)chunks.size()-1));
+    }
+    for (;count<n;count++)
+      new(&chunks[count>>ARENA_SHIFT][count&(ARENA_CHUNK-1)]) T();
+    for (;count>n;count--)
+      chunks[(count-1)>>ARENA_SHIFT][(count-1)&(ARENA_CHUNK-1)].~T();
+  }
+  int find(const T *p) const
+  /* Returns the index of the element p points to, or -1 if it isn't here.
+   * Takes time logarithmic in the number of chunks, so that it can be used
+   * to key side tables by index.
+   */
+  {
+    int n=-1;
+    std::less<const T *> lt;
+    typename std::vector<std::pair<const T *,int> >::const_iterator it;
+    it=std::upper_bound(byAddress.begin(),byAddress.end(),std::make_pair(p,0),lessAddress);
+    if (it!=byAddress.begin())
+    {
+      --it;
+      if (lt(p,it->first+ARENA_CHUNK))
+        n=(it->second<<ARENA_SHIFT)+(p-it->first);
+    }
+    return (n<count)?n:-1;
+  }
+  void clear()
+  {
+    int i;
+    resize(0);
+    for (i=0;i<chunks.size();i++)
+      ::operator delete(chunks[i]);
+    chunks.clear();
+    byAddress.clear();
+  }
+  void swap(Arena &b)
+  {
+    int tmp;
+    chunks.swap(b.chunks);
+    byAddress.swap(b.byAddress);
+    tmp=count;
+    count=b.count;
+    b.count=tmp;
+  }
+private:
+  std::vector<T *> chunks;
+  std::vector<std::pair<const T *,int> > byAddress; // chunks sorted by address, with their numbers
+  int count;
+  static bool lessAddress(const std::pair<const T *,int> &a,const std::pair<const T *,int> &b)
+  {
+    return std::less<const T *>()(a.first,b.first);
+  }
+};
+
+#endif
@@ -60,16 +60,85 @@ double testfunc::operator()(double x)
 
 #endif
 
+TriangleCold::TriangleCold()
+{
+#ifndef FLATTRIANGLE
+  totcritpointcount=0;
+#endif
+  subdivided=false;
+}
+
+TriangleColdPtr::TriangleColdPtr()
+{
+  p=nullptr;
+}
+
+TriangleColdPtr::TriangleColdPtr(const TriangleColdPtr &b)
+{
+  p=b.p?new TriangleCold(*b.p):nullptr;
+}
+
+TriangleColdPtr &TriangleColdPtr::operator=(const TriangleColdPtr &b)
+{
+  if (this!=&b)
+  {
+    delete p;
+    p=b.p?new TriangleCold(*b.p):nullptr;
+  }
+  return *this;
+}
+
+TriangleColdPtr::~TriangleColdPtr()
+{
+  delete p;
+}
+
 triangle::triangle()
 {
   a=b=c=NULL;
   aneigh=bneigh=cneigh=NULL;
   peri=sarea=0;
-  memset(gradmat,0,sizeof(gradmat));
+  localMark=0;
 #ifndef FLATTRIANGLE
   memset(ctrl,0,sizeof(ctrl));
   nocubedir=INT_MAX;
-  totcritpointcount=0;
+#endif
+}
+
+TriangleCold &triangle::coldData()
+{
+  if (!cold.p)
+    cold.p=new TriangleCold;
+  return *cold.p;
+}
+
+#ifndef FLATTRIANGLE
+const vector<xy> &triangle::critpoints() const
+{
+  static const vector<xy> none;
+  return cold.p?cold.p->critpoints:none;
+}
+#endif
+
+const vector<segment> &triangle::subdiv() const
+/* This and critpoints don't allocate the cold data, so that looking at a
+ * triangle that hasn't been contoured leaves it small. Only findcriticalpts
+ * and subdivide allocate it.
+ */
+{
+  static const vector<segment> none;
+  return cold.p?cold.p->subdiv:none;
+}
+
+void triangle::dropCold()
+/* Frees the critical points and subdivision. The triangle will have to be
+ * subdivided again before it can be contoured.
+ */
+{
+  delete cold.p;
+  cold.p=nullptr;
+#ifndef FLATTRIANGLE
+  nocubedir=INT_MAX;
 #endif
 }
 
@@ -122,6 +191,68 @@ double triangle::elevation(xy pnt)
 #endif
 }
 
+void triangle::elevations(const xy *pnts,double *elevs,int n)
+/* Computes the elevations at n points in the triangle. q and r are linear
+ * in the point's offset from a, so their coefficients are computed once,
+ * and the loop has no branches or calls, so the compiler can vectorize it.
+ * The result may differ from elevation() in the last few bits.
+ */
+{
+  int i;
+  double ax=a->getx(),ay=a->gety(),totarea,qx,qy,rx,ry;
+  double p,q,r,dx,dy;
+  totarea=2*area3(*a,*b,*c);
+  qx=(c->gety()-ay)/totarea;
+  qy=(ax-c->getx())/totarea;
+  rx=(ay-b->gety())/totarea;
+  ry=(b->getx()-ax)/totarea;
+#ifndef FLATTRIANGLE
+  double za=a->z,zb=b->z,zc=c->z;
+  double c0=3*ctrl[0],c1=3*ctrl[1],c2=3*ctrl[2],c3=6*ctrl[3],
+         c4=3*ctrl[4],c5=3*ctrl[5],c6=3*ctrl[6];
+#endif
+  for (i=0;i<n;i++)
+  {
+    dx=pnts[i].getx()-ax;
+    dy=pnts[i].gety()-ay;
+    q=qx*dx+qy*dy;
+    r=rx*dx+ry*dy;
+    p=1-q-r;
+#ifdef FLATTRIANGLE
+    elevs[i]=q*b->z+p*a->z+r*c->z;
+#else
+    elevs[i]=p*p*(p*za+q*c0+r*c1)+q*q*(q*zb+r*c5+p*c2)+
+             r*r*(r*zc+p*c4+q*c6)+p*q*r*c3;
+#endif
+  }
+}
+
+int triangle::countIn(const xy *pnts,int n)
+/* Returns how many of the points, from the first, are in the triangle,
+ * using the same barycentric coordinates as elevations. A point on a side
+ * may be counted as out though in() says it's in.
+ */
+{
+  int i;
+  double ax=a->getx(),ay=a->gety(),totarea,qx,qy,rx,ry;
+  double q,r,dx,dy;
+  totarea=2*area3(*a,*b,*c);
+  qx=(c->gety()-ay)/totarea;
+  qy=(ax-c->getx())/totarea;
+  rx=(ay-b->gety())/totarea;
+  ry=(b->getx()-ax)/totarea;
+  for (i=0;i<n;i++)
+  {
+    dx=pnts[i].getx()-ax;
+    dy=pnts[i].gety()-ay;
+    q=qx*dx+qy*dy;
+    r=rx*dx+ry*dy;
+    if (!(q>=0 && r>=0 && q+r<=1))
+      break;
+  }
+  return i;
+}
+
 xyz triangle::gradient3(xy pnt)
 {
   double p,q,r,s,gp,gq,gr;
@@ -142,13 +273,14 @@ xyz triangle::gradient3(xy pnt)
 }
 
 xy triangle::gradient(xy pnt)
+/* The three partial gradients are converted to a gradient in xy by a matrix
+ * whose columns are the sides, turned 90°, over twice the area. It's
+ * computed here rather than stored, to keep the triangle small.
+ */
 {
   xyz g3;
-  double g2[2];
   g3=gradient3(pnt);
-  g2[0]=g3.x*gradmat[0][0]+g3.y*gradmat[0][1]+g3.z*gradmat[0][2];
-  g2[1]=g3.x*gradmat[1][0]+g3.y*gradmat[1][1]+g3.z*gradmat[1][2];
-  return xy(g2[0],g2[1]);
+  return (turn90(xy(*c-*b))*g3.x+turn90(xy(*a-*c))*g3.y+turn90(xy(*b-*a))*g3.z)/sarea/2;
 }
 
 triangleHit triangle::hitTest(xy pnt)
@@ -201,20 +333,6 @@ triangleHit triangle::hitTest(xy pnt)
   return ret;
 }
 
-void triangle::setgradmat()
-{
-  xy scalt;
-  scalt=turn90(xy(*c-*b))/sarea/2;
-  gradmat[0][0]=scalt.x;
-  gradmat[1][0]=scalt.y;
-  scalt=turn90(xy(*a-*c))/sarea/2;
-  gradmat[0][1]=scalt.x;
-  gradmat[1][1]=scalt.y;
-  scalt=turn90(xy(*b-*a))/sarea/2;
-  gradmat[0][2]=scalt.x;
-  gradmat[1][2]=scalt.y;
-}
-
 bool triangle::in(xy pnt)
 {
   return area3(pnt,*b,*c)>=0 && area3(*a,pnt,*c)>=0 && area3(*a,*b,pnt)>=0;
@@ -274,12 +392,14 @@ void triangle::flatten()
   ctrl[5]=(2*b->z+c->z)/3;
   ctrl[6]=(2*c->z+b->z)/3;
   nocubedir=INT_MAX;
-  totcritpointcount=0;
-  critpoints.clear();
+  if (cold.p)
+  {
+    cold.p->totcritpointcount=0;
+    cold.p->critpoints.clear();
+  }
 #endif
   sarea=area();
   peri=perimeter();
-  setgradmat();
 }
 
 bool triangle::isFlat()
@@ -323,7 +443,6 @@ void triangle::setgradient(xy pnt,xy grad)
   nocubedir=INT_MAX;
 #endif
   sarea=area();
-  setgradmat();
 }
 
 double triangle::ctrlpt(xy pnt1,xy pnt2)
@@ -490,7 +609,7 @@ void triangle::writeXml(ofstream &ofile,pointlist &pl)
 {
   int i;
   ofile<<"<triangle corners=\"";
-  ofile<<pl.revpoints[a]<<' '<<pl.revpoints[b]<<' '<<pl.revpoints[c];
+  ofile<<a->num<<' '<<b->num<<' '<<c->num;
   ofile<<"\" acicularity=\""<<acicularity();
 #ifndef FLATTRIANGLE
   ofile<<"\" control=\"";
@@ -962,7 +1081,7 @@ void triangle::findcriticalpts()
   for (i=0;i<critpts.size();i++)
     if (in(critpts[i]))
       ret.push_back(critpts[i]);
-  critpoints=ret;
+  coldData().critpoints=ret;
 #endif
 }
 
@@ -1045,17 +1164,17 @@ void triangle::setsubslopes(segment &s)
   int i;
   xy dir;
   dir=cossin(s.chordbearing());
-  for (i=0;i<critpoints.size();i++)
-    if (xy(s.getstart())==critpoints[i])
+  for (i=0;i<critpoints().size();i++)
+    if (xy(s.getstart())==critpoints()[i])
       break;
-  if (i<critpoints.size())
+  if (i<critpoints().size())
     s.setslope(START,0);
   else
     s.setslope(START,dot(gradient(s.getstart()),dir));
-  for (i=0;i<critpoints.size();i++)
-    if (xy(s.getend())==critpoints[i])
+  for (i=0;i<critpoints().size();i++)
+    if (xy(s.getend())==critpoints()[i])
       break;
-  if (i<critpoints.size())
+  if (i<critpoints().size())
     s.setslope(END,0);
   else
     s.setslope(END,dot(gradient(s.getend()),dir));
@@ -1092,13 +1211,14 @@ void triangle::subdivide()
   vector<segment> subdivcopy;
   multimap<double,int> failIntersection;
   multimap<double,int>::iterator fi;
-  morecritpoints=critpoints;
-  for (i=0;i<critpoints.size();i++)
+  vector<segment> &segs=coldData().subdiv;
+  morecritpoints=critpoints();
+  for (i=0;i<critpoints().size();i++)
     critdir.push_back(INT_MAX);
   round=0;
   do
   {
-    subdiv.clear();
+    segs.clear();
     sid=a->edg(this);
     for (i=0;i<2;i++)
       if (isfinite(sid->extrema[i]))
@@ -1113,60 +1233,60 @@ void triangle::subdivide()
 	sidea.push_back(sid->critpoint(i));
     for (i=0;i<morecritpoints.size();i++)
       for (j=0;j<i;j++)
-	subdiv.push_back(segment(xyz(morecritpoints[i],elevation(morecritpoints[i])),xyz(morecritpoints[j],elevation(morecritpoints[j]))));
+	segs.push_back(segment(xyz(morecritpoints[i],elevation(morecritpoints[i])),xyz(morecritpoints[j],elevation(morecritpoints[j]))));
     for (i=0;i<morecritpoints.size();i++)
     {
       cr=xyz(morecritpoints[i],elevation(morecritpoints[i]));
       for (j=0;j<sidea.size();j++)
-	subdiv.push_back(segment(cr,sidea[j]));
+	segs.push_back(segment(cr,sidea[j]));
       for (j=0;j<sideb.size();j++)
-	subdiv.push_back(segment(cr,sideb[j]));
+	segs.push_back(segment(cr,sideb[j]));
       for (j=0;j<sidec.size();j++)
-	subdiv.push_back(segment(cr,sidec[j]));
-      subdiv.push_back(segment(cr,*a));
-      subdiv.push_back(segment(cr,*b));
-      subdiv.push_back(segment(cr,*c));
+	segs.push_back(segment(cr,sidec[j]));
+      segs.push_back(segment(cr,*a));
+      segs.push_back(segment(cr,*b));
+      segs.push_back(segment(cr,*c));
     }
     for (i=0;i<sidea.size();i++)
     {
-      subdiv.push_back(segment(*a,sidea[i]));
+      segs.push_back(segment(*a,sidea[i]));
       for (j=0;j<sideb.size();j++)
-	subdiv.push_back(segment(sidea[i],sideb[j]));
+	segs.push_back(segment(sidea[i],sideb[j]));
     }
     for (i=0;i<sideb.size();i++)
     {
-      subdiv.push_back(segment(*b,sideb[i]));
+      segs.push_back(segment(*b,sideb[i]));
       for (j=0;j<sidec.size();j++)
-	subdiv.push_back(segment(sideb[i],sidec[j]));
+	segs.push_back(segment(sideb[i],sidec[j]));
     }
     for (i=0;i<sidec.size();i++)
     {
-      subdiv.push_back(segment(*c,sidec[i]));
+      segs.push_back(segment(*c,sidec[i]));
       for (j=0;j<sidea.size();j++)
-	subdiv.push_back(segment(sidec[i],sidea[j]));
+	segs.push_back(segment(sidec[i],sidea[j]));
     }
-    for (i=0;i<subdiv.size();i++)
+    for (i=0;i<segs.size();i++)
     {
-      dir=cossin(subdiv[i].chordbearing());
-      setsubslopes(subdiv[i]);
-      next.push_back(subdiv[i].vextrema(false).size());
-      lens.push_back(subdiv[i].length());
+      dir=cossin(segs[i].chordbearing());
+      setsubslopes(segs[i]);
+      next.push_back(segs[i].vextrema(false).size());
+      lens.push_back(segs[i].length());
     }
     for (h=31;h;h/=2) // Shell sort. The maximum possible number of lines is 60.
-      for (i=h;i<subdiv.size();i++)
+      for (i=h;i<segs.size();i++)
 	for (j=i-h;j>=0 && (next[j]>next[j+h] || (next[j]==next[j+h] && lens[j]>lens[j+h]));j-=h)
 	{
 	  swap(lens[j],lens[j+h]);
 	  swap(next[j],next[j+h]);
-	  swap(subdiv[j],subdiv[j+h]);
+	  swap(segs[j],segs[j+h]);
 	}
-    //for (i=0;i<subdiv.size();i++)
-      //cout<<i<<' '<<setprecision(3)<<bintodeg(subdiv[i].chordbearing())<<' '<<subdiv[i].startslope()<<' '<<subdiv[i].endslope()<<' '<<next[i]<<' '<<lens[i]<<endl;
-    subdivcopy=subdiv;
-    for (i=subdiv.size()-1;i>0;i--)
+    //for (i=0;i<subdiv().size();i++)
+      //cout<<i<<' '<<setprecision(3)<<bintodeg(subdiv()[i].chordbearing())<<' '<<subdiv()[i].startslope()<<' '<<subdiv()[i].endslope()<<' '<<next[i]<<' '<<lens[i]<<endl;
+    subdivcopy=segs;
+    for (i=segs.size()-1;i>0;i--)
       for (del=j=0;j<i && !del;j++)
       {
-	itype=intersection_type(subdiv[i],subdiv[j]);
+	itype=intersection_type(segs[i],segs[j]);
 	//cout<<i<<' '<<j<<' '<<inttype_str(itype)<<endl;
 	switch (itype)
 	{
@@ -1191,50 +1311,50 @@ void triangle::subdivide()
 	}
 	if (del)
 	{
-	  subdiv.erase(subdiv.begin()+i);
+	  segs.erase(segs.begin()+i);
 	  next.erase(next.begin()+i);
 	  lens.erase(lens.begin()+i);
 	}
       }
     for (i=0;i<subdivcopy.size();i++)
     {
-      for (j=0;j<subdiv.size();j++)
+      for (j=0;j<segs.size();j++)
       {
-	itype=intersection_type(subdivcopy[i],subdiv[j]);
-	if (itype==ACXBD || (subdivcopy[i]==subdiv[j]))
+	itype=intersection_type(subdivcopy[i],segs[j]);
+	if (itype==ACXBD || (subdivcopy[i]==segs[j]))
 	  j=2*subdivcopy.size();
       }
-      if (j==subdiv.size())
+      if (j==segs.size())
       {
-	subdiv.push_back(subdivcopy[i]);
+	segs.push_back(subdivcopy[i]);
 	next.push_back(subdivcopy[i].vextrema(false).size());
 	lens.push_back(subdivcopy[i].length());
       }
     }
-    n=subdiv.size();
+    n=segs.size();
     for (i=newcrit=0;i<n;i++)
     {
-      vex=subdiv[i].vextrema(false);
+      vex=segs[i].vextrema(false);
       if (vex.size())
       {
 	++newcrit;
-	morecritpoints.push_back(subdiv[i].station(vex[0]));
+	morecritpoints.push_back(segs[i].station(vex[0]));
         //if (fabs(frac(morecritpoints.back().getx())-0.152)<0.001
         //    && fabs(frac(morecritpoints.back().gety())-0.380)<0.001)
         //  cout<<"point I "<<ldecimal(morecritpoints.back().getx())<<','<<
         //        ldecimal(morecritpoints.back().gety())<<endl; // See testcontour.
-	critdir.push_back(subdiv[i].chordbearing());
-	subdiv[i].split(vex[0],newseg0,newseg1);
-	subdiv[i]=newseg0;
-	subdiv.push_back(newseg1);
-        //if (subdiv[i].chordbearing()!=subdiv.back().chordbearing())
-          //cout<<"splitting segment "<<i<<' '<<foldangle(subdiv[i].chordbearing()-critdir.back())
-            //<<' '<<foldangle(subdiv.back().chordbearing()-critdir.back())<<endl;
+	critdir.push_back(segs[i].chordbearing());
+	segs[i].split(vex[0],newseg0,newseg1);
+	segs[i]=newseg0;
+	segs.push_back(newseg1);
+        //if (subdiv()[i].chordbearing()!=subdiv().back().chordbearing())
+          //cout<<"splitting segment "<<i<<' '<<foldangle(subdiv()[i].chordbearing()-critdir.back())
+            //<<' '<<foldangle(subdiv().back().chordbearing()-critdir.back())<<endl;
       }
     }
     subdivcopy.clear();
-    //cout<<morecritpoints.size()-critpoints.size()<<" secondary critical points"<<endl;
-    for (i=critpoints.size();i<morecritpoints.size();i++)
+    //cout<<morecritpoints.size()-critpoints().size()<<" secondary critical points"<<endl;
+    for (i=critpoints().size();i<morecritpoints.size();i++)
     {
       cr=xyz(morecritpoints[i],elevation(morecritpoints[i]));
       for (j=0;j<i;j++)
@@ -1274,20 +1394,20 @@ void triangle::subdivide()
     for (i=0;i<subdivcopy.size();i++)
     {
       setsubslopes(subdivcopy[i]);
-      for (j=0;j<subdiv.size();j++)
+      for (j=0;j<segs.size();j++)
       {
-	itype=intersection_type(subdivcopy[i],subdiv[j]);
+	itype=intersection_type(subdivcopy[i],segs[j]);
         /* For some strange reason, sometimes subdiv[j] and subdivcopy[i]
          * have the same xy coordinates of their start and end points,
          * in reverse order, but different z coordinates. Therefore the
          * collinearity test is necessary.
          */
-        if (itype==ACXBD || itype==COLIN || subdivcopy[i]==subdiv[j] || subdivcopy[i]==-subdiv[j])
-	  j=2*subdiv.size()+1;
+        if (itype==ACXBD || itype==COLIN || subdivcopy[i]==segs[j] || subdivcopy[i]==-segs[j])
+	  j=2*segs.size()+1;
       }
-      if (j==subdiv.size())
+      if (j==segs.size())
       {
-	subdiv.push_back(subdivcopy[i]);
+	segs.push_back(subdivcopy[i]);
 	next.push_back(subdivcopy[i].vextrema(false).size());
 	lens.push_back(subdivcopy[i].length());
       }
@@ -1295,46 +1415,91 @@ void triangle::subdivide()
     round++;
   }
   while (newcrit>0 && round<1);
-  /*for (i=0;i<subdiv.size();i++)
-    cout<<i<<' '<<setprecision(3)<<bintodeg(subdiv[i].chordbearing())<<' '<<subdiv[i].startslope()<<' '<<subdiv[i].endslope()<<' '<<next[i]<<' '<<lens[i]<<endl;*/
+  /*for (i=0;i<subdiv().size();i++)
+    cout<<i<<' '<<setprecision(3)<<bintodeg(subdiv()[i].chordbearing())<<' '<<subdiv()[i].startslope()<<' '<<subdiv()[i].endslope()<<' '<<next[i]<<' '<<lens[i]<<endl;*/
   /* Tracing errors are caused by extra subdivision segments. The correct
    * number is 1 segment for every side critical point and 3 for every
    * interior critical point. With the boundary added, it's 2 for every
    * side critical point and 3 for every interior critical point plus 3.
    */
-  totcritpointcount=morecritpoints.size();
-  if (subdiv.size()!=3*totcritpointcount+sidea.size()+sideb.size()+sidec.size())
+  coldData().totcritpointcount=morecritpoints.size();
+  if (segs.size()!=3*coldData().totcritpointcount+sidea.size()+sideb.size()+sidec.size())
   {
-    nExtraSegments=subdiv.size()-3*totcritpointcount-sidea.size()-sideb.size()-sidec.size();
+    nExtraSegments=segs.size()-3*coldData().totcritpointcount-sidea.size()-sideb.size()-sidec.size();
     //cout<<"centroid "<<ldecimal(centroid().getx())<<','<<ldecimal(centroid().gety())<<'\n';
-    //cout<<morecritpoints.size()<<" interior critpoints ("<<morecritpoints.size()-critpoints.size()<<" secondary) ";
-    //cout<<sidea.size()+sideb.size()+sidec.size()<<" side critpoints "<<subdiv.size()<<" subdivs\n";
-    for (i=subdivcopy.size();i<subdiv.size();i++)
+    //cout<<morecritpoints.size()<<" interior critpoints ("<<morecritpoints.size()-critpoints().size()<<" secondary) ";
+    //cout<<sidea.size()+sideb.size()+sidec.size()<<" side critpoints "<<subdiv().size()<<" subdivs\n";
+    for (i=subdivcopy.size();i<segs.size();i++)
       for (j=0;j<subdivcopy.size();j++)
       {
-        //cout<<i<<' '<<j<<' '<<inttype_str(intersection_type(subdiv[i],subdiv[j]))
-          //<<' '<<missDistance(subdiv[i],subdiv[j])<<endl;
-        if (intersection_type(subdiv[i],subdiv[j])==NOINT)
-          failIntersection.insert(pair<double,int>(missDistance(subdiv[i],subdiv[j]),i));
+        //cout<<i<<' '<<j<<' '<<inttype_str(intersection_type(subdiv()[i],subdiv()[j]))
+          //<<' '<<missDistance(subdiv()[i],subdiv()[j])<<endl;
+        if (intersection_type(segs[i],segs[j])==NOINT)
+          failIntersection.insert(pair<double,int>(missDistance(segs[i],segs[j]),i));
       }
     for (fi=failIntersection.begin();nExtraSegments && fi!=failIntersection.end();++fi)
     {
-      if (subdiv[fi->second].length())
+      if (segs[fi->second].length())
         nExtraSegments--;
-      subdiv[fi->second]=segment();
+      segs[fi->second]=segment();
     }
-    for (i=0,j=subdiv.size()-1;i<j;)
+    for (i=0,j=segs.size()-1;i<j;)
     {
-      while (i<subdiv.size() && subdiv[i].length()>0)
+      while (i<segs.size() && segs[i].length()>0)
         i++;
-      while (j>=0 && subdiv[j].length()==0)
+      while (j>=0 && segs[j].length()==0)
         j--;
       if (i<j)
-        swap(subdiv[i],subdiv[j]);
+        swap(segs[i],segs[j]);
     }
-    subdiv.resize(i);
+    segs.resize(i);
+  }
+#endif
+  coldData().subdivided=true;
+}
+
+bool triangle::isSubdivided()
+{
+  return cold.p && cold.p->subdivided;
+}
+
+void triangle::needSubdiv(bool perimeter)
+/* Called by the methods that trace and clip contours. If the triangle
+ * hasn't been subdivided, because findcriticalpts was told to be lazy,
+ * finds its critical points and subdivides it, adding the perimeter if
+ * tracing needs it. A triangle no contour goes through is never subdivided.
+ */
+{
+  if (!isSubdivided())
+  {
+    findcriticalpts();
+    subdivide();
+    if (perimeter)
+      addperimeter();
+  }
+}
+
+array<double,2> triangle::ctrlRange()
+/* Returns bounds of the elevation in the triangle, without subdividing it.
+ * The elevation at any point is a weighted average of the corners and
+ * control points, so it's between the lowest and highest of them. The range
+ * is widened slightly for roundoff in computing a weighted average.
+ */
+{
+  int i;
+  array<double,2> ret;
+  ret[0]=min(a->z,min(b->z,c->z));
+  ret[1]=max(a->z,max(b->z,c->z));
+#ifndef FLATTRIANGLE
+  for (i=0;i<7;i++)
+  {
+    ret[0]=min(ret[0],ctrl[i]);
+    ret[1]=max(ret[1],ctrl[i]);
   }
 #endif
+  ret[0]-=(fabs(ret[0])+fabs(ret[1]))*1e-12;
+  ret[1]+=(fabs(ret[0])+fabs(ret[1]))*1e-12;
+  return ret;
 }
 
 /* 2015-07-12: There was a bug in addperimeter.
@@ -1364,11 +1529,14 @@ void triangle::subdivide()
  */
 
 void triangle::addperimeter()
+// Does nothing if the triangle hasn't been subdivided; needSubdiv will add it.
 {
   int i,oldnumber;
   int sizeWithPerimeter,sizeWithoutPerimeter;
   edge *sid;
   vector<xyz> sidea,sideb,sidec;
+  if (!isSubdivided())
+    return;
   sid=a->edg(this);
   for (i=0;i<2;i++)
     if (isfinite(sid->extrema[i]))
@@ -1391,43 +1559,43 @@ void triangle::addperimeter()
   sizeWithPerimeter=2*(sidea.size()+sideb.size()+sidec.size())+3;
   sizeWithoutPerimeter=(sidea.size()+sideb.size()+sidec.size());
 #else
-  sizeWithPerimeter=2*(sidea.size()+sideb.size()+sidec.size())+3*totcritpointcount+3;
-  sizeWithoutPerimeter=(sidea.size()+sideb.size()+sidec.size())+3*totcritpointcount;
+  sizeWithPerimeter=2*(sidea.size()+sideb.size()+sidec.size())+3*coldData().totcritpointcount+3;
+  sizeWithoutPerimeter=(sidea.size()+sideb.size()+sidec.size())+3*coldData().totcritpointcount;
 #endif
-  oldnumber=subdiv.size();
+  oldnumber=cold.p->subdiv.size();
   if (oldnumber<sizeWithPerimeter)
   {
     if (sidec.size())
     {
-      subdiv.push_back(segment(*a,sidec[0]));
+      cold.p->subdiv.push_back(segment(*a,sidec[0]));
       for (i=0;i<sidec.size()-1;i++)
-        subdiv.push_back(segment(sidec[i],sidec[i+1]));
-      subdiv.push_back(segment(sidec[i],*b));
+        cold.p->subdiv.push_back(segment(sidec[i],sidec[i+1]));
+      cold.p->subdiv.push_back(segment(sidec[i],*b));
     }
     else
-      subdiv.push_back(segment(*a,*b));
+      cold.p->subdiv.push_back(segment(*a,*b));
     if (sidea.size())
     {
-      subdiv.push_back(segment(*b,sidea[0]));
+      cold.p->subdiv.push_back(segment(*b,sidea[0]));
       for (i=0;i<sidea.size()-1;i++)
-        subdiv.push_back(segment(sidea[i],sidea[i+1]));
-      subdiv.push_back(segment(sidea[i],*c));
+        cold.p->subdiv.push_back(segment(sidea[i],sidea[i+1]));
+      cold.p->subdiv.push_back(segment(sidea[i],*c));
     }
     else
-      subdiv.push_back(segment(*b,*c));
+      cold.p->subdiv.push_back(segment(*b,*c));
     if (sideb.size())
     {
-      subdiv.push_back(segment(*c,sideb[0]));
+      cold.p->subdiv.push_back(segment(*c,sideb[0]));
       for (i=0;i<sideb.size()-1;i++)
-        subdiv.push_back(segment(sideb[i],sideb[i+1]));
-      subdiv.push_back(segment(sideb[i],*a));
+        cold.p->subdiv.push_back(segment(sideb[i],sideb[i+1]));
+      cold.p->subdiv.push_back(segment(sideb[i],*a));
     }
     else
-      subdiv.push_back(segment(*c,*a));
-    for (i=oldnumber;i<subdiv.size();i++)
-      setsubslopes(subdiv[i]);
+      cold.p->subdiv.push_back(segment(*c,*a));
+    for (i=oldnumber;i<cold.p->subdiv.size();i++)
+      setsubslopes(cold.p->subdiv[i]);
   }
-  assert(subdiv.size()>=3);
+  assert(cold.p->subdiv.size()>=3);
 }
 
 void triangle::removeperimeter()
@@ -1436,6 +1604,8 @@ void triangle::removeperimeter()
   int sizeWithPerimeter,sizeWithoutPerimeter;
   edge *sid;
   vector<xyz> sidea,sideb,sidec;
+  if (!isSubdivided())
+    return;
   sid=a->edg(this);
   for (i=0;i<2;i++)
     if (isfinite(sid->extrema[i]))
@@ -1452,37 +1622,37 @@ void triangle::removeperimeter()
   sizeWithPerimeter=2*(sidea.size()+sideb.size()+sidec.size())+3;
   sizeWithoutPerimeter=(sidea.size()+sideb.size()+sidec.size());
 #else
-  sizeWithPerimeter=2*(sidea.size()+sideb.size()+sidec.size())+3*totcritpointcount+3;
-  sizeWithoutPerimeter=(sidea.size()+sideb.size()+sidec.size())+3*totcritpointcount;
+  sizeWithPerimeter=2*(sidea.size()+sideb.size()+sidec.size())+3*coldData().totcritpointcount+3;
+  sizeWithoutPerimeter=(sidea.size()+sideb.size()+sidec.size())+3*coldData().totcritpointcount;
 #endif
-  if (subdiv.size()>sizeWithoutPerimeter)
+  if (cold.p->subdiv.size()>sizeWithoutPerimeter)
   {
-    for (i=subdiv.size()-1,acnt=bcnt=ccnt=0;i>=0 && acnt<3 && bcnt<3 && ccnt<3 && acnt+bcnt+ccnt<6;i--)
+    for (i=cold.p->subdiv.size()-1,acnt=bcnt=ccnt=0;i>=0 && acnt<3 && bcnt<3 && ccnt<3 && acnt+bcnt+ccnt<6;i--)
     {
-      if (subdiv[i].getstart()==*a)
+      if (cold.p->subdiv[i].getstart()==*a)
         acnt++;
-      if (subdiv[i].getend()==*a)
+      if (cold.p->subdiv[i].getend()==*a)
         acnt++;
-      if (subdiv[i].getstart()==*b)
+      if (cold.p->subdiv[i].getstart()==*b)
         bcnt++;
-      if (subdiv[i].getend()==*b)
+      if (cold.p->subdiv[i].getend()==*b)
         bcnt++;
-      if (subdiv[i].getstart()==*c)
+      if (cold.p->subdiv[i].getstart()==*c)
         ccnt++;
-      if (subdiv[i].getend()==*c)
+      if (cold.p->subdiv[i].getend()==*c)
         ccnt++;
     }
     i++;
-    assert(subdiv.size()-i<=9);
+    assert(cold.p->subdiv.size()-i<=9);
     if (acnt==2 && bcnt==2 && ccnt==2)
     {
-      subdiv.resize(i);
-      subdiv.shrink_to_fit();
+      cold.p->subdiv.resize(i);
+      cold.p->subdiv.shrink_to_fit();
     }
     else
       assert(acnt==2 && bcnt==2 && ccnt==2);
   }
-  assert(subdiv.size()==sizeWithoutPerimeter);
+  assert(cold.p->subdiv.size()==sizeWithoutPerimeter);
 }
 
 array<double,4> triangle::lohi()
@@ -1543,20 +1713,26 @@ array<double,4> triangle::lohi()
   ret[0]=ret[1];
   ret[3]=ret[2];
 #ifndef FLATTRIANGLE
-  for (i=0;i<critpoints.size();i++)
-  {
-    e=elevation(critpoints[i]);
-    if (e<ret[0])
-      ret[0]=e;
-    if (e>ret[3])
-      ret[3]=e;
+  if (isSubdivided())
+    for (i=0;i<critpoints().size();i++)
+    {
+      e=elevation(critpoints()[i]);
+      if (e<ret[0])
+	ret[0]=e;
+      if (e>ret[3])
+	ret[3]=e;
+    }
+  else
+  { // The critical points haven't been found, so use the control points.
+    ret[0]=min(ret[0],ctrlRange()[0]);
+    ret[3]=max(ret[3],ctrlRange()[1]);
   }
 #endif
   return ret;
 }
 
-/* Convert an index number to a triangle's subdiv to and from a pointer to edge
- * with a part number added. This is used to transfer the subdiv from one triangle
+/* Convert an index number to a triangle's subdiv() to and from a pointer to edge
+ * with a part number added. This is used to transfer the subdiv() from one triangle
  * to the next when drawing contours. The index number has bit 16 set or clear
  * to indicate which side of the segment the next point of the contour is on.
  * If it's set, you're crossing the segment rightward, which is to the outside
@@ -1568,28 +1744,29 @@ uintptr_t triangle::edgepart(int subdir) // subdir should have bit 16 set, but i
   edge *sid=NULL;
   bool backward;
   uintptr_t ret;
-  for (i=subdiv.size()-1,acnt=bcnt=ccnt=0;i>=0 && acnt<3 && bcnt<3 && ccnt<3 && acnt+bcnt+ccnt<6;i--)
+  needSubdiv(true);
+  for (i=subdiv().size()-1,acnt=bcnt=ccnt=0;i>=0 && acnt<3 && bcnt<3 && ccnt<3 && acnt+bcnt+ccnt<6;i--)
   {
-    if (subdiv[i].getstart()==*a)
+    if (subdiv()[i].getstart()==*a)
     {
       apos=i;
       acnt++;
     }
-    if (subdiv[i].getend()==*a)
+    if (subdiv()[i].getend()==*a)
       acnt++;
-    if (subdiv[i].getstart()==*b)
+    if (subdiv()[i].getstart()==*b)
     {
       bpos=i;
       bcnt++;
     }
-    if (subdiv[i].getend()==*b)
+    if (subdiv()[i].getend()==*b)
       bcnt++;
-    if (subdiv[i].getstart()==*c)
+    if (subdiv()[i].getstart()==*c)
     {
       cpos=i;
       ccnt++;
     }
-    if (subdiv[i].getend()==*c)
+    if (subdiv()[i].getend()==*c)
       ccnt++;
   }
   assert (apos<bpos && bpos<cpos);
@@ -1610,9 +1787,9 @@ uintptr_t triangle::edgepart(int subdir) // subdir should have bit 16 set, but i
   {
     sid=a->edg(this); // which is found by asking point A
     base=cpos;
-    pieces=subdiv.size()-cpos;
+    pieces=subdiv().size()-cpos;
   }
-  if (subdir>subdiv.size())
+  if (subdir>subdiv().size())
     sid=NULL;
   if (sid)
   {
@@ -1632,28 +1809,29 @@ int triangle::subdir(uintptr_t edgepart)
   edge *sid;
   bool backward;
   int ret;
-  for (i=subdiv.size()-1,acnt=bcnt=ccnt=0;i>=0 && acnt<3 && bcnt<3 && ccnt<3 && acnt+bcnt+ccnt<6;i--)
+  needSubdiv(true);
+  for (i=subdiv().size()-1,acnt=bcnt=ccnt=0;i>=0 && acnt<3 && bcnt<3 && ccnt<3 && acnt+bcnt+ccnt<6;i--)
   {
-    if (subdiv[i].getstart()==*a)
+    if (subdiv()[i].getstart()==*a)
     {
       apos=i;
       acnt++;
     }
-    if (subdiv[i].getend()==*a)
+    if (subdiv()[i].getend()==*a)
       acnt++;
-    if (subdiv[i].getstart()==*b)
+    if (subdiv()[i].getstart()==*b)
     {
       bpos=i;
       bcnt++;
     }
-    if (subdiv[i].getend()==*b)
+    if (subdiv()[i].getend()==*b)
       bcnt++;
-    if (subdiv[i].getstart()==*c)
+    if (subdiv()[i].getstart()==*c)
     {
       cpos=i;
       ccnt++;
     }
-    if (subdiv[i].getend()==*c)
+    if (subdiv()[i].getend()==*c)
       ccnt++;
   }
   assert (apos<bpos && bpos<cpos); // if this fails, you may have forgotten to add the perimeter
@@ -1671,7 +1849,7 @@ int triangle::subdir(uintptr_t edgepart)
   if (sid==a->edg(this))
   {
     base=cpos;
-    pieces=subdiv.size()-cpos;
+    pieces=subdiv().size()-cpos;
   }
   if (base>=0)
   {
@@ -1699,26 +1877,27 @@ int triangle::proceed(int subdir,double elevation)
   vector<prorec> list;
   prorec p;
   xy s,e;
+  needSubdiv(true);
   sign=1;
   if (subdir&65536)
     sign=-1;
   subdir&=65535;
-  if (subdir<subdiv.size())
+  if (subdir<subdiv().size())
   {
-    s=subdiv[subdir].getstart();
-    e=subdiv[subdir].getend();
-    for (i=0;i<subdiv.size();i++)
+    s=subdiv()[subdir].getstart();
+    e=subdiv()[subdir].getend();
+    for (i=0;i<subdiv().size();i++)
     {
       p.n=-1;
-      if (subdiv[i].getstart()==s || subdiv[i].getstart()==e)
+      if (subdiv()[i].getstart()==s || subdiv()[i].getstart()==e)
       {
 	p.n=i;
-	p.farend=subdiv[i].getend();
+	p.farend=subdiv()[i].getend();
       }
-      if (subdiv[i].getend()==s || subdiv[i].getend()==e)
+      if (subdiv()[i].getend()==s || subdiv()[i].getend()==e)
       {
 	p.n=i;
-	p.farend=subdiv[i].getstart();
+	p.farend=subdiv()[i].getstart();
       }
       p.a=area3(s,e,p.farend)*sign;
       if (p.a<=0)
@@ -1749,11 +1928,11 @@ int triangle::proceed(int subdir,double elevation)
     //cout<<i<<' '<<j<<endl;
     if (j<list.size())
     {
-      if ((subdiv[list[j].n].getstart().elev()<elevation)^(subdiv[list[j].n].getend().elev()<elevation))
+      if ((subdiv()[list[j].n].getstart().elev()<elevation)^(subdiv()[list[j].n].getend().elev()<elevation))
 	ret=list[j].n;
       else
 	ret=list[i].n;
-      if (area3(subdiv[ret].getstart(),subdiv[ret].getend(),(s+e)/2)>0)
+      if (area3(subdiv()[ret].getstart(),subdiv()[ret].getend(),(s+e)/2)>0)
 	ret+=65536;
     }
     else
@@ -1766,9 +1945,10 @@ int triangle::proceed(int subdir,double elevation)
 
 bool triangle::crosses(int subdir,double elevation)
 {
+  needSubdiv(true);
   subdir&=65535;
-  if (subdir<subdiv.size())
-    return subdiv[subdir].crosses(elevation);
+  if (subdir<subdiv().size())
+    return subdiv()[subdir].crosses(elevation);
   else
     return false;
 }
@@ -1779,21 +1959,23 @@ bool triangle::upleft(int subdir)
  */
 {
   bool sign;
+  needSubdiv(true);
   sign=(subdir&65536)>0;
   subdir&=65535;
-  if (subdir<subdiv.size())
-    return (subdiv[subdir].getstart().elev()>subdiv[subdir].getend().elev())^sign;
+  if (subdir<subdiv().size())
+    return (subdiv()[subdir].getstart().elev()>subdiv()[subdir].getend().elev())^sign;
   else
     return false;
 }
 
 xy triangle::contourcept(int subdir,double elevation)
 {
+  needSubdiv(true);
   subdir&=65535;
-  //if (subdir<subdiv.size() && fabs(elevation-0.21)<0.01 && fabs(subdiv[subdir].startslope()+0.183)<0.001 && fabs(subdiv[subdir].endslope()+0.121)<0.001)
+  //if (subdir<subdiv().size() && fabs(elevation-0.21)<0.01 && fabs(subdiv()[subdir].startslope()+0.183)<0.001 && fabs(subdiv()[subdir].endslope()+0.121)<0.001)
   //  cout<<"Contour test spike segment"<<endl;
-  if (subdir<subdiv.size())
-    return subdiv[subdir].station(subdiv[subdir].contourcept(elevation));
+  if (subdir<subdiv().size())
+    return subdiv()[subdir].station(subdiv()[subdir].contourcept(elevation));
   else
     return xy(NAN,NAN);
 }
@@ -1817,10 +1999,16 @@ void clip1(const xy &astart,xy &a,const xy &x,xy &b,const xy &bstart)
   }
 }
 
-segment triangle::dirclip(const xy pnt,const int dir)
+segment triangle::dirclip(const xy pnt,const int dir,double elev)
 /* This is called when refining contours. By this time, the perimeter
  * has been removed. It returns a segment passing through pnt in the
  * direction dir clipped by all the subdivision lines.
+ *
+ * If findcriticalpts was lazy, the triangle is subdivided only if its range
+ * spans elev, the contour's elevation; subdivideForSmoothing has already
+ * done so for such triangles, so smoothing in several threads doesn't
+ * subdivide here. A triangle the contour can't go through is clipped
+ * only by its sides if it hasn't been subdivided.
  */
 {
   segment ret;
@@ -1828,6 +2016,10 @@ segment triangle::dirclip(const xy pnt,const int dir)
   xy aend=astart,bend=bstart;
   xy intpt;
   int i,itype;
+  array<double,2> range;
+  range=ctrlRange();
+  if (range[0]<elev && range[1]>=elev)
+    needSubdiv(false);
   intpt=intersection(aend,bend,*a,*b);
   if (intpt.isfinite())
     clip1(astart,aend,intpt,bend,bstart);
@@ -1837,12 +2029,12 @@ segment triangle::dirclip(const xy pnt,const int dir)
   intpt=intersection(aend,bend,*c,*a);
   if (intpt.isfinite())
     clip1(astart,aend,intpt,bend,bstart);
-  for (i=0;i<subdiv.size();i++)
+  for (i=0;i<subdiv().size();i++)
   {
-    itype=intersection_type(aend,bend,subdiv[i].getstart(),subdiv[i].getend());
+    itype=intersection_type(aend,bend,subdiv()[i].getstart(),subdiv()[i].getend());
     if (itype==ACXBD || itype==BDTAC)
     {
-      intpt=intersection(aend,bend,subdiv[i].getstart(),subdiv[i].getend());
+      intpt=intersection(aend,bend,subdiv()[i].getstart(),subdiv()[i].getend());
       clip1(astart,aend,intpt,bend,bstart);
     }
   }
@@ -58,6 +58,32 @@ struct triangleHit
   point *cor;
 };
 
+struct TriangleCold
+/* The parts of a triangle that are used only for contouring. A triangle
+ * allocates them when findcriticalpts or subdivide first needs them, so that
+ * a TIN loaded only to look up elevations doesn't carry them.
+ */
+{
+#ifndef FLATTRIANGLE
+  int totcritpointcount; // includes the secondary critpoints
+  std::vector<xy> critpoints; // does not include secondary critpoints
+#endif
+  std::vector<segment> subdiv;
+  bool subdivided; // set by subdivide
+  TriangleCold();
+};
+
+class TriangleColdPtr
+// Owns a TriangleCold, if there is one, and copies it when copied.
+{
+public:
+  TriangleColdPtr();
+  TriangleColdPtr(const TriangleColdPtr &b);
+  TriangleColdPtr &operator=(const TriangleColdPtr &b);
+  ~TriangleColdPtr();
+  TriangleCold *p;
+};
+
 class triangle
 /* A triangle has three corners and seven other control points, arranged as follows:
          a
@@ -88,18 +114,24 @@ public:
 #ifndef FLATTRIANGLE
   double ctrl[7]; //There are 10 control points; the corners are three, and these are the elevations of the others.
   int nocubedir; // set to MAXINT if critpoints have not been looked for
-  int totcritpointcount; // includes the secondary critpoints
-  std::vector<xy> critpoints; // does not include secondary critpoints
 #endif
-  std::vector<segment> subdiv;
+  unsigned int localMark; // equals pointlist::localEpoch if the triangle is in localTriangles
   double peri,sarea;
   triangle *aneigh,*bneigh,*cneigh;
-  double gradmat[2][3]; // to compute gradient from three partial gradients
+  TriangleColdPtr cold; // nullptr until the triangle is contoured
   triangle();
+  TriangleCold &coldData();
+#ifndef FLATTRIANGLE
+  const std::vector<xy> &critpoints() const;
+#endif
+  const std::vector<segment> &subdiv() const;
+  void dropCold();
   bool ptValid();
   void setneighbor(triangle *neigh);
   void setnoneighbor(edge *neigh);
   double elevation(xy pnt);
+  void elevations(const xy *pnts,double *elevs,int n);
+  int countIn(const xy *pnts,int n);
   void setgradient(xy pnt,xy grad);
   double ctrlpt(xy pnt1,xy pnt2);
   void flatten();
@@ -117,7 +149,6 @@ public:
   double acicularity();
   xy centroid();
   void setcentercp();
-  void setgradmat();
   std::vector<double> xsect(int angle,double offset);
   double spelevation(int angle,double x,double y);
 #ifndef FLATTRIANGLE
@@ -135,6 +166,9 @@ public:
   void findcriticalpts();
   int pointtype(xy pnt);
   void subdivide();
+  bool isSubdivided();
+  void needSubdiv(bool perimeter);
+  std::array<double,2> ctrlRange();
   void addperimeter();
   void removeperimeter();
   uintptr_t edgepart(int subdir);
@@ -144,7 +178,7 @@ public:
   bool crosses(int subdir,double elevation);
   bool upleft(int subdir);
   xy contourcept(int subdir,double elevation);
-  segment dirclip(const xy pnt,const int dir);
+  segment dirclip(const xy pnt,const int dir,double elev);
   edge *checkBentContour();
   virtual void writeXml(std::ofstream &ofile,pointlist &pl);
 private:
@@ -131,6 +131,130 @@ bezier3d& bezier3d::operator+=(const bezier3d &r)
   return *this;
 }
 
+double segmentDistance(const vector<xyz> &c,xyz pnt,double t)
+/* Distance from pnt to the Bézier segment with control points c, found by
+ * Newton's method starting at t, which should be near the closest point.
+ */
+{
+  int i;
+  double p,q,denom;
+  xyz r,d1,d2;
+  for (i=0;i<=4;i++)
+  {
+    p=t;
+    q=1-t;
+    r=c[0]*(q*q*q)+c[1]*(3*p*q*q)+c[2]*(3*p*p*q)+c[3]*(p*p*p);
+    if (i==4)
+      break;
+    d1=(c[1]-c[0])*(3*q*q)+(c[2]-c[1])*(6*p*q)+(c[3]-c[2])*(3*p*p);
+    d2=(c[2]-c[1]*2+c[0])*(6*q)+(c[3]-c[2]*2+c[1])*(6*p);
+    denom=dot(d1,d1)+dot(r-pnt,d2);
+    if (denom>0)
+      t-=dot(r-pnt,d1)/denom;
+    if (t<0)
+      t=0;
+    if (t>1)
+      t=1;
+  }
+  return dist(r,pnt);
+}
+
+bezier3d bezier3d::merged(double tolerance)
+/* Returns a spline in which adjacent pairs of segments are replaced by one
+ * segment wherever it stays within tolerance of them, for drawing at a
+ * coarser scale. The merged segment has the same ends and end directions
+ * as the pair, with the handles lengthened in proportion to the lengths
+ * of the two segments, which are estimated from their chords and control
+ * polygons. It's checked by the distances from the quarter points of the
+ * two segments to the merged segment, not to the points of the merged
+ * segment at the same parameters, since lengthening the handles moves
+ * points along the curve more than off it.
+ */
+{
+  int i,j,n=size();
+  double lp,lq,a,err;
+  vector<xyz> p,q,r;
+  bezier3d ret,pseg,qseg,rseg;
+  for (i=0;i<n;i++)
+  {
+    p=(*this)[i];
+    pseg=bezier3d(p[0],p[1],p[2],p[3]);
+    err=INFINITY;
+    if (i+1<n)
+    {
+      q=(*this)[i+1];
+      qseg=bezier3d(q[0],q[1],q[2],q[3]);
+      lp=(2*dist(p[0],p[3])+dist(p[0],p[1])+dist(p[1],p[2])+dist(p[2],p[3]))/3;
+      lq=(2*dist(q[0],q[3])+dist(q[0],q[1])+dist(q[1],q[2])+dist(q[2],q[3]))/3;
+      if (lp>0 && lq>0)
+      {
+        a=lp/(lp+lq);
+        rseg=bezier3d(p[0],p[0]+(p[1]-p[0])/a,q[3]+(q[2]-q[3])/(1-a),q[3]);
+        r=rseg[0];
+        for (err=j=0;j<=4;j++)
+        {
+          err=fmax(err,segmentDistance(r,pseg.station(j/4.),a*j/4));
+          err=fmax(err,segmentDistance(r,qseg.station(j/4.),a+(1-a)*j/4));
+        }
+      }
+    }
+    if (err<=tolerance)
+    {
+      ret+=rseg;
+      i++;
+    }
+    else
+      ret+=pseg;
+  }
+  if (!isopen())
+    ret.close();
+  return ret;
+}
+
+BezierPyramid::BezierPyramid()
+{
+  baseTolerance=INFINITY;
+}
+
+void BezierPyramid::build(const bezier3d &finest,double tolerance,int maxLevels)
+/* finest is within tolerance of the curve. Each level is within twice the
+ * tolerance of the one below, since it's within that tolerance of the
+ * level below, which is within that tolerance of the curve. A level in
+ * which nothing merges is kept, as the next tolerance may merge it, but
+ * after four of them in a row it gives up and drops them.
+ */
+{
+  int stuck=0;
+  bezier3d next;
+  baseTolerance=tolerance;
+  levels.clear();
+  levels.push_back(finest);
+  while (levels.size()<maxLevels && levels.back().size()>1 && stuck<4)
+  {
+    next=levels.back().merged(this->tolerance(levels.size()-1));
+    if (next.size()==levels.back().size())
+      stuck++;
+    else
+      stuck=0;
+    levels.push_back(next);
+  }
+  levels.resize(levels.size()-stuck);
+}
+
+bezier3d *BezierPyramid::level(double tolerance)
+/* Returns the coarsest level within tolerance of the curve, or nullptr if
+ * even the finest isn't.
+ */
+{
+  int n;
+  if (levels.size()==0 || !(tolerance>=baseTolerance))
+    return nullptr;
+  n=floor(log2(tolerance/baseTolerance));
+  if (n>=levels.size())
+    n=levels.size()-1;
+  return &levels[n];
+}
+
 double bez3destimate(xy kra,int bear0,double len,int bear1,xy fam)
 /* This should be used only when bear0-direc, bear1-direc, and bear0+bear1-2*direc
  * are all less than 30°. If any of them is greater, split the curve.
@@ -25,6 +25,7 @@
 #ifndef BEZIER3D_H
 #define BEZIER3D_H
 #include <vector>
+#include <cmath>
 #include "xyz.h"
 #include "quaternion.h"
 
@@ -44,7 +45,33 @@ public:
   friend bezier3d operator+(const bezier3d &l,const bezier3d &r); // concatenates, not adds
   bezier3d& operator+=(const bezier3d &r);
   void rotate(Quaternion q);
+  bezier3d merged(double tolerance);
+};
+
+class BezierPyramid
+/* Approximations of a curve within tolerances that double from each level
+ * to the next, each made by merging pairs of segments of the one below,
+ * so that drawing the curve at any scale can use the coarsest one that
+ * is fine enough, without approximating the curve again.
+ */
+{
+public:
+  BezierPyramid();
+  void build(const bezier3d &finest,double tolerance,int maxLevels=16);
+  bezier3d *level(double tolerance);
+  int size()
+  {
+    return levels.size();
+  }
+  double tolerance(int n)
+  {
+    return ldexp(baseTolerance,n);
+  }
+private:
+  double baseTolerance;
+  std::vector<bezier3d> levels;
 };
 
 double bez3destimate(xy kra,int bear0,double len,int bear1,xy fam);
+double segmentDistance(const std::vector<xyz> &c,xyz pnt,double t);
 #endif
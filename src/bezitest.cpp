@@ -89,6 +89,10 @@
 #include "leastsquares.h"
 #include "smooth5.h"
 #include "readtin.h"
+#include "threads.h"
+#include "delaunay.h"
+#include "tiledtin.h"
+#include "mortonindex.h"
 
 #define psoutput true
 // affects only maketin
@@ -717,6 +721,164 @@ void testquaternion()
   tassert((op0-qr3).norm()<1e-9);
 }
 
+void testptlist()
+/* Adds points out of order, checks that they come out in order of number,
+ * that each knows its number, and that deleting and copying work, and
+ * that inserting and erasing in order keep them in order.
+ */
+{
+  ptlist pts,copy;
+  ptlist::iterator i;
+  point *p5;
+  int n,last;
+  bool inorder=true,numbered=true;
+  pts[5]=point(5,0,0,"five");
+  p5=&pts[5];
+  pts[9]=point(9,0,0,"nine");
+  pts[-2]=point(-2,0,0,"minus two");
+  pts[7]=point(7,0,0,"seven");
+  tassert(pts.size()==4 && pts.count(7) && !pts.count(6));
+  tassert(pts.lowest()==-2 && pts.highest()==9);
+  for (i=pts.begin(),n=0,last=-10;i!=pts.end();i++,n++)
+  {
+    inorder&=i->num>last;
+    numbered&=i->east()==i->num;
+    last=i->num;
+  }
+  tassert(n==4 && inorder && numbered);
+  pts.erase(9);
+  tassert(pts.size()==3 && pts.highest()==7 && &pts[5]==p5);
+  copy=pts;
+  tassert(copy[5].num==5 && copy[5].note=="five" && &copy[5]!=p5);
+  tassert(copy.size()==3);
+  pts.insertInOrder(6)=point(6,0,0,"six");
+  pts.insertInOrder(-5)=point(-5,0,0,"minus five");
+  pts.eraseInOrder(5);
+  for (i=pts.begin(),n=0,last=-10;i!=pts.end();i++,n++)
+  {
+    inorder&=i->num>last;
+    numbered&=i->east()==i->num;
+    last=i->num;
+  }
+  tassert(n==4 && inorder && numbered && pts.lowest()==-5);
+}
+
+void testarena()
+/* Checks that elements of an Arena stay put as it grows, that indexing
+ * past the end makes it longer, that copying and swapping work, and that
+ * find finds only its own elements.
+ */
+{
+  int i;
+  bool same=true;
+  Arena<edge> a,b;
+  edge *first;
+  a[0].flipcnt=100;
+  first=&a[0];
+  tassert(a.size()==1);
+  for (i=1;i<3*ARENA_CHUNK;i++)
+    a[i].flipcnt=i%1000;
+  tassert(a.size()==3*ARENA_CHUNK);
+  tassert(first==&a[0] && first->flipcnt==100);
+  tassert(&a[ARENA_CHUNK-1]==first+ARENA_CHUNK-1);
+  b=a;
+  for (i=1;i<b.size();i++)
+    same&=b[i].flipcnt==a[i].flipcnt;
+  tassert(same && b[0].flipcnt==100 && &b[0]!=first);
+  b.resize(5);
+  tassert(b.size()==5);
+  a.swap(b);
+  tassert(a.size()==5 && b.size()==3*ARENA_CHUNK && &b[0]==first);
+  tassert(b.find(&b[2*ARENA_CHUNK+7])==2*ARENA_CHUNK+7 && a.find(&a[4])==4);
+  tassert(b.find(&a[0])==-1 && a.find(&a[0]+5)==-1);
+  a.clear();
+  tassert(a.size()==0);
+}
+
+void testchunkvector()
+/* Inserts, erases, appends, and resizes at random in a ChunkVector and a
+ * vector, and checks that they stay the same. Then grows and shrinks it,
+ * inserting and erasing in the middle, and checks that the chunk size
+ * stays near the square root of the size.
+ */
+{
+  int i,j,pos,ndiff=0;
+  ChunkVector<int> cv;
+  vector<int> v;
+  for (i=0;i<20000;i++)
+  {
+    pos=v.size()?rng.usrandom()%(v.size()+1):0;
+    switch (rng.ucrandom()%8)
+    {
+      case 0:
+      case 1:
+      case 2:
+      case 3:
+	cv.insert(pos,i);
+	v.insert(v.begin()+pos,i);
+	break;
+      case 4:
+	if (pos<v.size())
+	{
+	  cv.erase(pos);
+	  v.erase(v.begin()+pos);
+	}
+	break;
+      case 5:
+	cv.push_back(i);
+	v.push_back(i);
+	break;
+      case 6:
+	if (v.size())
+	{
+	  cv.pop_back();
+	  v.pop_back();
+	}
+	break;
+      case 7:
+	if (rng.ucrandom()<4)
+	{
+	  cv.resize(pos/2,-1);
+	  v.resize(pos/2,-1);
+	}
+	else
+	{
+	  cv.insert(pos,cv.size()?cv[pos?pos-1:0]:0);
+	  v.insert(v.begin()+pos,v.size()?v[pos?pos-1:0]:0);
+	}
+	break;
+    }
+    if (cv.size()!=v.size())
+      ndiff++;
+    if (i%1000==0 || i==19999)
+      for (j=0;j<v.size();j++)
+	ndiff+=cv[j]!=v[j];
+  }
+  cout<<v.size()<<" elements, "<<ndiff<<" differences\n";
+  tassert(ndiff==0);
+  cv.clear();
+  tassert(cv.chunkSize()==1<<CHUNKVECTOR_MINSHIFT);
+  for (i=0;i<100000;i++)
+  {
+    cv.insert(cv.size()/2,i);
+    if ((i&(i+1))==0)
+      tassert(cv.chunkSize()*cv.chunkSize()>=cv.size()/2 && cv.chunkSize()<=(1<<CHUNKVECTOR_MINSHIFT)+sqrt(8*cv.size()));
+  }
+  cout<<cv.size()<<" elements in chunks of "<<cv.chunkSize()<<endl;
+  for (i=j=0;i<cv.size();i++)
+    j+=cv[i]!=(i<50000?2*i+1:199998-2*i);
+  while (cv.size()>100)
+  {
+    cv.erase(cv.size()/2);
+    if ((cv.size()&(cv.size()-1))==0)
+      tassert(cv.chunkSize()*cv.chunkSize()>=cv.size()/2 && cv.chunkSize()<=(1<<CHUNKVECTOR_MINSHIFT)+sqrt(8*cv.size()));
+  }
+  cout<<cv.size()<<" elements in chunks of "<<cv.chunkSize()<<endl;
+  for (i=0;i<cv.size();i++)
+    j+=cv[i]!=(i<50?2*i+1:199998-2*(i+99900));
+  tassert(j==0);
+}
+
 void testcopytopopoints()
 {
   //criteria crit;
@@ -1116,6 +1278,445 @@ void testmaketinellipse()
   tassert(fabs(totallength-1329.4675)<0.001);
 }
 
+void testmaketinengine()
+/* Compares the divide-and-conquer engine with the flipping engine.
+ * Both should produce the same number of edges; except in the ring,
+ * where there are many right answers, they should produce the same
+ * total length.
+ */
+{
+  int i,engine;
+  double totallength[2];
+  int nedges[2];
+  for (i=0;i<4;i++)
+  {
+    for (engine=0;engine<2;engine++)
+    {
+      doc.makepointlist(1);
+      doc.pl[1].clear();
+      switch (i)
+      {
+        case 0:
+          aster(doc,1000);
+          break;
+        case 1:
+          ring(doc,1000);
+          rotate(doc,30);
+          break;
+        case 2:
+          ellipse(doc,1000);
+          break;
+        case 3:
+          lozenge(doc,1000);
+          rotate(doc,30);
+          break;
+      }
+      doc.pl[1].maketin("",false,engine?TIN_DIVCONQ:TIN_FLIP);
+      nedges[engine]=doc.pl[1].edges.size();
+      totallength[engine]=doc.pl[1].totalEdgeLength();
+      doc.pl[1].maketriangles();
+      tassert(doc.pl[1].checkTinConsistency());
+    }
+    tassert(nedges[0]==nedges[1]);
+    if (i!=1)
+      tassert(fabs(totallength[0]-totallength[1])<1e-6*totallength[0]);
+  }
+}
+
+vector<array<int,2> > edgeSet(pointlist &pl)
+// Returns the edges of the TIN as sorted pairs of point numbers, in order.
+{
+  int i;
+  vector<array<int,2> > ret;
+  for (i=0;i<pl.edges.size();i++)
+  {
+    ret.push_back(array<int,2>{pl.edges[i].a->num,pl.edges[i].b->num});
+    if (ret.back()[0]>ret.back()[1])
+      swap(ret.back()[0],ret.back()[1]);
+  }
+  sort(ret.begin(),ret.end());
+  return ret;
+}
+
+void testmaketinparallel()
+/* Makes the big aster with the flip engine serially and in parallel.
+ * Both should produce the same TIN, edge for edge, as the big aster has
+ * no ties. On a one-processor machine, uses two threads anyway, so that
+ * the parallel flipping is tested.
+ */
+{
+  int engine;
+  vector<array<int,2> > edgeSets[2];
+  if (threadCount()<2)
+    setThreadCount(2);
+  for (engine=0;engine<2;engine++)
+  {
+    doc.makepointlist(1);
+    doc.pl[1].clear();
+    aster(doc,5972);
+    doc.pl[1].maketin("",false,engine?TIN_PARFLIP:TIN_FLIP);
+    edgeSets[engine]=edgeSet(doc.pl[1]);
+  }
+  setThreadCount(0);
+  tassert(edgeSets[0]==edgeSets[1]);
+}
+
+void testmaketinhilbert()
+/* Makes a TIN of an aster whose point numbers are scrambled, as in field
+ * data, with and without sorting the edges along a Hilbert curve, and
+ * checks that both are the same TIN, edge for edge.
+ */
+{
+  int sort;
+  vector<array<int,2> > edgeSets[2];
+  for (sort=0;sort<2;sort++)
+  {
+    doc.makepointlist(1);
+    doc.pl[1].clear();
+    scrambledAster(doc,30000);
+    doc.pl[1].maketin("",false,TIN_DIVCONQ,sort);
+    doc.pl[1].maketriangles();
+    edgeSets[sort]=edgeSet(doc.pl[1]);
+    tassert(doc.pl[1].checkTinConsistency());
+  }
+  tassert(edgeSets[0]==edgeSets[1]);
+}
+
+double breaklineLattice(int n,int engine,int &flips)
+/* Makes a TIN of a slightly jiggled n×n lattice with a breakline along
+ * every other diagonal. The lattice is surrounded by an ellipse of points,
+ * because the flip engine doesn't make the slivers along a nearly straight
+ * convex hull. Every breakline segment should end up an edge, and no edge
+ * should cross one. Returns the total length of the edges.
+ */
+{
+  int i,j,nsegs=0,nin,ncross;
+  Breakline0 bl;
+  xy pnt;
+  double ret;
+  doc.makepointlist(1);
+  doc.pl[1].clear();
+  for (i=0;i<n;i++)
+    for (j=0;j<n;j++)
+    {
+      pnt=xy(i+0.01*sin(7*i+13*j),j+0.01*cos(11*i+5*j));
+      doc.pl[1].addpoint(i*n+j+1,point(pnt,0,"test"));
+    }
+  for (i=0;i<8*n;i++)
+  {
+    pnt=xy((n-1)/2.+0.8*n*cos(i*M_PI/(4*n)),(n-1)/2.+0.9*n*sin(i*M_PI/(4*n)));
+    doc.pl[1].addpoint(n*n+i+1,point(pnt,0,"test"));
+  }
+  doc.pl[1].type0Breaklines.clear(); // clear() doesn't clear them
+  for (i=2-n;i<n-1;i+=2)
+  {
+    bl=Breakline0();
+    for (j=0;j<n;j++)
+      if (i+j>=0 && i+j<n)
+        bl<<(i+j)*n+j+1;
+    if (bl.size()>0)
+    {
+      nsegs+=bl.size();
+      doc.pl[1].type0Breaklines.push_back(bl);
+    }
+  }
+  flips=doc.pl[1].maketin("",false,engine);
+  cout<<n*n<<" points, "<<nsegs<<" breakline segments, "<<(engine==TIN_DIVCONQ?"divide-and-conquer":"flip")
+      <<" maketin made "<<flips<<" flips\n";
+  ret=doc.pl[1].totalEdgeLength();
+  for (i=nin=ncross=0;i<doc.pl[1].edges.size();i++)
+  {
+    j=doc.pl[1].checkBreak0(doc.pl[1].edges[i]);
+    nin+=(j&1);
+    ncross+=(j>>1)&1;
+  }
+  doc.pl[1].type0Breaklines.clear();
+  tassert(nin==nsegs);
+  tassert(ncross==0);
+  return ret;
+}
+
+void testmaketinbreak0()
+/* The breaklines are inserted directly, so the flip engine should end up
+ * with the same constrained Delaunay TIN as the divide-and-conquer engine,
+ * and the divide-and-conquer engine should need no flips. The flip engine
+ * is slow on a near lattice even without breaklines, so it's tested on a
+ * smaller one. Then checks that a breakline with a point on it is split
+ * there, without flipping.
+ */
+{
+  int i,j,k,nin,ncross;
+  int flips[2];
+  double totallength[2];
+  totallength[0]=breaklineLattice(30,TIN_DIVCONQ,flips[0]);
+  totallength[1]=breaklineLattice(30,TIN_FLIP,flips[1]);
+  tassert(flips[0]==0);
+  tassert(fabs(totallength[0]-totallength[1])<1e-9*totallength[0]);
+  breaklineLattice(100,TIN_DIVCONQ,flips[0]);
+  tassert(flips[0]==0);
+  for (i=0;i<2;i++)
+  {
+    doc.makepointlist(1);
+    doc.pl[1].clear();
+    doc.pl[1].addpoint(1,point(0,0,0,"test"));
+    doc.pl[1].addpoint(2,point(4,4,0,"test")); // on the breakline from 1 to 3
+    doc.pl[1].addpoint(3,point(8,8,0,"test"));
+    doc.pl[1].addpoint(4,point(2,2.3,0,"test"));
+    doc.pl[1].addpoint(5,point(2.3,2,0,"test"));
+    doc.pl[1].addpoint(6,point(6,6.3,0,"test"));
+    doc.pl[1].addpoint(7,point(6.3,6,0,"test"));
+    doc.pl[1].addpoint(8,point(0,8,0,"test"));
+    doc.pl[1].addpoint(9,point(8,0,0,"test"));
+    doc.pl[1].type0Breaklines.clear();
+    doc.pl[1].type0Breaklines.push_back(Breakline0());
+    doc.pl[1].type0Breaklines[0]<<1<<3;
+    flips[i]=doc.pl[1].maketin("",false,i?TIN_FLIP:TIN_DIVCONQ);
+    tassert(doc.pl[1].findEdge(&doc.pl[1].points[1],&doc.pl[1].points[2]));
+    tassert(doc.pl[1].findEdge(&doc.pl[1].points[2],&doc.pl[1].points[3]));
+    for (j=nin=ncross=0;j<doc.pl[1].edges.size();j++)
+    {
+      k=doc.pl[1].checkBreak0(doc.pl[1].edges[j]);
+      nin+=(k&1);
+      ncross+=(k>>1)&1;
+    }
+    tassert(nin==2 && ncross==0);
+    doc.pl[1].type0Breaklines.clear();
+  }
+  tassert(flips[0]==0);
+}
+
+void asterTin(int n,int surface)
+/* Makes a TIN of an aster of n points on a test surface, with the gradient,
+ * triangles, and qindex, as many of the TIN and contour tests start with.
+ */
+{
+  doc.makepointlist(1);
+  doc.pl[1].clear();
+  setsurface(surface);
+  aster(doc,n);
+  doc.pl[1].maketin();
+  doc.pl[1].makegrad(0.15);
+  doc.pl[1].maketriangles();
+  doc.pl[1].setgradient();
+  doc.pl[1].makeqindex();
+}
+
+int countNonDelaunay(pointlist &pl)
+// Counts the interior edges not in breaklines whose quadrilaterals fail the exact in-circle test.
+{
+  int i,n=0;
+  edge *e;
+  point *c,*d;
+  for (i=0;i<pl.edges.size();i++)
+  {
+    e=&pl.edges[i];
+    if (e->tria && e->trib && !(e->broken&1))
+    {
+      c=e->nextb->otherend(e->b);
+      d=e->nexta->otherend(e->a);
+      if (orient(*e->a,*e->b,*c)>0 && inCircleSign(*e->a,*e->b,*c,*d)>0)
+        n++;
+    }
+  }
+  return n;
+}
+
+void testtinedit()
+/* Inserts, moves, and removes points in a TIN, inside and outside the convex
+ * hull, on an edge, and on the hull, then checks that the TIN is the same as
+ * one made from scratch, and that the surface outside the dirty region is
+ * unchanged. Then checks that the points of a breakline stay put and that
+ * the breakline stays in the TIN.
+ */
+{
+  int i,j,n,nedges,ninserted=0,nremoved=0;
+  double totallength,maxerr=0;
+  vector<double> before;
+  vector<xy> samples;
+  xy pnt;
+  edge *e;
+  point *a,*b,*c;
+  asterTin(500,HYPAR);
+  doc.pl[1].findcriticalpts();
+  for (i=-30;i<=30;i++)
+    for (j=-30;j<=30;j++)
+    {
+      samples.push_back(xy(i*0.8,j*0.8));
+      before.push_back(doc.pl[1].elevation(samples.back()));
+    }
+  doc.pl[1].dirtyRegion.clear();
+  for (i=0;i<20;i++)
+  { // inside, near the middle
+    pnt=xy(cos(i*2.4)*i*0.3,sin(i*2.4)*i*0.3+0.1);
+    ninserted+=doc.pl[1].insertTinPoint(1000+i,point(pnt,testsurface(pnt),"ins"));
+  }
+  tassert(ninserted==20);
+  for (i=0;i<samples.size();i++)
+    if (!doc.pl[1].dirtyRegion.overlaps(samples[i],samples[i]))
+      if (!(std::isnan(before[i]) && std::isnan(doc.pl[1].elevation(samples[i]))))
+        maxerr=fmax(maxerr,fabs(before[i]-doc.pl[1].elevation(samples[i])));
+  cout<<"Dirty region "<<doc.pl[1].dirtyRegion.lo.east()<<','<<doc.pl[1].dirtyRegion.lo.north()
+      <<" to "<<doc.pl[1].dirtyRegion.hi.east()<<','<<doc.pl[1].dirtyRegion.hi.north()
+      <<", greatest change outside it "<<maxerr<<endl;
+  tassert(maxerr==0 && doc.pl[1].dirtyRegion.hi.east()<10);
+  tassert(!doc.pl[1].insertTinPoint(2000,doc.pl[1].points[5])); // same place as 5
+  tassert(!doc.pl[1].insertTinPoint(5,point(xy(0.5,0.5),0,"")));
+  tassert(doc.pl[1].insertTinPoint(1100,point(xy(30,0),1,"out")));
+  tassert(doc.pl[1].insertTinPoint(1101,point(xy(30,2),1,"out")));
+  tassert(doc.pl[1].insertTinPoint(1102,point(xy(30,1),1,"on edge")));
+  tassert(doc.pl[1].insertTinPoint(1103,point(xy(-40,-40),1,"far out")));
+  tassert(doc.pl[1].checkTinConsistency());
+  tassert(countNonDelaunay(doc.pl[1])==0);
+  for (i=1;i<=500;i+=37)
+    nremoved+=doc.pl[1].removeTinPoint(i);
+  for (i=480;i<=500;i++) // some of these are on the hull; 482 is already gone
+    nremoved+=doc.pl[1].removeTinPoint(i);
+  nremoved+=doc.pl[1].removeTinPoint(1103);
+  nremoved+=doc.pl[1].removeTinPoint(1005);
+  tassert(nremoved==14+20+2);
+  tassert(!doc.pl[1].removeTinPoint(1103));
+  tassert(doc.pl[1].moveTinPoint(1010,xyz(1.25,-2.5,7)));
+  tassert(doc.pl[1].moveTinPoint(100,xyz(doc.pl[1].points[100],3)));
+  pnt=doc.pl[1].points[101];
+  tassert(!doc.pl[1].moveTinPoint(101,doc.pl[1].points[102]));
+  tassert(doc.pl[1].points[101].line && xy(doc.pl[1].points[101])==pnt);
+  tassert(doc.pl[1].checkTinConsistency());
+  tassert(countNonDelaunay(doc.pl[1])==0);
+  nedges=doc.pl[1].edges.size();
+  totallength=doc.pl[1].totalEdgeLength();
+  n=doc.pl[1].triangles.size();
+  doc.pl[1].maketin();
+  doc.pl[1].maketriangles();
+  tassert(doc.pl[1].edges.size()==nedges);
+  tassert(doc.pl[1].triangles.size()==n);
+  tassert(fabs(doc.pl[1].totalEdgeLength()-totallength)<1e-9*totallength);
+  doc.pl[1].makeqindex();
+  tassert(doc.pl[1].insertTinPoint(3000,point(xy(2,2),1,"bl")));
+  tassert(doc.pl[1].insertTinPoint(3001,point(xy(6,2),1,"bl")));
+  doc.pl[1].type0Breaklines.push_back(Breakline0(3000,3001));
+  doc.pl[1].maketin();
+  doc.pl[1].makegrad(0.15);
+  doc.pl[1].maketriangles();
+  doc.pl[1].setgradient();
+  doc.pl[1].makeqindex();
+  a=&doc.pl[1].points[3000];
+  b=&doc.pl[1].points[3001];
+  e=doc.pl[1].findEdge(a,b);
+  tassert(e && (e->broken&1));
+  tassert(!doc.pl[1].removeTinPoint(3000));
+  tassert(!doc.pl[1].moveTinPoint(3001,xyz(6,3,1)));
+  tassert(doc.pl[1].findEdge(a,b)==e && xy(*b)==xy(6,2));
+  tassert(doc.pl[1].moveTinPoint(3001,xyz(6,2,4)));
+  e->broken&=~4; // make checkBreak0 compare it with the breakline again
+  tassert(doc.pl[1].checkBreak0(*e)&1);
+  tassert(doc.pl[1].insertTinPoint(3002,point(xy(4,2),1,"on bl")));
+  c=&doc.pl[1].points[3002];
+  tassert((doc.pl[1].findEdge(a,c)->broken&1) && (doc.pl[1].findEdge(c,b)->broken&1));
+  tassert(!doc.pl[1].removeTinPoint(3002));
+  tassert(doc.pl[1].checkTinConsistency());
+  doc.pl[1].maketin();
+  tassert(doc.pl[1].findEdge(a,c) && doc.pl[1].findEdge(c,b));
+  doc.pl[1].type0Breaklines.clear();
+}
+
+void benchmaketin()
+/* Times the TIN engines on the test patterns, serial and parallel flipping,
+ * making a TIN with and without Hilbert sorting, and editing a big TIN.
+ * Not run by ctest.
+ */
+{
+  int i,engine,sort,flips[2];
+  double r;
+  long long times[2][3];
+  QElapsedTimer timer;
+  xy pnt;
+  string patname[4]={"aster","ring","ellipse","lozenge"};
+  for (i=0;i<4;i++)
+  {
+    for (engine=0;engine<2;engine++)
+    {
+      doc.makepointlist(1);
+      doc.pl[1].clear();
+      switch (i)
+      {
+        case 0:
+          aster(doc,1000);
+          break;
+        case 1:
+          ring(doc,1000);
+          rotate(doc,30);
+          break;
+        case 2:
+          ellipse(doc,1000);
+          break;
+        case 3:
+          lozenge(doc,1000);
+          rotate(doc,30);
+          break;
+      }
+      timer.start();
+      doc.pl[1].maketin("",false,engine?TIN_DIVCONQ:TIN_FLIP);
+      times[engine][0]=timer.nsecsElapsed();
+    }
+    cout<<patname[i]<<": flip "<<times[0][0]/1e6<<" ms, divide-and-conquer "<<times[1][0]/1e6<<" ms\n";
+  }
+  if (threadCount()<2)
+    setThreadCount(2);
+  for (engine=0;engine<2;engine++)
+  {
+    doc.makepointlist(1);
+    doc.pl[1].clear();
+    aster(doc,5972);
+    timer.start();
+    flips[engine]=doc.pl[1].maketin("",false,engine?TIN_PARFLIP:TIN_FLIP);
+    times[engine][0]=timer.nsecsElapsed();
+  }
+  cout<<"Serial: "<<flips[0]<<" flips in "<<times[0][0]/1e6<<" ms, "
+      <<flips[0]/(times[0][0]/1e9)<<" flips/s\n";
+  cout<<"Parallel: "<<flips[1]<<" flips in "<<times[1][0]/1e6<<" ms, "
+      <<flips[1]/(times[1][0]/1e9)/threadCount()<<" flips/s/thread ("
+      <<threadCount()<<" threads)\n";
+  setThreadCount(0);
+  for (sort=0;sort<2;sort++)
+  {
+    doc.makepointlist(1);
+    doc.pl[1].clear();
+    scrambledAster(doc,30000);
+    timer.start();
+    doc.pl[1].maketin("",false,TIN_DIVCONQ,sort);
+    times[sort][0]=timer.restart();
+    doc.pl[1].maketriangles();
+    times[sort][1]=timer.restart();
+    doc.pl[1].makegrad(0.15);
+    times[sort][2]=timer.restart();
+  }
+  for (sort=0;sort<2;sort++)
+    cout<<(sort?"Hilbert-sorted: ":"Unsorted: ")<<"maketin "<<times[sort][0]
+        <<" ms, maketriangles "<<times[sort][1]<<" ms, makegrad "<<times[sort][2]<<" ms\n";
+  asterTin(100000,HYPAR);
+  timer.start();
+  for (i=0;i<100;i++)
+  {
+    r=sqrt(i*1000.+0.25);
+    pnt=xy(cos(i*1.1)*r,sin(i*1.1)*r);
+    doc.pl[1].insertTinPoint(200001+i,point(pnt,testsurface(pnt),""));
+  }
+  times[0][0]=timer.restart();
+  for (i=0;i<100;i++)
+    doc.pl[1].removeTinPoint(i*997+1);
+  times[0][1]=timer.restart();
+  for (i=0;i<100;i++)
+  {
+    pnt=xy(doc.pl[1].points[i*991+2])+xy(0.1,0.1);
+    doc.pl[1].moveTinPoint(i*991+2,xyz(pnt,testsurface(pnt)));
+  }
+  times[0][2]=timer.elapsed();
+  cout<<"100000 points: insert "<<times[0][0]*10<<" us, remove "<<times[0][1]*10
+      <<" us, move "<<times[0][2]*10<<" us per point\n";
+  tassert(doc.pl[1].checkTinConsistency());
+  tassert(countNonDelaunay(doc.pl[1])==0);
+}
+
 void testintloop()
 /* The biggest loop is
  * (1 150 104 138 169 21 217 16 9 27 49 145 151 254 226 43 58 172 200 128
@@ -1335,6 +1936,44 @@ void testehcycloid(PostScript &ps)
   ps.endpage();
 }
 
+void testbaretriangles()
+/* Makes a TIN of eight triangles in a square from bare triangles, whose
+ * shared corners differ slightly in elevation in some triangles, and checks
+ * that the corners are welded into nine points and that the edges are made
+ * and linked.
+ */
+{
+  int i,j,ninterior=0;
+  vector<array<xyz,3> > faces;
+  array<xyz,3> face;
+  ptlist::iterator k;
+  for (i=0;i<2;i++)
+    for (j=0;j<2;j++)
+    {
+      face[0]=xyz(i,j,i+j);
+      face[1]=xyz(i+1,j,i+j+1);
+      face[2]=xyz(i+1,j+1,i+j+2);
+      faces.push_back(face);
+      face[0]=xyz(i,j,i+j+0.001*(i+j));
+      face[1]=xyz(i,j+1,i+j+1);
+      face[2]=xyz(i+1,j+1,i+j+2+0.001);
+      faces.push_back(face);
+    }
+  doc.makepointlist(1);
+  doc.pl[1].makeBareTriangles(faces);
+  tassert(doc.pl[1].points.size()==9 && doc.pl[1].triangles.size()==8);
+  for (k=doc.pl[1].points.begin();k!=doc.pl[1].points.end();++k)
+    if (xy(*k)==xy(1,1))
+      tassert(k->elev()==2);
+  doc.pl[1].makeEdges();
+  for (i=0;i<doc.pl[1].edges.size();i++)
+    if (doc.pl[1].edges[i].tria && doc.pl[1].edges[i].trib)
+      ninterior++;
+  cout<<doc.pl[1].edges.size()<<" edges, "<<ninterior<<" interior\n";
+  tassert(doc.pl[1].edges.size()==16 && ninterior==8);
+  tassert(doc.pl[1].checkTinConsistency());
+}
+
 void testtripolygon()
 {
   PostScript ps;
@@ -1390,6 +2029,82 @@ void test1break0graph(pointlist &pl,string plname)
   }
 }
 
+void testtiledtin()
+/* Makes the TIN of an asteraceous pattern in tiles, and checks that it has
+ * the same triangles as the TIN made all at once, and that only a few
+ * tiles' worth of points were in memory at a time. Then adds a point twice
+ * and checks that it gives up without loading all the tiles.
+ */
+{
+  int i,n,ntri,nmatch=0;
+  bool threw=false;
+  ptlist::iterator j;
+  stringstream dxfFile;
+  vector<array<xyz,3> > faces;
+  set<array<double,6> > whole;
+  array<double,6> key;
+  array<xy,3> corners;
+  TiledTin tiled(".",8);
+  doc.makepointlist(1);
+  doc.pl[1].clear();
+  setsurface(HYPAR);
+  aster(doc,5000);
+  for (j=doc.pl[1].points.begin();j!=doc.pl[1].points.end();++j)
+    tiled.addPoint(*j);
+  tiled.finishPoints();
+  cout<<tiled.size()<<" points in "<<tiled.ntiles()<<" tiles\n";
+  tassert(tiled.size()==5000);
+  doc.pl[1].maketin();
+  doc.pl[1].maketriangles();
+  for (i=0;i<doc.pl[1].triangles.size();i++)
+  {
+    corners={*doc.pl[1].triangles[i].a,*doc.pl[1].triangles[i].b,*doc.pl[1].triangles[i].c};
+    sort(corners.begin(),corners.end(),[](xy a,xy b){return a.east()<b.east() || (a.east()==b.east() && a.north()<b.north());});
+    for (n=0;n<3;n++)
+    {
+      key[2*n]=corners[n].east();
+      key[2*n+1]=corners[n].north();
+    }
+    whole.insert(key);
+  }
+  ntri=tiled.triangulate(dxfFile,false);
+  faces=extractTriangles(readDxfGroups(dxfFile,false));
+  cout<<ntri<<" triangles in tiles, "<<whole.size()<<" all at once; at most "<<
+    tiled.maxLoaded<<" points loaded, "<<tiled.retries<<" retries\n";
+  tassert(ntri==faces.size());
+  tassert(ntri==whole.size());
+  for (i=0;i<faces.size();i++)
+  {
+    corners={faces[i][0],faces[i][1],faces[i][2]};
+    sort(corners.begin(),corners.end(),[](xy a,xy b){return a.east()<b.east() || (a.east()==b.east() && a.north()<b.north());});
+    for (n=0;n<3;n++)
+    {
+      key[2*n]=corners[n].east();
+      key[2*n+1]=corners[n].north();
+    }
+    nmatch+=whole.count(key);
+  }
+  tassert(nmatch==whole.size());
+  tassert(tiled.maxLoaded<tiled.size()/4);
+  TiledTin dup(".",8);
+  for (j=doc.pl[1].points.begin();j!=doc.pl[1].points.end();++j)
+    dup.addPoint(*j);
+  dup.addPoint(doc.pl[1].points[1]);
+  dup.finishPoints();
+  dxfFile.str("");
+  try
+  {
+    dup.triangulate(dxfFile,false);
+    threw=false;
+  }
+  catch (BeziExcept &ex)
+  {
+    threw=ex.getNumber()==samepnts;
+  }
+  cout<<"Duplicate point: at most "<<dup.maxLoaded<<" points loaded\n";
+  tassert(threw && dup.maxLoaded<dup.size()/4);
+}
+
 void testtindxf()
 {
   int i,acc,fmt;
@@ -4062,10 +4777,10 @@ void drawgrad(PostScript &ps,double scale)
   for (i=doc.pl[1].points.begin();i!=doc.pl[1].points.end();i++)
   {
     ps.setcolor(0,1,0);
-    ps.line2p(i->second,xy(i->second)+testsurfacegrad(i->second)*scale);
+    ps.line2p(*i,xy(*i)+testsurfacegrad(*i)*scale);
     ps.setcolor(0,0,0);
-    ps.dot(i->second);
-    ps.line2p(i->second,xy(i->second)+i->second.gradient*scale);
+    ps.dot(*i);
+    ps.line2p(*i,xy(*i)+i->gradient*scale);
   }
 }
 
@@ -4077,7 +4792,7 @@ void checkgrad(double &avgerror,double &maxerror)
   avgerror=maxerror=0;
   for (n=0,i=doc.pl[1].points.begin();i!=doc.pl[1].points.end();i++,n++)
   {
-    error=dist(i->second.gradient,testsurfacegrad(i->second));
+    error=dist(i->gradient,testsurfacegrad(*i));
     avgerror+=error*error;
     if (error>maxerror)
       maxerror=error;
@@ -4085,9 +4800,170 @@ void checkgrad(double &avgerror,double &maxerror)
   avgerror=sqrt(error/n);
 }
 
+void testmortonindex()
+/* Builds a MortonIndex and a qindex of the same TIN, checks that they have
+ * the same leaves and find the same triangles and points, writes the
+ * MortonIndex out and reads it back, and checks that reading a bad triangle
+ * number fails without adding triangles.
+ */
+{
+  int i,ntri,nbad=0;
+  double z0,z1;
+  triangle *t0,*t1;
+  vector<xy> pnts;
+  MortonIndex minx,minx1;
+  stringstream file;
+  string badIndex;
+  set<triangle *> near0,near1;
+  ptlist::iterator j;
+  doc.makepointlist(1);
+  doc.pl[1].clear();
+  setsurface(HYPAR);
+  aster(doc,10000);
+  doc.pl[1].maketin();
+  doc.pl[1].maketriangles();
+  doc.pl[1].makeqindex();
+  minx.build(doc.pl[1]);
+  minx.settri(doc.pl[1]);
+  cout<<minx.leaves()<<" leaves, "<<minx.size()<<" nodes, qindex "<<doc.pl[1].qinx.size()<<" nodes\n";
+  tassert(minx.size()==doc.pl[1].qinx.size());
+  tassert(minx.x==doc.pl[1].qinx.x && minx.y==doc.pl[1].qinx.y && minx.side==doc.pl[1].qinx.side);
+  for (i=0;i<100000;i++)
+    pnts.push_back(xy(rng.usrandom()/512.-64,rng.usrandom()/512.-64));
+  for (i=0;i<pnts.size();i++)
+  {
+    t0=doc.pl[1].qinx.findt(pnts[i]);
+    t1=minx.findt(pnts[i]);
+    z0=t0?t0->elevation(pnts[i]):NAN;
+    z1=t1?t1->elevation(pnts[i]):NAN;
+    if ((t0==nullptr)!=(t1==nullptr) || (t0 && !(fabs(z0-z1)<1e-9)))
+      nbad++;
+  }
+  tassert(minx.findt(xy(NAN,0),true)==nullptr);
+  tassert(minx.findt(xy(1000,1000))==nullptr);
+  tassert(minx.findt(xy(1000,1000),true)!=nullptr);
+  for (j=doc.pl[1].points.begin();j!=doc.pl[1].points.end();++j)
+    if (minx.findp(*j)!=&*j)
+      nbad++;
+  tassert(minx.findp(xy(pnts[0]))==nullptr);
+  cout<<nbad<<" disagree\n";
+  tassert(nbad==0);
+  near0=doc.pl[1].qinx.localTriangles(xy(10,10),5,1000);
+  near1=minx.localTriangles(xy(10,10),5,1000);
+  tassert(near0==near1 && near1.size()>1 && !near1.count(nullptr));
+  near1=minx.localTriangles(xy(10,10),5,3);
+  tassert(near1.size()==1 && near1.count(nullptr));
+  minx.write(file,doc.pl[1]);
+  tassert(minx1.read(file,doc.pl[1]));
+  tassert(minx1.size()==minx.size());
+  for (i=0;i<1000;i++)
+    if (minx.findt(pnts[i])!=minx1.findt(pnts[i]))
+      nbad++;
+  tassert(nbad==0);
+  file.str("garbage");
+  tassert(!minx1.read(file,doc.pl[1]));
+  tassert(minx1.leaves()==0 && minx1.findt(pnts[0],true)==nullptr);
+  file.str("");
+  file.clear();
+  minx.write(file,doc.pl[1]);
+  badIndex=file.str();
+  badIndex.replace(50,4,"\x00\xff\xff\x7f",4); // first leaf's triangle
+  file.str(badIndex);
+  ntri=doc.pl[1].triangles.size();
+  tassert(!minx1.read(file,doc.pl[1]));
+  tassert(doc.pl[1].triangles.size()==ntri);
+}
+
+void testnearest()
+/* Checks the nearest-neighbor and radius queries of a MortonIndex against
+ * a scan of all the points.
+ */
+{
+  int i,j,k,nbad=0;
+  vector<xy> qpnts;
+  vector<point *> found;
+  vector<pair<double,point *> > scan;
+  ptlist::iterator p;
+  MortonIndex minx;
+  doc.makepointlist(1);
+  doc.pl[1].clear();
+  aster(doc,20000);
+  tassert(minx.nearest(xy(0,0),3).size()==0);
+  minx.build(doc.pl[1]);
+  for (i=0;i<200;i++)
+    qpnts.push_back(xy(rng.usrandom()/256.-128,rng.usrandom()/256.-128));
+  for (i=0;i<qpnts.size();i++)
+  {
+    scan.clear();
+    for (p=doc.pl[1].points.begin();p!=doc.pl[1].points.end();++p)
+      scan.push_back(make_pair(dist(xy(*p),qpnts[i]),&*p));
+    sort(scan.begin(),scan.end());
+    for (k=1;k<=16;k*=4)
+    {
+      found=minx.nearest(qpnts[i],k);
+      if (found.size()!=k)
+        nbad++;
+      for (j=0;j<found.size();j++)
+        if (dist(xy(*found[j]),qpnts[i])!=scan[j].first)
+          nbad++;
+    }
+    found=minx.within(qpnts[i],3);
+    for (j=0;j<scan.size() && scan[j].first<=3;j++);
+    if (found.size()!=j)
+      nbad++;
+  }
+  tassert(minx.nearest(*doc.pl[1].points.begin(),1)[0]==&*doc.pl[1].points.begin());
+  tassert(minx.nearest(xy(0,0),30000).size()==doc.pl[1].points.size());
+  tassert(minx.within(xy(NAN,0),3).size()==0);
+  cout<<nbad<<" wrong\n";
+  tassert(nbad==0);
+}
+
+void testlocalsets()
+/* Sets the local sets for a small view of a big TIN, checks that they have
+ * no duplicates and include the edges in the middle of the view, and sets
+ * them repeatedly while moving the view.
+ */
+{
+  int i,nmissing=0;
+  xy center(10,-5);
+  double radius=6;
+  set<point *> pset;
+  set<edge *> eset;
+  set<triangle *> tset;
+  doc.makepointlist(1);
+  doc.pl[1].clear();
+  setsurface(HYPAR);
+  aster(doc,100000);
+  doc.pl[1].maketin();
+  doc.pl[1].maketriangles();
+  doc.pl[1].makeqindex();
+  doc.pl[1].setLocalSets(center,radius);
+  tassert(!doc.pl[1].localAll());
+  pset.insert(doc.pl[1].localPoints.begin(),doc.pl[1].localPoints.end());
+  eset.insert(doc.pl[1].localEdges.begin(),doc.pl[1].localEdges.end());
+  tset.insert(doc.pl[1].localTriangles.begin(),doc.pl[1].localTriangles.end());
+  cout<<pset.size()<<" points "<<eset.size()<<" edges "<<tset.size()<<" triangles\n";
+  tassert(pset.size()==doc.pl[1].localPoints.size());
+  tassert(eset.size()==doc.pl[1].localEdges.size());
+  tassert(tset.size()==doc.pl[1].localTriangles.size());
+  tassert(!pset.count(nullptr) && !eset.count(nullptr) && !tset.count(nullptr));
+  for (i=0;i<doc.pl[1].edges.size();i++)
+    if (dist(*doc.pl[1].edges[i].a,center)<radius/2 && dist(*doc.pl[1].edges[i].b,center)<radius/2 &&
+        !eset.count(&doc.pl[1].edges[i]))
+      nmissing++;
+  tassert(nmissing==0);
+  doc.pl[1].setLocalSets(center,1000);
+  tassert(doc.pl[1].localAll());
+  for (i=0;i<35;i++)
+    doc.pl[1].setLocalSets(center+xy(i%7,i%5),radius);
+  tassert(doc.pl[1].localEdges.size()>eset.size()/2);
+}
+
 void testmakegrad()
 {
   double avgerror,maxerror,corr;
+  int i,sweeps;
   xy grad63,grad63half;
   PostScript ps;
   doc.makepointlist(1);
@@ -4103,6 +4979,17 @@ void testmakegrad()
   printf("grad63 %f %f grad63half %f %f\n",grad63.east(),grad63.north(),grad63half.east(),grad63half.north());
   tassert(grad63==grad63half*2);
   enlarge(doc,0.5);
+  setThreadCount(4);
+  sweeps=doc.pl[1].makegrad(0.15,1e-9,100);
+  tassert(sweeps==doc.pl[1].gradLog.size());
+  for (i=0;i<sweeps;i++)
+    printf("sweep %d maxChange %e %f ms\n",i,doc.pl[1].gradLog[i].maxChange,doc.pl[1].gradLog[i].seconds*1e3);
+  tassert(sweeps<100 && doc.pl[1].gradLog.back().maxChange<=1e-9);
+  grad63=doc.pl[1].points[63].gradient;
+  setThreadCount(1); // must match the four-thread run exactly
+  tassert(doc.pl[1].makegrad(0.15,1e-9,100)==sweeps);
+  tassert(doc.pl[1].points[63].gradient==grad63);
+  setThreadCount(0);
   ps.open("gradient.ps");
   ps.prolog();
   for (corr=0;corr<=1;corr+=0.1)
@@ -4119,6 +5006,143 @@ void testmakegrad()
   ps.close();
 }
 
+void testlocator()
+/* Looks up elevations along raster rows, and at random points, with a
+ * Locator and through the qindex, and checks that they agree.
+ */
+{
+  int i,j,nbad=0;
+  double z0,z1;
+  vector<xy> pnts;
+  Locator loc(doc.pl[1].qinx);
+  asterTin(10000,HYPAR);
+  for (i=0;i<400;i++)
+    for (j=0;j<400;j++)
+      pnts.push_back(xy(j*0.26-52,51.9-i*0.26));
+  for (i=0;i<pnts.size();i++)
+  {
+    z0=doc.pl[1].elevation(pnts[i]);
+    z1=loc.elevation(pnts[i]);
+    if (!(std::isnan(z0) && std::isnan(z1)) && !(fabs(z0-z1)<1e-9))
+      nbad++;
+  }
+  for (i=0;i<10000;i++)
+  {
+    xy pnt(rng.usrandom()/512.-64,rng.usrandom()/512.-64);
+    z0=doc.pl[1].elevation(pnt);
+    z1=loc.elevation(pnt);
+    if (!(std::isnan(z0) && std::isnan(z1)) && !(fabs(z0-z1)<1e-9))
+      nbad++;
+  }
+  cout<<loc.queries<<" queries, "<<loc.steps<<" steps, "<<loc.jumps<<" jumps, "<<nbad<<" disagree\n";
+  tassert(nbad==0);
+  tassert(loc.jumps<loc.queries/5);
+}
+
+void testelevations()
+/* Computes the elevations of a grid, and of scattered points, one at a time
+ * and all at once, and checks that they agree.
+ */
+{
+  int i,j,nbad=0;
+  vector<xy> pnts;
+  vector<double> one,batch;
+  asterTin(10000,HYPAR);
+  for (i=0;i<500;i++)
+    for (j=0;j<500;j++)
+      pnts.push_back(xy(j*0.21-52,51.9-i*0.21));
+  for (i=0;i<10000;i++)
+    pnts.push_back(xy(rng.usrandom()/512.-64,rng.usrandom()/512.-64));
+  pnts.push_back(xy(NAN,0));
+  for (i=0;i<pnts.size();i++)
+    one.push_back(doc.pl[1].elevation(pnts[i]));
+  setThreadCount(4);
+  doc.pl[1].elevations(pnts,batch);
+  setThreadCount(0);
+  tassert(batch.size()==pnts.size());
+  for (i=0;i<pnts.size();i++)
+    if (!(std::isnan(one[i]) && std::isnan(batch[i])) && !(fabs(one[i]-batch[i])<1e-9))
+      nbad++;
+  cout<<nbad<<" of "<<pnts.size()<<" elevations disagree\n";
+  tassert(nbad==0);
+}
+
+void benchindex()
+/* Compares the speed of finding triangles with the qindex, a MortonIndex,
+ * and a Locator, of finding the nearest points with a MortonIndex and by
+ * scanning, of setting the local sets, and of computing elevations one at
+ * a time and all at once. Not run by ctest.
+ */
+{
+  int i,j,n;
+  vector<xy> rows,scattered;
+  vector<double> elevs;
+  vector<pair<double,point *> > scan;
+  ptlist::iterator p;
+  MortonIndex minx;
+  Locator loc(doc.pl[1].qinx);
+  QElapsedTimer timer;
+  long long qtime,mtime,ltime;
+  for (i=0;i<400;i++)
+    for (j=0;j<400;j++)
+      rows.push_back(xy(j*0.26-52,51.9-i*0.26));
+  for (i=0;i<100000;i++)
+    scattered.push_back(xy(rng.usrandom()/512.-64,rng.usrandom()/512.-64));
+  asterTin(10000,HYPAR);
+  minx.build(doc.pl[1]);
+  minx.settri(doc.pl[1]);
+  timer.start();
+  for (n=i=0;i<scattered.size();i++)
+    n+=doc.pl[1].qinx.findt(scattered[i])!=nullptr;
+  qtime=timer.nsecsElapsed();
+  timer.start();
+  for (n=i=0;i<scattered.size();i++)
+    n+=minx.findt(scattered[i])!=nullptr;
+  mtime=timer.nsecsElapsed();
+  cout<<"Scattered: qindex "<<scattered.size()*1e3/qtime<<" M queries/s, MortonIndex "<<
+    scattered.size()*1e3/mtime<<" M queries/s\n";
+  timer.start();
+  for (n=i=0;i<rows.size();i++)
+    n+=doc.pl[1].findt(rows[i])!=nullptr;
+  qtime=timer.nsecsElapsed();
+  timer.start();
+  for (n=i=0;i<rows.size();i++)
+    n+=loc.findt(rows[i])!=nullptr;
+  ltime=timer.nsecsElapsed();
+  cout<<"Rows: qindex "<<rows.size()*1e3/qtime<<" M queries/s, locator "<<
+    rows.size()*1e3/ltime<<" M queries/s\n";
+  timer.start();
+  for (i=0;i<rows.size();i++)
+    doc.pl[1].elevation(rows[i]);
+  qtime=timer.nsecsElapsed();
+  setThreadCount(4);
+  timer.start();
+  doc.pl[1].elevations(rows,elevs);
+  ltime=timer.nsecsElapsed();
+  setThreadCount(0);
+  cout<<"Elevations: one at a time "<<rows.size()*1e3/qtime<<" M/s, batch "<<
+    rows.size()*1e3/ltime<<" M/s\n";
+  timer.start();
+  for (i=n=0;i<200;i++)
+    n+=minx.nearest(scattered[i],4).size();
+  mtime=timer.nsecsElapsed();
+  timer.start();
+  for (i=0;i<200;i++)
+  {
+    scan.clear();
+    for (p=doc.pl[1].points.begin();p!=doc.pl[1].points.end();++p)
+      scan.push_back(make_pair(dist(xy(*p),scattered[i]),&*p));
+    partial_sort(scan.begin(),scan.begin()+4,scan.end());
+  }
+  qtime=timer.nsecsElapsed();
+  cout<<"4 nearest: index "<<mtime/2e5<<" µs, scan "<<qtime/2e5<<" µs\n";
+  asterTin(100000,HYPAR);
+  timer.start();
+  for (i=0;i<1000;i++)
+    doc.pl[1].setLocalSets(xy(10,-5)+xy(i%7,i%5),6);
+  cout<<"Local sets: "<<timer.nsecsElapsed()/1e6<<" µs per view\n";
+}
+
 void testrasterdraw()
 {
   doc.makepointlist(1);
@@ -4217,9 +5241,14 @@ void test1tri(string triname,int excrits)
     ofile<<fixed<<setprecision(3)<<setw(7)<<crits[j].east()<<setw(7)<<crits[j].north()<<endl;
     ps.dot(crits[j]);
   }
+  tassert(doc.pl[1].triangles[0].subdiv().size()==0);
+#ifndef FLATTRIANGLE
+  tassert(doc.pl[1].triangles[0].critpoints().size()==0);
+#endif
+  tassert(doc.pl[1].triangles[0].cold.p==nullptr);
   doc.pl[1].triangles[0].findcriticalpts();
 #ifndef FLATTRIANGLE
-  crits=doc.pl[1].triangles[0].critpoints;
+  crits=doc.pl[1].triangles[0].critpoints();
 #endif
   for (j=0;j<crits.size();j++)
   {
@@ -4237,27 +5266,29 @@ void test1tri(string triname,int excrits)
 	ps.dot(doc.pl[1].edges[j].critpoint(i));
   }
   doc.pl[1].triangles[0].subdivide();
-  size0=doc.pl[1].triangles[0].subdiv.size();
+  size0=doc.pl[1].triangles[0].subdiv().size();
   doc.pl[1].triangles[0].addperimeter();
-  size1=doc.pl[1].triangles[0].subdiv.size();
-  /*for (j=0;j<doc.pl[1].triangles[0].subdiv.size();j++)
+  size1=doc.pl[1].triangles[0].subdiv().size();
+  /*for (j=0;j<doc.pl[1].triangles[0].subdiv().size();j++)
   {
     cout<<j<<"L: "<<doc.pl[1].triangles[0].proceed(j,0)<<endl;
     cout<<j<<"R: "<<doc.pl[1].triangles[0].proceed(j+65536,0)<<endl;
   }*/
   doc.pl[1].triangles[0].removeperimeter();
-  size2=doc.pl[1].triangles[0].subdiv.size();
+  size2=doc.pl[1].triangles[0].subdiv().size();
   tassert(size0==size2);
   cout<<size1-size0<<" monotonic segments in perimeter"<<endl;
   lh=doc.pl[1].triangles[0].lohi();
   cout<<"lohi: "<<setprecision(7)<<lh[0]<<' '<<lh[1]<<' '<<lh[2]<<' '<<lh[3]<<endl;
-  for (j=0;j<doc.pl[1].triangles[0].subdiv.size();j++)
-    ps.spline(doc.pl[1].triangles[0].subdiv[j].approx3d(1));
-  clipped=doc.pl[1].triangles[0].dirclip(xy(1,2),AT34);
+  for (j=0;j<doc.pl[1].triangles[0].subdiv().size();j++)
+    ps.spline(segment(doc.pl[1].triangles[0].subdiv()[j]).approx3d(1));
+  clipped=doc.pl[1].triangles[0].dirclip(xy(1,2),AT34,doc.pl[1].triangles[0].elevation(xy(1,2)));
   ps.setcolor(1,0,1);
   ps.spline(clipped.approx3d(1));
   ps.endpage();
   ps.close();
+  doc.pl[1].triangles[0].dropCold();
+  tassert(doc.pl[1].triangles[0].cold.p==nullptr);
   cout<<fname<<endl;
   if (crits.size()!=excrits && excrits>=0)
     cout<<crits.size()<<" critical points found, "<<excrits<<" expected"<<endl;
@@ -4273,26 +5304,26 @@ void test1grad()
 {
   xyz grad3;
   xy pt,grad2;
-  map<int,triangle>::iterator i;
-  int j;
+  int i,j;
+  triangle *tri;
   vector<double> xsect,ysect;
   doc.pl[1].maketriangles();
   doc.pl[1].setgradient();
   doc.pl[1].makeqindex();
-  for (i=doc.pl[1].triangles.begin();i!=doc.pl[1].triangles.end();i++)
+  for (i=0;i<doc.pl[1].triangles.size();i++)
   {
-    pt=(*i->second.a+*i->second.b*2+*i->second.c*3)/6;
-    i->second.setgradmat();
-    grad3=i->second.gradient3(pt);
-    grad2=i->second.gradient(pt);
+    tri=&doc.pl[1].triangles[i];
+    pt=(*tri->a+*tri->b*2+*tri->c*3)/6;
+    grad3=tri->gradient3(pt);
+    grad2=tri->gradient(pt);
     //cout<<grad3.east()<<' '<<grad3.north()<<' '<<grad3.elev()<<endl;
     cout<<"Computed gradient: "<<grad2.east()<<','<<grad2.north()<<' ';
     xsect.clear();
     ysect.clear();
     for (j=-3;j<4;j+=2)
     {
-      xsect.push_back(i->second.elevation(pt+xy(j*0.5,0)));
-      ysect.push_back(i->second.elevation(pt+xy(0,j*0.5)));
+      xsect.push_back(tri->elevation(pt+xy(j*0.5,0)));
+      ysect.push_back(tri->elevation(pt+xy(0,j*0.5)));
     }
     cout<<"Actual gradient: "<<deriv1(xsect)<<','<<deriv1(ysect)<<endl;
     tassert(dist(xy(deriv1(xsect),deriv1(ysect)),grad2)<1e-6);
@@ -5975,15 +7006,15 @@ void test1contour(string contourName,xyz offset,xy tripoint,double conterval,dou
   doc.pl[1].addperimeter();
   tri=doc.pl[1].qinx.findt(tripoint-xy(offset)); // the triangle where the spike occurs
 #ifndef FLATTRIANGLE
-  for (i=0;tri && i<tri->critpoints.size();i++)
+  for (i=0;tri && i<tri->critpoints().size();i++)
   {
-    crit=tri->critpoints[i];
+    crit=tri->critpoints()[i];
     cout<<"crit "<<i<<' '<<ldecimal(crit.getx(),prec)<<','<<ldecimal(crit.gety(),prec)<<'\n';
   }
 #endif
-for (i=0;tri && i<tri->subdiv.size();i++)
+for (i=0;tri && i<tri->subdiv().size();i++)
   {
-    seg=tri->subdiv[i];
+    seg=tri->subdiv()[i];
     cout<<"seg "<<i<<' '<<ldecimal(seg.getstart().getx(),prec)<<','<<ldecimal(seg.getstart().gety(),prec);
     cout<<"->"<<ldecimal(seg.getend().getx(),prec)<<','<<ldecimal(seg.getend().gety(),prec)<<'\n';
     cout<<ldecimal(seg.getstart().getz(),prec)<<' '<<ldecimal(seg.startslope(),prec)
@@ -5991,8 +7022,8 @@ for (i=0;tri && i<tri->subdiv.size();i++)
   }
   ps.setcolor(0,1,1);
   for (i=0;i<doc.pl[1].triangles.size();i++)
-    for (j=0;j<doc.pl[1].triangles[i].subdiv.size();j++)
-      ps.spline(doc.pl[1].triangles[i].subdiv[j].approx3d(1));
+    for (j=0;j<doc.pl[1].triangles[i].subdiv().size();j++)
+      ps.spline(segment(doc.pl[1].triangles[i].subdiv()[j]).approx3d(1));
   rasterdraw(doc.pl[1],-offset,30,30,30,0,10*conterval,contourName+".ppm");
   //cout<<"Lowest "<<tinlohi[0]<<" Highest "<<tinlohi[1]<<endl;
   roughcontours(doc.pl[1],conterval);
@@ -6007,8 +7038,8 @@ for (i=0;tri && i<tri->subdiv.size();i++)
   ps.setscale(-10-offset.getx(),-10-offset.gety(),10-offset.getx(),10-offset.gety(),0);
   ps.setcolor(0,1,1);
   for (i=0;i<doc.pl[1].triangles.size();i++)
-    for (j=0;j<doc.pl[1].triangles[i].subdiv.size();j++)
-      ps.spline(doc.pl[1].triangles[i].subdiv[j].approx3d(1));
+    for (j=0;j<doc.pl[1].triangles[i].subdiv().size();j++)
+      ps.spline(segment(doc.pl[1].triangles[i].subdiv()[j]).approx3d(1));
   rasterdraw(doc.pl[1],-offset,30,30,30,0,10*conterval,contourName+".ppm");
   //cout<<"Lowest "<<tinlohi[0]<<" Highest "<<tinlohi[1]<<endl;
   //psclose();
@@ -6065,6 +7096,415 @@ for (i=0;tri && i<tri->subdiv.size();i++)
   tassert(maxElevError<conterval);
 }
 
+void testparallelcrit()
+/* Finds the critical points and subdivides the triangles with one thread
+ * and with several, and checks that the results are the same.
+ */
+{
+  int i,j,nthreads,ndiff=0;
+  vector<vector<segment> > serial;
+  asterTin(2000,CIRPAR);
+  for (nthreads=1;nthreads<=4;nthreads+=3)
+  {
+    setThreadCount(nthreads);
+    doc.pl[1].findcriticalpts();
+    for (i=0;i<doc.pl[1].triangles.size();i++)
+    {
+      if (nthreads==1)
+        serial.push_back(doc.pl[1].triangles[i].subdiv());
+      else if (serial[i].size()!=doc.pl[1].triangles[i].subdiv().size())
+        ndiff++;
+      else
+        for (j=0;j<serial[i].size();j++)
+          if (serial[i][j].getstart()!=doc.pl[1].triangles[i].subdiv()[j].getstart() ||
+              serial[i][j].getend()!=doc.pl[1].triangles[i].subdiv()[j].getend())
+            ndiff++;
+      doc.pl[1].triangles[i].dropCold();
+    }
+  }
+  setThreadCount(0);
+  cout<<ndiff<<" differences\n";
+  tassert(ndiff==0);
+}
+
+void testelevindex()
+/* Checks that RangeIndex finds the same ranges as spans(), and that
+ * rough contours drawn with the index are the same as without it.
+ */
+{
+  int i,j,nfound=0;
+  vector<array<double,2> > ranges;
+  vector<int> found,expected;
+  RangeIndex rinx;
+  ContourMarks marks;
+  vector<polyline> ctours;
+  unsigned indexHash=0,scanHash=0;
+  double conterval;
+  array<double,2> tinlohi;
+  for (i=0;i<1000;i++)
+  {
+    ranges.push_back(array<double,2>());
+    ranges.back()[0]=rng.usrandom()/64.;
+    ranges.back()[1]=ranges.back()[0]+rng.ucrandom()/8.;
+  }
+  ranges[0][0]=ranges[0][1]=500; // an empty range spans nothing
+  rinx.build(ranges);
+  tassert(rinx.size()==1000);
+  for (i=-64;i<1100;i++)
+  {
+    found=rinx.spanning(i);
+    expected.clear();
+    for (j=0;j<ranges.size();j++)
+      if (spans(ranges[j],i))
+        expected.push_back(j);
+    tassert(found==expected);
+    nfound+=found.size();
+  }
+  cout<<nfound<<" ranges found\n";
+  asterTin(2000,CIRPAR);
+  doc.pl[1].findcriticalpts();
+  doc.pl[1].addperimeter();
+  tinlohi=doc.pl[1].lohi();
+  conterval=(tinlohi[1]-tinlohi[0])/500;
+  roughcontours(doc.pl[1],conterval);
+  for (i=0;i<doc.pl[1].contours.size();i++)
+    indexHash+=doc.pl[1].contours[i].hash();
+  j=doc.pl[1].contours.size();
+  doc.pl[1].contours.clear();
+  marks.setup(doc.pl[1]);
+  for (i=floor(tinlohi[0]/conterval);i<=ceil(tinlohi[1]/conterval);i++)
+    rough1contour(doc.pl[1],i*conterval,ctours,marks);
+  for (i=0;i<ctours.size();i++)
+    doc.pl[1].contours.push_back(ctours[i]);
+  for (i=0;i<doc.pl[1].contours.size();i++)
+    scanHash+=doc.pl[1].contours[i].hash();
+  cout<<j<<" contours\n";
+  tassert(j==doc.pl[1].contours.size());
+  tassert(indexHash==scanHash);
+}
+
+void testparallelcontour()
+/* Draws rough contours with one thread and with several, after subdividing
+ * all triangles and lazily, and checks that the contours are the same.
+ */
+{
+  int i,nthreads,lazy,ncontours=0;
+  unsigned hash,serialHash=0;
+  double conterval;
+  array<double,2> tinlohi;
+  asterTin(2000,CIRPAR);
+  for (lazy=0;lazy<2;lazy++)
+    for (nthreads=1;nthreads<=4;nthreads+=3)
+    {
+      setThreadCount(nthreads);
+      doc.pl[1].findcriticalpts(lazy);
+      if (!lazy)
+        doc.pl[1].addperimeter();
+      if (!ncontours)
+      {
+        tinlohi=doc.pl[1].lohi();
+        conterval=(tinlohi[1]-tinlohi[0])/200;
+      }
+      roughcontours(doc.pl[1],conterval);
+      hash=0;
+      for (i=0;i<doc.pl[1].contours.size();i++)
+        hash+=doc.pl[1].contours[i].hash()*(i+1);
+      if (!ncontours)
+      {
+        ncontours=doc.pl[1].contours.size();
+        serialHash=hash;
+      }
+      tassert(doc.pl[1].contours.size()==ncontours);
+      tassert(hash==serialHash);
+    }
+  setThreadCount(0);
+}
+
+void testparallelsmooth()
+/* Smooths the same rough contours with one thread and with several, after
+ * subdividing all triangles and lazily, and checks that the smooth contours
+ * are the same. Lazily, the rough contours are drawn again each time, so
+ * that smoothing starts with the triangles tracing left unsubdivided.
+ */
+{
+  int i,nthreads,lazy;
+  unsigned hash,serialHash=0;
+  double conterval;
+  array<double,2> tinlohi;
+  vector<polyspiral> rough;
+  asterTin(2000,CIRPAR);
+  doc.pl[1].findcriticalpts();
+  doc.pl[1].addperimeter();
+  tinlohi=doc.pl[1].lohi();
+  conterval=(tinlohi[1]-tinlohi[0])/20;
+  roughcontours(doc.pl[1],conterval);
+  doc.pl[1].removeperimeter();
+  rough=doc.pl[1].contours;
+  for (lazy=0;lazy<2;lazy++)
+    for (nthreads=1;nthreads<=4;nthreads+=3)
+    {
+      setThreadCount(nthreads);
+      if (lazy)
+      {
+        doc.pl[1].findcriticalpts(true);
+        roughcontours(doc.pl[1],conterval);
+        doc.pl[1].removeperimeter();
+        tassert(doc.pl[1].contours.size()==rough.size());
+      }
+      else
+        doc.pl[1].contours=rough;
+      smoothcontours(doc.pl[1],conterval,true,false);
+      hash=0;
+      for (i=0;i<doc.pl[1].contours.size();i++)
+        hash+=doc.pl[1].contours[i].hash()*(i+1);
+      if (nthreads==1)
+        serialHash=hash;
+      tassert(hash==serialHash);
+    }
+  setThreadCount(0);
+}
+
+void testredrawcontour()
+/* Draws rough contours, edits the TIN, redraws the contours through the
+ * dirty region, and checks that there are as many contours of the same
+ * length at each elevation as when all are drawn again. Then does as
+ * Bezitopo does: draws rough contours, removes the perimeter, and smooths
+ * them; then edits the TIN, redraws and smooths the contours, and checks
+ * that there are as many at each elevation as rough contours drawn again.
+ */
+{
+  int i,nredrawn;
+  double conterval;
+  array<double,2> tinlohi;
+  map<int,int> counts,fullCounts;
+  map<int,double> lengths,fullLengths;
+  map<int,double>::iterator j;
+  xy pnt;
+  asterTin(2000,CIRPAR);
+  doc.pl[1].findcriticalpts();
+  doc.pl[1].addperimeter();
+  tinlohi=doc.pl[1].lohi();
+  conterval=(tinlohi[1]-tinlohi[0])/200;
+  roughcontours(doc.pl[1],conterval);
+  tassert(doc.pl[1].contourTriangles.size()==doc.pl[1].contours.size());
+  doc.pl[1].removeperimeter();
+  doc.pl[1].dirtyRegion.clear();
+  pnt=xy(doc.pl[1].points[300]);
+  tassert(doc.pl[1].moveTinPoint(300,xyz(pnt,doc.pl[1].points[300].elev()+3*conterval)));
+  pnt=(xy(doc.pl[1].points[300])+xy(doc.pl[1].points[321]))/2;
+  tassert(doc.pl[1].insertTinPoint(2001,point(pnt,testsurface(pnt)-2*conterval,"ins")));
+  tassert(doc.pl[1].removeTinPoint(334));
+  nredrawn=redrawcontours(doc.pl[1],conterval,false);
+  cout<<"Redrew "<<nredrawn<<" of "<<doc.pl[1].contours.size()<<" contours\n";
+  tassert(nredrawn>0 && nredrawn<doc.pl[1].contours.size()/2);
+  tassert(doc.pl[1].dirtyRegion.isEmpty());
+  for (i=0;i<doc.pl[1].contours.size();i++)
+  {
+    if (i)
+      tassert(doc.pl[1].contours[i].getElevation()>=doc.pl[1].contours[i-1].getElevation());
+    doc.pl[1].contours[i].setlengths();
+    counts[lrint(doc.pl[1].contours[i].getElevation()/conterval)]++;
+    lengths[lrint(doc.pl[1].contours[i].getElevation()/conterval)]+=doc.pl[1].contours[i].length();
+  }
+  doc.pl[1].addperimeter();
+  roughcontours(doc.pl[1],conterval);
+  for (i=0;i<doc.pl[1].contours.size();i++)
+  {
+    doc.pl[1].contours[i].setlengths();
+    fullCounts[lrint(doc.pl[1].contours[i].getElevation()/conterval)]++;
+    fullLengths[lrint(doc.pl[1].contours[i].getElevation()/conterval)]+=doc.pl[1].contours[i].length();
+  }
+  tassert(counts==fullCounts);
+  for (j=fullLengths.begin();j!=fullLengths.end();++j)
+    tassert(fabs(lengths[j->first]-j->second)<1e-9*j->second);
+  conterval*=10;
+  roughcontours(doc.pl[1],conterval);
+  doc.pl[1].removeperimeter();
+  smoothcontours(doc.pl[1],conterval,true,false);
+  doc.pl[1].dirtyRegion.clear();
+  pnt=xy(doc.pl[1].points[300]);
+  tassert(doc.pl[1].moveTinPoint(300,xyz(pnt,doc.pl[1].points[300].elev()+2*conterval)));
+  nredrawn=redrawcontours(doc.pl[1],conterval,true,false);
+  cout<<"Redrew and smoothed "<<nredrawn<<" of "<<doc.pl[1].contours.size()<<" contours\n";
+  tassert(nredrawn>0 && nredrawn<doc.pl[1].contours.size());
+  tassert(doc.pl[1].contours.size()==doc.pl[1].contourTriangles.size());
+  tassert(doc.pl[1].contours.size()==doc.pl[1].contourPyramids.size());
+  counts.clear();
+  fullCounts.clear();
+  for (i=0;i<doc.pl[1].contours.size();i++)
+  {
+    counts[lrint(doc.pl[1].contours[i].getElevation()/conterval)]++;
+    tassert(std::isfinite(doc.pl[1].contours[i].length()));
+  }
+  doc.pl[1].addperimeter();
+  roughcontours(doc.pl[1],conterval);
+  for (i=0;i<doc.pl[1].contours.size();i++)
+    fullCounts[lrint(doc.pl[1].contours[i].getElevation()/conterval)]++;
+  tassert(counts==fullCounts);
+}
+
+void testcontourpyramid()
+/* Builds a pyramid of a circle made of 256 segments and checks that each level is within its
+ * tolerance, then checks that smoothing contours builds their pyramids
+ * and that the coarse levels have fewer segments than approximating again.
+ */
+{
+  int i,j,k,nfine=0,ncoarse=0;
+  double conterval,err,maxerr,tol;
+  array<double,2> tinlohi;
+  double a0,a1;
+  bezier3d finest,*lev;
+  BezierPyramid pyr;
+  for (i=0;i<256;i++)
+  {
+    a0=i*M_PI/128;
+    a1=(i+1)*M_PI/128;
+    finest+=bezier3d(xyz(100*cos(a0),100*sin(a0),0),radtobin(a0+M_PI/2),0,0,
+		     radtobin(a1+M_PI/2),xyz(100*cos(a1),100*sin(a1),0));
+  }
+  pyr.build(finest,1e-6);
+  cout<<"Circle pyramid has "<<pyr.size()<<" levels:";
+  tassert(pyr.size()>1);
+  tassert(pyr.level(1e-7)==nullptr);
+  tassert(pyr.level(1e-6)->size()==finest.size());
+  tassert(pyr.level(1e6)->size()==pyr.level(pyr.tolerance(pyr.size()-1))->size());
+  for (k=0;k<pyr.size();k++)
+  {
+    lev=pyr.level(pyr.tolerance(k));
+    cout<<' '<<lev->size();
+    if (k)
+      tassert(lev->size()<=pyr.level(pyr.tolerance(k-1))->size());
+    maxerr=0;
+    for (i=0;i<lev->size()*16;i++)
+    {
+      err=fabs(dist(xy(lev->station(i/16.)),xy(0,0))-100);
+      if (err>maxerr)
+	maxerr=err;
+    }
+    tassert(maxerr<=pyr.tolerance(k)*1.001);
+  }
+  cout<<endl;
+  asterTin(500,CIRPAR);
+  doc.pl[1].findcriticalpts();
+  doc.pl[1].addperimeter();
+  tinlohi=doc.pl[1].lohi();
+  conterval=(tinlohi[1]-tinlohi[0])/20;
+  roughcontours(doc.pl[1],conterval);
+  tassert(doc.pl[1].contourPyramids.size()==0);
+  smoothcontours(doc.pl[1],conterval,true,false);
+  tassert(doc.pl[1].contourPyramids.size()==doc.pl[1].contours.size());
+  tol=conterval/4;
+  for (i=0;i<doc.pl[1].contours.size();i++)
+    nfine+=doc.pl[1].contours[i].approx3d(tol).size();
+  for (i=0;i<doc.pl[1].contours.size();i++)
+    ncoarse+=doc.pl[1].contourApprox(i,tol).size();
+  cout<<"Approximating again: "<<nfine<<" segments, from pyramids: "<<ncoarse<<" segments\n";
+  tassert(ncoarse<=nfine);
+  for (i=0;i<doc.pl[1].contours.size();i++)
+    tassert(doc.pl[1].contourApprox(i,conterval*PYRAMIDBASE/2).size()==
+	    doc.pl[1].contours[i].approx3d(conterval*PYRAMIDBASE/2).size());
+}
+
+void testlazycontour()
+/* Draws rough contours at a coarse interval after subdividing all triangles,
+ * and again subdividing them as tracing reaches them, and checks that the
+ * contours are the same and that fewer triangles were subdivided.
+ */
+{
+  int i,nsub=0;
+  unsigned eagerHash=0,lazyHash=0;
+  double conterval;
+  array<double,2> tinlohi;
+  asterTin(2000,CIRPAR);
+  tinlohi=doc.pl[1].lohi();
+  conterval=(tinlohi[1]-tinlohi[0])/7;
+  doc.pl[1].findcriticalpts();
+  doc.pl[1].addperimeter();
+  roughcontours(doc.pl[1],conterval);
+  for (i=0;i<doc.pl[1].contours.size();i++)
+    eagerHash+=doc.pl[1].contours[i].hash();
+  doc.pl[1].findcriticalpts(true);
+  roughcontours(doc.pl[1],conterval);
+  for (i=0;i<doc.pl[1].contours.size();i++)
+    lazyHash+=doc.pl[1].contours[i].hash();
+  for (i=0;i<doc.pl[1].triangles.size();i++)
+    nsub+=doc.pl[1].triangles[i].isSubdivided();
+  cout<<doc.pl[1].contours.size()<<" contours, "<<nsub<<" of "<<doc.pl[1].triangles.size()<<
+    " triangles subdivided\n";
+  tassert(eagerHash==lazyHash);
+  tassert(nsub<doc.pl[1].triangles.size()/2);
+  doc.pl[1].removeperimeter();
+  smoothcontours(doc.pl[1],conterval,true,false);
+  for (i=0;i<doc.pl[1].contours.size();i++)
+    tassert(std::isfinite(doc.pl[1].contours[i].length()));
+}
+
+void benchcontour()
+/* Times finding critical points, and drawing rough contours, with one
+ * thread and with several, eagerly and lazily; drawing with and without
+ * the elevation index; smoothing; and approximating from pyramids.
+ * Not run by ctest.
+ */
+{
+  int i,nthreads,lazy,nfine=0,ncoarse=0;
+  double conterval;
+  array<double,2> tinlohi;
+  ContourMarks marks;
+  vector<polyline> ctours;
+  vector<polyspiral> rough;
+  QElapsedTimer timer;
+  asterTin(2000,CIRPAR);
+  tinlohi=doc.pl[1].lohi();
+  conterval=(tinlohi[1]-tinlohi[0])/200;
+  for (lazy=0;lazy<2;lazy++)
+    for (nthreads=1;nthreads<=4;nthreads+=3)
+    {
+      setThreadCount(nthreads);
+      doc.pl[1].findcriticalpts(lazy);
+      if (!lazy)
+      {
+        cout<<nthreads<<" threads: edges "<<doc.pl[1].critLog.edgeSeconds<<
+          " s, critical points "<<doc.pl[1].critLog.critSeconds<<" s, subdivide "<<
+          doc.pl[1].critLog.subdivSeconds<<" s\n";
+        doc.pl[1].addperimeter();
+      }
+      timer.start();
+      roughcontours(doc.pl[1],conterval);
+      cout<<(lazy?"Lazy, ":"Eager, ")<<nthreads<<" threads: "<<doc.pl[1].contours.size()<<
+        " contours in "<<timer.nsecsElapsed()/1e6<<" ms\n";
+    }
+  setThreadCount(0);
+  timer.start();
+  marks.setup(doc.pl[1]);
+  for (i=floor(tinlohi[0]/conterval);i<=ceil(tinlohi[1]/conterval);i++)
+    rough1contour(doc.pl[1],i*conterval,ctours,marks);
+  cout<<"Without elevation index: "<<ctours.size()<<" contours in "<<timer.nsecsElapsed()/1e6<<" ms\n";
+  conterval*=10;
+  asterTin(2000,CIRPAR);
+  doc.pl[1].findcriticalpts();
+  doc.pl[1].addperimeter();
+  roughcontours(doc.pl[1],conterval);
+  doc.pl[1].removeperimeter();
+  rough=doc.pl[1].contours;
+  for (nthreads=1;nthreads<=4;nthreads+=3)
+  {
+    setThreadCount(nthreads);
+    doc.pl[1].contours=rough;
+    timer.start();
+    smoothcontours(doc.pl[1],conterval,true,false);
+    cout<<"Smoothing, "<<nthreads<<" threads: "<<timer.nsecsElapsed()/1e6<<" ms\n";
+  }
+  setThreadCount(0);
+  timer.start();
+  for (i=0;i<doc.pl[1].contours.size();i++)
+    nfine+=doc.pl[1].contours[i].approx3d(conterval).size();
+  cout<<"Approximating again: "<<nfine<<" segments in "<<timer.nsecsElapsed()/1e6<<" ms\n";
+  timer.start();
+  for (i=0;i<doc.pl[1].contours.size();i++)
+    ncoarse+=doc.pl[1].contourApprox(i,conterval).size();
+  cout<<"From pyramids: "<<ncoarse<<" segments in "<<timer.nsecsElapsed()/1e6<<" ms\n";
+}
+
 void testcontour()
 /* The total lengths of contours, especially of the wheel pattern, are
  * sensitive to bendlimit. The values 2490.48 and 1836.62 are for bendlimit=120°.
@@ -6168,8 +7608,8 @@ void testfoldcontour()
   doc.pl[1].addperimeter();
   ps.setcolor(0,1,1);
   for (i=0;i<doc.pl[1].triangles.size();i++)
-    for (j=0;j<doc.pl[1].triangles[i].subdiv.size();j++)
-      ps.spline(doc.pl[1].triangles[i].subdiv[j].approx3d(1));
+    for (j=0;j<doc.pl[1].triangles[i].subdiv().size();j++)
+      ps.spline(segment(doc.pl[1].triangles[i].subdiv()[j]).approx3d(1));
   //rasterdraw(doc.pl[1],xy(0,0),30,30,30,0,3,"foldcontour.ppm");
   //cout<<"Lowest "<<tinlohi[0]<<" Highest "<<tinlohi[1]<<endl;
   conterval=0.1;
@@ -6184,8 +7624,8 @@ void testfoldcontour()
   ps.setscale(194,-143,221,182,-DEG60);
   ps.setcolor(0,1,1);
   for (i=0;i<doc.pl[1].triangles.size();i++)
-    for (j=0;j<doc.pl[1].triangles[i].subdiv.size();j++)
-      ps.spline(doc.pl[1].triangles[i].subdiv[j].approx3d(1));
+    for (j=0;j<doc.pl[1].triangles[i].subdiv().size();j++)
+      ps.spline(segment(doc.pl[1].triangles[i].subdiv()[j]).approx3d(1));
   //rasterdraw(doc.pl[1],xy(0,0),30,30,30,0,3,"foldcontour.ppm");
   //cout<<"Lowest "<<tinlohi[0]<<" Highest "<<tinlohi[1]<<endl;
   smoothcontours(doc.pl[1],conterval);
@@ -6232,8 +7672,8 @@ void testtracingstop()
   doc.pl[1].addperimeter();
   ps.setcolor(0,1,1);
   for (i=0;i<doc.pl[1].triangles.size();i++)
-    for (j=0;j<doc.pl[1].triangles[i].subdiv.size();j++)
-      ps.spline(doc.pl[1].triangles[i].subdiv[j].approx3d(1));
+    for (j=0;j<doc.pl[1].triangles[i].subdiv().size();j++)
+      ps.spline(segment(doc.pl[1].triangles[i].subdiv()[j]).approx3d(1));
   //rasterdraw(doc.pl[1],xy(0,0),30,30,30,0,3,"foldcontour.ppm");
   //cout<<"Lowest "<<tinlohi[0]<<" Highest "<<tinlohi[1]<<endl;
   conterval=0.1;
@@ -6248,8 +7688,8 @@ void testtracingstop()
   ps.setscale(144,51,147,54,0);
   ps.setcolor(0,1,1);
   for (i=0;i<doc.pl[1].triangles.size();i++)
-    for (j=0;j<doc.pl[1].triangles[i].subdiv.size();j++)
-      ps.spline(doc.pl[1].triangles[i].subdiv[j].approx3d(1));
+    for (j=0;j<doc.pl[1].triangles[i].subdiv().size();j++)
+      ps.spline(segment(doc.pl[1].triangles[i].subdiv()[j]).approx3d(1));
   //rasterdraw(doc.pl[1],xy(0,0),30,30,30,0,3,"foldcontour.ppm");
   //cout<<"Lowest "<<tinlohi[0]<<" Highest "<<tinlohi[1]<<endl;
   smoothcontours(doc.pl[1],conterval);
@@ -6296,8 +7736,8 @@ void testzigzagcontour()
   doc.pl[1].addperimeter();
   ps.setcolor(0,1,1);
   for (i=0;i<doc.pl[1].triangles.size();i++)
-    for (j=0;j<doc.pl[1].triangles[i].subdiv.size();j++)
-      ps.spline(doc.pl[1].triangles[i].subdiv[j].approx3d(1));
+    for (j=0;j<doc.pl[1].triangles[i].subdiv().size();j++)
+      ps.spline(segment(doc.pl[1].triangles[i].subdiv()[j]).approx3d(1));
   //rasterdraw(doc.pl[1],xy(0,0),30,30,30,0,3,"zigzagcontour.ppm");
   //cout<<"Lowest "<<tinlohi[0]<<" Highest "<<tinlohi[1]<<endl;
   conterval=0.1;
@@ -6312,8 +7752,8 @@ void testzigzagcontour()
   ps.setscale(15111,14793,15346,15108,0);
   ps.setcolor(0,1,1);
   for (i=0;i<doc.pl[1].triangles.size();i++)
-    for (j=0;j<doc.pl[1].triangles[i].subdiv.size();j++)
-      ps.spline(doc.pl[1].triangles[i].subdiv[j].approx3d(1));
+    for (j=0;j<doc.pl[1].triangles[i].subdiv().size();j++)
+      ps.spline(segment(doc.pl[1].triangles[i].subdiv()[j]).approx3d(1));
   //rasterdraw(doc.pl[1],xy(0,0),30,30,30,0,3,"zigzagcontour.ppm");
   //cout<<"Lowest "<<tinlohi[0]<<" Highest "<<tinlohi[1]<<endl;
   smoothcontours(doc.pl[1],conterval);
@@ -8184,6 +9624,12 @@ int main(int argc, char *argv[])
     testmatrix();
   if (shoulddo("quaternion"))
     testquaternion();
+  if (shoulddo("arena"))
+    testarena();
+  if (shoulddo("chunkvector"))
+    testchunkvector();
+  if (shoulddo("ptlist"))
+    testptlist();
   if (shoulddo("copytopopoints"))
     testcopytopopoints();
   if (shoulddo("invalidintersectionlozenge"))
@@ -8210,12 +9656,28 @@ int main(int argc, char *argv[])
     testmaketinwheel();
   if (shoulddo("maketinellipse"))
     testmaketinellipse();
+  if (shoulddo("maketinengine"))
+    testmaketinengine();
+  if (shoulddo("maketinparallel"))
+    testmaketinparallel();
+  if (shoulddo("maketinhilbert"))
+    testmaketinhilbert();
+  if (shoulddo("maketinbreak0"))
+    testmaketinbreak0();
+  if (shoulddo("tinedit"))
+    testtinedit();
+  if (shoulddo("benchmaketin"))
+    benchmaketin(); // not in ctest
   if (shoulddo("intloop"))
     testintloop();
+  if (shoulddo("baretriangles"))
+    testbaretriangles();
   if (shoulddo("tripolygon"))
     testtripolygon();
   if (shoulddo("tindxf"))
     testtindxf();
+  if (shoulddo("tiledtin"))
+    testtiledtin();
   if (shoulddo("break0"))
     testbreak0();
   if (shoulddo("brent"))
@@ -8258,6 +9720,12 @@ int main(int argc, char *argv[])
     testclosest();
   if (shoulddo("qindex"))
     testqindex();
+  if (shoulddo("mortonindex"))
+    testmortonindex();
+  if (shoulddo("nearest"))
+    testnearest();
+  if (shoulddo("localsets"))
+    testlocalsets();
   if (shoulddo("makegrad"))
     testmakegrad();
   if (shoulddo("derivs"))
@@ -8270,6 +9738,12 @@ int main(int argc, char *argv[])
 #endif
   if (shoulddo("rasterdraw"))
     testrasterdraw(); // 2 s
+  if (shoulddo("locator"))
+    testlocator();
+  if (shoulddo("elevations"))
+    testelevations();
+  if (shoulddo("benchindex"))
+    benchindex(); // not in ctest
   if (shoulddo("dirbound"))
     testdirbound();
   if (shoulddo("stl"))
@@ -8300,6 +9774,22 @@ int main(int argc, char *argv[])
     testcolor();
   if (shoulddo("layer"))
     testlayer();
+  if (shoulddo("parallelcrit"))
+    testparallelcrit();
+  if (shoulddo("lazycontour"))
+    testlazycontour();
+  if (shoulddo("elevindex"))
+    testelevindex();
+  if (shoulddo("parallelcontour"))
+    testparallelcontour();
+  if (shoulddo("parallelsmooth"))
+    testparallelsmooth();
+  if (shoulddo("redrawcontour"))
+    testredrawcontour();
+  if (shoulddo("contourpyramid"))
+    testcontourpyramid();
+  if (shoulddo("benchcontour"))
+    benchcontour(); // not in ctest
   if (shoulddo("contour"))
     testcontour(); // >7 s
   if (shoulddo("foldcontour"))
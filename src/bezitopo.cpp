@@ -24,6 +24,7 @@
 
 #include <iostream>
 #include <cstdlib>
+#include <QTemporaryDir>
 #include "config.h"
 #include "point.h"
 #include "cogo.h"
@@ -49,6 +50,7 @@
 #include "curvefit.h"
 #include "csv.h"
 #include "ldecimal.h"
+#include "tiledtin.h"
 
 using namespace std;
 
@@ -156,8 +158,8 @@ void indpark(string args)
     ps.spline(doc.pl[1].edges[i].getsegment().approx3d(1));
   ps.setcolor(0,1,1);
   for (i=0;i<doc.pl[1].triangles.size();i++)
-    for (j=0;j<doc.pl[1].triangles[i].subdiv.size();j++)
-      ps.spline(doc.pl[1].triangles[i].subdiv[j].approx3d(1));
+    for (j=0;j<doc.pl[1].triangles[i].subdiv().size();j++)
+      ps.spline(segment(doc.pl[1].triangles[i].subdiv()[j]).approx3d(1));
   for (i=0;i<doc.pl[1].contours.size();i++)
   {
     if (i<0 && doc.pl[1].contours[i].getElevation()>doc.pl[1].contours[i-1].getElevation())
@@ -179,7 +181,7 @@ void indpark(string args)
 	ps.setcolor(0,0,0);
     }
     ps.comment("Elevation "+ldecimal(doc.pl[1].contours[i].getElevation())+" Contour #"+to_string(i));
-    ps.spline(doc.pl[1].contours[i].approx3d(0.1));
+    ps.spline(doc.pl[1].contourApprox(i,0.1));
   }
   ps.endpage();
   ps.trailer();
@@ -294,7 +296,7 @@ void trin_i(string args)
     pnt=parsexy(args);
     tri=doc.pl[1].qinx.findt(pnt);
     if (tri)
-      cout<<doc.pl[1].revpoints[tri->a]<<' '<<doc.pl[1].revpoints[tri->b]<<' '<<doc.pl[1].revpoints[tri->c]<<endl;
+      cout<<tri->a->num<<' '<<tri->b->num<<' '<<tri->c->num<<endl;
     else
       cout<<"Not in a triangle"<<endl;
   }
@@ -302,6 +304,81 @@ void trin_i(string args)
     cout<<"No TIN present. Please make a TIN first."<<endl;
 }
 
+void tiletin_i(string args)
+/* Makes the TIN of a PNEZD file with too many points to hold in memory,
+ * a few tiles at a time, and writes it to a DXF file as 3DFACEs. The tiles
+ * are kept in the scratch directory, if one is given, else in a temporary
+ * directory, while the TIN is made.
+ */
+{
+  string infilename,outfilename,sidestr,scratchdir,line;
+  vector<string> words;
+  double side,n,e,z;
+  int ntri;
+  ifstream infile;
+  ofstream outfile;
+  QTemporaryDir tempdir;
+  infilename=trim(firstarg(args));
+  outfilename=trim(firstarg(args));
+  sidestr=trim(firstarg(args));
+  scratchdir=trim(args);
+  try
+  {
+    side=doc.ms.parseMeasurement(sidestr,LENGTH).magnitude;
+  }
+  catch (BeziExcept &ex)
+  {
+    side=NAN;
+  }
+  if (!(side>0) || outfilename.length()==0)
+  {
+    cout<<"Usage: tiletin points.pnezd tin.dxf tileside [scratchdir]"<<endl;
+    return;
+  }
+  if (scratchdir.length()==0)
+  {
+    if (!tempdir.isValid())
+    {
+      cout<<"Can't make a temporary directory"<<endl;
+      return;
+    }
+    scratchdir=tempdir.path().toStdString();
+  }
+  infile.open(infilename);
+  if (!infile.is_open())
+  {
+    cout<<"Can't open "<<infilename<<endl;
+    return;
+  }
+  TiledTin tiled(scratchdir,side);
+  do
+  {
+    getline(infile,line);
+    while (line.length() && (line.back()=='\n' || line.back()=='\r'))
+      line.pop_back();
+    words=parsecsvline(line);
+    if (words.size()==5 && words[3]!="z" && words[3]!="Elevation")
+    {
+      n=doc.ms.parseMeasurement(words[1],LENGTH).magnitude;
+      e=doc.ms.parseMeasurement(words[2],LENGTH).magnitude;
+      z=doc.ms.parseMeasurement(words[3],LENGTH).magnitude;
+      tiled.addPoint(xyz(e,n,z));
+    }
+  } while (infile.good());
+  infile.close();
+  tiled.finishPoints();
+  outfile.open(outfilename,ios::binary);
+  try
+  {
+    ntri=tiled.triangulate(outfile,true);
+    cout<<ntri<<" triangles from "<<tiled.size()<<" points in "<<tiled.ntiles()<<" tiles"<<endl;
+  }
+  catch (BeziExcept &ex)
+  {
+    cout<<"Couldn't make TIN: "<<ex.message().toStdString()<<endl;
+  }
+}
+
 void rasterdraw_i(string args)
 {
   double w,e,s,n;
@@ -357,8 +434,8 @@ void contourdraw_i(string args)
 	ps.spline(doc.pl[1].edges[i].getsegment().approx3d(1));
       ps.setcolor(0,1,1);
       for (i=0;i<doc.pl[1].triangles.size();i++)
-	for (j=0;j<doc.pl[1].triangles[i].subdiv.size();j++)
-	  ps.spline(doc.pl[1].triangles[i].subdiv[j].approx3d(1));
+	for (j=0;j<doc.pl[1].triangles[i].subdiv().size();j++)
+	  ps.spline(segment(doc.pl[1].triangles[i].subdiv()[j]).approx3d(1));
       for (i=0;i<doc.pl[1].contours.size();i++)
       {
 	switch (lrint(doc.pl[1].contours[i].getElevation()/conterval)%10)
@@ -373,7 +450,7 @@ void contourdraw_i(string args)
 	    ps.setcolor(0,0,0);
 	}
 	ps.comment("Elevation "+ldecimal(doc.pl[1].contours[i].getElevation())+" Contour #"+to_string(i));
-	ps.spline(doc.pl[1].contours[i].approx3d(0.1));
+	ps.spline(doc.pl[1].contourApprox(i,0.1));
       }
       ps.endpage();
       ps.trailer();
@@ -561,6 +638,7 @@ int main(int argc, char *argv[])
   commands.push_back(command("factorll",scalefactorll_i,"Compute map scale factor from latitude and longitude"));
   commands.push_back(command("factorxy",scalefactorxy_i,"Compute map scale factor from grid coordinates"));
   commands.push_back(command("trin",trin_i,"Find what triangle a point is in: x,y"));
+  commands.push_back(command("tiletin",tiletin_i,"Make TIN of a big point file in tiles: filename.pnezd filename.dxf tileside [scratchdir]"));
   commands.push_back(command("help",help,"List commands"));
   commands.push_back(command("exit",exit,"Exit the program"));
   doc.pl.resize(1);
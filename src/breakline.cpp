@@ -24,7 +24,10 @@
 #include <cstring>
 #include <climits>
 #include <string>
+#include <cmath>
+#include <algorithm>
 #include "breakline.h"
+#include "segment.h"
 #include "except.h"
 using namespace std;
 
@@ -243,3 +246,89 @@ vector<string> parseBreakline(string line,char delim)
     ret.push_back(line);
   return ret;
 }
+
+SegmentGrid::SegmentGrid()
+{
+  clear();
+}
+
+void SegmentGrid::clear()
+{
+  cols=rows=0;
+  cell=0;
+  cells.clear();
+}
+
+int SegmentGrid::column(double x)
+{
+  return floor((x-corner.getx())/cell);
+}
+
+int SegmentGrid::row(double y)
+{
+  return floor((y-corner.gety())/cell);
+}
+
+void SegmentGrid::build(vector<segment> &segs)
+/* The squares are about as big as the average segment, but there are
+ * at most 1024 on a side.
+ */
+{
+  int i,j,k,c0,c1,r0,r1;
+  double minx=INFINITY,miny=INFINITY,maxx=-INFINITY,maxy=-INFINITY,extent=0;
+  xy a,b;
+  clear();
+  if (segs.size()==0)
+    return;
+  for (i=0;i<segs.size();i++)
+  {
+    a=segs[i].getstart();
+    b=segs[i].getend();
+    minx=min(minx,min(a.getx(),b.getx()));
+    miny=min(miny,min(a.gety(),b.gety()));
+    maxx=max(maxx,max(a.getx(),b.getx()));
+    maxy=max(maxy,max(a.gety(),b.gety()));
+    extent+=max(fabs(a.getx()-b.getx()),fabs(a.gety()-b.gety()));
+  }
+  corner=xy(minx,miny);
+  cell=max(extent/segs.size(),max(maxx-minx,maxy-miny)/1024);
+  if (cell==0)
+    cell=1;
+  cols=column(maxx)+1;
+  rows=row(maxy)+1;
+  cells.resize(cols*rows);
+  for (i=0;i<segs.size();i++)
+  {
+    a=segs[i].getstart();
+    b=segs[i].getend();
+    c0=column(min(a.getx(),b.getx()));
+    c1=column(max(a.getx(),b.getx()));
+    r0=row(min(a.gety(),b.gety()));
+    r1=row(max(a.gety(),b.gety()));
+    for (j=r0;j<=r1;j++)
+      for (k=c0;k<=c1;k++)
+        cells[j*cols+k].push_back(i);
+  }
+}
+
+vector<int> SegmentGrid::near(xy a,xy b)
+/* Returns the indices, without duplicates, of the segments which are
+ * listed in any square that the bounding rectangle of ab overlaps.
+ * Any segment that crosses or coincides with ab is among them.
+ */
+{
+  int i,j,c0,c1,r0,r1;
+  vector<int> ret;
+  if (cells.size()==0)
+    return ret;
+  c0=max(column(min(a.getx(),b.getx())),0);
+  c1=min(column(max(a.getx(),b.getx())),cols-1);
+  r0=max(row(min(a.gety(),b.gety())),0);
+  r1=min(row(max(a.gety(),b.gety())),rows-1);
+  for (i=r0;i<=r1;i++)
+    for (j=c0;j<=c1;j++)
+      ret.insert(ret.end(),cells[i*cols+j].begin(),cells[i*cols+j].end());
+  sort(ret.begin(),ret.end());
+  ret.erase(unique(ret.begin(),ret.end()),ret.end());
+  return ret;
+}
@@ -26,6 +26,7 @@
 #include <vector>
 #include <array>
 #include <iostream>
+#include "xyz.h"
 /* Bezitopo has two types of breaklines. A type-0 breakline is a sequence
  * of point numbers which are forced to be adjacent in the TIN. A type-1
  * breakline is a polyline which crosses some edges in the TIN and makes
@@ -57,4 +58,27 @@ private:
 };
 
 std::vector<std::string> parseBreakline(std::string line,char delim);
+
+class segment;
+
+class SegmentGrid
+/* A uniform grid of squares over a set of segments. Each square lists
+ * the segments whose bounding rectangles overlap it. Used to find the
+ * type-0 breakline segments that may cross an edge without looking at
+ * all of them.
+ */
+{
+public:
+  SegmentGrid();
+  void clear();
+  void build(std::vector<segment> &segs);
+  std::vector<int> near(xy a,xy b);
+private:
+  xy corner;
+  double cell;
+  int cols,rows;
+  std::vector<std::vector<int> > cells;
+  int column(double x);
+  int row(double y);
+};
 #endif
@@ -55,10 +55,7 @@ bool readCarlsonTin(std::string inputFile,pointlist &pl,double unit)
 	else if (outOfGeoRange(x,y,z))
 	  good=cont=false; // point is bigger than Earth, or is NaN
 	else
-	{
 	  pl.points[ptnum]=point(x,y,z,"");
-	  pl.revpoints[&pl.points[ptnum]]=ptnum;
-	}
 	break;
       case CA_TRIANGLE:
 	for (i=0;i<3;i++)
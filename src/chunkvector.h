@@ -0,0 +1,198 @@
+/******************************************************/
+/*                                                    */
+/* chunkvector.h - vectors with fast insertion        */
+/*                                                    */
+/******************************************************/
+/* Copyright 2026 Pierre Abbat.
+ * This file is part of Bezitopo.
+ *
+ * Bezitopo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Bezitopo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License and Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * and Lesser General Public License along with Bezitopo. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef CHUNKVECTOR_H
+#define CHUNKVECTOR_H
+#include <vector>
+
+#define CHUNKVECTOR_MINSHIFT 4
+
+/* A ChunkVector is a sequence which, like a vector, takes constant time to
+ * index, but which takes time proportional to the square root of its size,
+ * not to its size, to insert or erase in the middle. It's stored in chunks
+ * of a power of 2 elements, all full but the last, each a ring with its own
+ * starting place. Inserting shifts the elements of one chunk, then moves
+ * one element from the end of each chunk to the start of the next, so it
+ * takes time proportional to the chunk size plus the number of chunks.
+ * When there are twice as many chunks as elements in a chunk, the chunk
+ * size is doubled, and when there are fewer than an eighth as many, it's
+ * halved, so both stay near the square root of the size. Copying the
+ * elements into the new chunks takes linear time, but happens only when
+ * the size has changed by a factor of 4 or more, like growing a vector.
+ * Smoothing a contour inserts points all over it, which made a contour of
+ * tens of thousands of points take quadratic time when it was a vector.
+ * Values are passed by copy, since they may be elements of the ChunkVector,
+ * which adding a chunk would move.
+ */
+template <class T> class ChunkVector
+{
+public:
+  ChunkVector()
+  {
+    count=0;
+    shift=CHUNKVECTOR_MINSHIFT;
+    mask=(1<<shift)-1;
+  }
+  T &operator[](int n)
+  {
+    return at(n>>shift,n&mask);
+  }
+  const T &operator[](int n) const
+  {
+    return data[(n&~mask)+((starts[n>>shift]+n)&mask)];
+  }
+  size_t size() const
+  {
+    return count;
+  }
+  bool empty() const
+  {
+    return count==0;
+  }
+  int chunkSize() const
+  {
+    return mask+1;
+  }
+  T &back()
+  {
+    return (*this)[count-1];
+  }
+  void clear()
+  {
+    data.clear();
+    starts.clear();
+    count=0;
+    shift=CHUNKVECTOR_MINSHIFT;
+    mask=(1<<shift)-1;
+  }
+  void push_back(T val)
+  {
+    if (count==data.size())
+      addChunk();
+    (*this)[count++]=val;
+  }
+  void pop_back()
+  {
+    count--;
+    shrink();
+  }
+  void resize(int n,T val=T())
+  {
+    while (count>n && count>0)
+      pop_back();
+    while (count<n)
+      push_back(val);
+  }
+  void insert(int pos,T val)
+  {
+    int c,k,cnt;
+    T carry,next;
+    if (count==data.size())
+      addChunk();
+    c=pos>>shift;
+    cnt=chunkCount(c);
+    if (cnt==mask+1)
+      carry=at(c,mask);
+    for (k=cnt-(cnt==mask+1);k>(pos&mask);k--)
+      at(c,k)=at(c,k-1);
+    at(c,pos&mask)=val;
+    for (c++;cnt==mask+1 && c<starts.size();c++)
+    {
+      cnt=chunkCount(c);
+      next=at(c,mask);
+      starts[c]=(starts[c]-1)&mask;
+      at(c,0)=carry;
+      carry=next;
+    }
+    count++;
+  }
+  void erase(int pos)
+  {
+    int c,k,cnt;
+    c=pos>>shift;
+    cnt=chunkCount(c);
+    for (k=pos&mask;k<cnt-1;k++)
+      at(c,k)=at(c,k+1);
+    for (c++;c<starts.size() && chunkCount(c)>0;c++)
+    {
+      at(c-1,mask)=at(c,0);
+      starts[c]=(starts[c]+1)&mask;
+    }
+    count--;
+    shrink();
+  }
+private:
+  std::vector<T> data;
+  std::vector<int> starts; // where in its chunk each chunk's ring starts
+  int count;
+  int shift,mask; // the chunk size is 1<<shift
+  T &at(int c,int k)
+  {
+    return data[(c<<shift)+((starts[c]+k)&mask)];
+  }
+  int chunkCount(int c)
+  {
+    int n=count-(c<<shift);
+    if (n>mask+1)
+      n=mask+1;
+    if (n<0)
+      n=0;
+    return n;
+  }
+  void addChunk()
+  {
+    if (starts.size()>=2<<shift)
+      rechunk(shift+1);
+    if (count==data.size())
+    {
+      data.resize(data.size()+mask+1);
+      starts.push_back(0);
+    }
+  }
+  void shrink()
+  {
+    if (shift>CHUNKVECTOR_MINSHIFT && count<(1<<(2*shift-3)))
+      rechunk(shift-1);
+  }
+  void rechunk(int newShift)
+  /* Copies the elements in order into chunks of 1<<newShift elements,
+   * each starting at the start of its chunk.
+   */
+  {
+    std::vector<T> newData;
+    int i,nchunks;
+    nchunks=(count+(1<<newShift)-1)>>newShift;
+    newData.reserve(nchunks<<newShift);
+    for (i=0;i<count;i++)
+      newData.push_back((*this)[i]);
+    newData.resize(nchunks<<newShift);
+    data.swap(newData);
+    starts.assign(nchunks,0);
+    shift=newShift;
+    mask=(1<<shift)-1;
+  }
+};
+
+#endif
@@ -38,6 +38,7 @@
 #include "contour.h"
 #include "relprime.h"
 #include "ldecimal.h"
+#include "threads.h"
 using namespace std;
 
 float splittab[65]=
@@ -251,16 +252,107 @@ float splitpoint(double leftclamp,double rightclamp,double tolerance)
   return sp;
 }
 
-vector<uintptr_t> contstarts(pointlist &pts,double elev)
+bool spans(array<double,2> range,double elev)
+/* A segment crosses elev if one end is below it and the other isn't,
+ * so if a range spans elev, its low end is below it.
+ */
+{
+  return range[0]<elev && range[1]>=elev;
+}
+
+void RangeIndex::build(const vector<array<double,2> > &ranges)
+{
+  int i;
+  order.resize(ranges.size());
+  for (i=0;i<order.size();i++)
+    order[i]=i;
+  sort(order.begin(),order.end(),[&ranges](int a,int b){return ranges[a][0]<ranges[b][0];});
+  lows.resize(order.size());
+  highs.resize(order.size());
+  for (i=0;i<order.size();i++)
+  {
+    lows[i]=ranges[order[i]][0];
+    highs[i]=ranges[order[i]][1];
+  }
+  maxHigh.assign(4*order.size()+1,-INFINITY);
+  if (order.size())
+    buildNode(1,0,order.size());
+}
+
+double RangeIndex::buildNode(int node,int b,int e)
+{
+  int i;
+  double ret=-INFINITY;
+  if (e-b<=8)
+    for (i=b;i<e;i++)
+      ret=max(ret,highs[i]);
+  else
+    ret=max(buildNode(2*node,b,(b+e)/2),buildNode(2*node+1,(b+e)/2,e));
+  return maxHigh[node]=ret;
+}
+
+void RangeIndex::spanning(int node,int b,int e,int cut,double val,vector<int> &ret)
+// Only ranges before cut have their low ends below val.
+{
+  int i;
+  if (b<cut && maxHigh[node]>=val)
+  {
+    if (e-b<=8)
+    {
+      for (i=b;i<e && i<cut;i++)
+	if (highs[i]>=val)
+	  ret.push_back(order[i]);
+    }
+    else
+    {
+      spanning(2*node,b,(b+e)/2,cut,val,ret);
+      spanning(2*node+1,(b+e)/2,e,cut,val,ret);
+    }
+  }
+}
+
+vector<int> RangeIndex::spanning(double val)
+/* Returns the numbers, in order, of the ranges that span val as spans()
+ * does, with the low end below val and the high end not.
+ */
+{
+  vector<int> ret;
+  int cut=lower_bound(lows.begin(),lows.end(),val)-lows.begin();
+  if (order.size())
+    spanning(1,0,order.size(),cut,val,ret);
+  sort(ret.begin(),ret.end());
+  return ret;
+}
+
+void ElevationIndex::build(pointlist &pl)
+{
+  vector<array<double,2> > ranges;
+  int i;
+  for (i=0;i<pl.edges.size();i++)
+    ranges.push_back(pl.edges[i].elevRange());
+  edges.build(ranges);
+  ranges.clear();
+  for (i=0;i<pl.triangles.size();i++)
+    ranges.push_back(pl.triangles[i].ctrlRange());
+  triangles.build(ranges);
+}
+
+vector<uintptr_t> edgestarts(pointlist &pts,double elev,const vector<int> &edgeNums)
+/* Returns the pieces of the edges edgeNums where contours at elev start,
+ * those on the exterior first, so that an open contour is traced from
+ * its beginning.
+ */
 {
   vector<uintptr_t> ret;
   uintptr_t ep;
   int sd,io;
   triangle *tri;
-  int i,j;
+  int i,j,k;
   //cout<<"Exterior edges:";
   for (io=0;io<2;io++)
-    for (i=0;i<pts.edges.size();i++)
+    for (k=0;k<edgeNums.size();k++)
+    {
+      i=edgeNums[k];
       if (io==pts.edges[i].isinterior())
       {
 	tri=pts.edges[i].tria;
@@ -279,18 +371,60 @@ vector<uintptr_t> contstarts(pointlist &pts,double elev)
 	  }
 	}
       }
+    }
   //cout<<endl;
   return ret;
 }
 
-void mark(uintptr_t ep)
+vector<uintptr_t> contstarts(pointlist &pts,double elev,ElevationIndex *inx)
+/* Edges whose elevation range doesn't include elev are skipped before
+ * looking at their pieces, so that if the triangles are subdivided lazily,
+ * only those along the contour are subdivided. If there's an index,
+ * only the edges it finds are looked at.
+ */
+{
+  vector<int> edgeNums;
+  int i;
+  if (inx)
+    edgeNums=inx->edges.spanning(elev);
+  else
+    for (i=0;i<pts.edges.size();i++)
+      if (spans(pts.edges[i].elevRange(),elev))
+	edgeNums.push_back(i);
+  return edgestarts(pts,elev,edgeNums);
+}
+
+ContourMarks::ContourMarks()
 {
-  ((edge *)(ep&-4))->mark(ep&3);
+  pl=nullptr;
 }
 
-bool ismarked(uintptr_t ep)
+void ContourMarks::setup(pointlist &p)
 {
-  return ((edge *)(ep&-4))->ismarked(ep&3);
+  pl=&p;
+  bits.assign(pl->edges.size(),0);
+}
+
+void ContourMarks::clear()
+{
+  fill(bits.begin(),bits.end(),0);
+}
+
+void ContourMarks::clear(const vector<int> &edgeNums)
+{
+  int i;
+  for (i=0;i<edgeNums.size();i++)
+    bits[edgeNums[i]]=0;
+}
+
+void ContourMarks::mark(uintptr_t ep)
+{
+  bits[pl->edges.find((edge *)(ep&-4))]|=1<<(ep&3);
+}
+
+bool ContourMarks::ismarked(uintptr_t ep)
+{
+  return (bits[pl->edges.find((edge *)(ep&-4))]>>(ep&3))&1;
 }
 
 polyline intrace(triangle *tri,double elev)
@@ -307,14 +441,17 @@ polyline intrace(triangle *tri,double elev)
   int i,j=-610,start=-987;
   vector<int> sube;
   xy cept;
-  for (i=0;i<tri->subdiv.size();i++)
+  if (!spans(tri->ctrlRange(),elev))
+    return ret;
+  tri->needSubdiv(true);
+  for (i=0;i<tri->subdiv().size();i++)
     if (tri->crosses(i,elev))
     {
       start=i;
       if (!tri->upleft(start))
 	start+=65536;
       sube.clear();
-      for (j=start;sube.size()==0 || (j&65535)>(start&65535) && (j&65535)<tri->subdiv.size() && sube.size()<256;j=tri->proceed(j,elev))
+      for (j=start;sube.size()==0 || (j&65535)>(start&65535) && (j&65535)<tri->subdiv().size() && sube.size()<256;j=tri->proceed(j,elev))
 	sube.push_back(j);
       if (j==start)
 	break;
@@ -329,7 +466,8 @@ polyline intrace(triangle *tri,double elev)
   return ret;
 }
 
-polyline trace(uintptr_t edgep,double elev)
+polyline trace(uintptr_t edgep,double elev,ContourMarks &marks,vector<triangle *> *tris)
+// If tris is given, appends to it the triangles the contour goes through.
 {
   polyline ret(elev);
   int subedge,subnext,i;
@@ -341,7 +479,9 @@ polyline trace(uintptr_t edgep,double elev)
   ntri=((edge *)(edgep&-4))->trib;
   if (tri==nullptr || !tri->upleft(tri->subdir(edgep)))
     tri=ntri;
-  mark(edgep);
+  if (tris)
+    tris->push_back(tri);
+  marks.mark(edgep);
   firstcept=lastcept=tri->contourcept(tri->subdir(edgep),elev);
   if (firstcept.isnan())
   {
@@ -415,7 +555,7 @@ polyline trace(uintptr_t edgep,double elev)
     }
     else
     {
-      wasmarked=ismarked(edgep);
+      wasmarked=marks.ismarked(edgep);
       if (!wasmarked)
       {
 	thiscept=tri->contourcept(tri->subdir(edgep),elev);
@@ -427,11 +567,15 @@ polyline trace(uintptr_t edgep,double elev)
         }
 	lastcept=thiscept;
       }
-      mark(edgep);
+      marks.mark(edgep);
       ntri=((edge *)(edgep&-4))->othertri(tri);
     }
     if (ntri)
+    {
       tri=ntri;
+      if (tris)
+        tris->push_back(tri);
+    }
   } while (ntri && !wasmarked);
   if (!ntri)
     ret.open();
@@ -463,27 +607,65 @@ void checkedgediscrepancies(pointlist &pl)
   }
 }
 
-void rough1contour(pointlist &pl,double elev)
+vector<int> triangleNumbers(pointlist &pl,vector<triangle *> &tris)
+// Returns the numbers of tris, sorted, without duplicates.
+{
+  vector<int> ret;
+  int i;
+  for (i=0;i<tris.size();i++)
+    ret.push_back(pl.triangles.find(tris[i]));
+  sort(ret.begin(),ret.end());
+  ret.erase(unique(ret.begin(),ret.end()),ret.end());
+  return ret;
+}
+
+void rough1contour(pointlist &pl,double elev,vector<polyline> &ctours,
+                   ContourMarks &marks,ElevationIndex *inx,vector<vector<int> > *ctris)
+/* Appends the rough contours at elev to ctours, and if ctris is given,
+ * the numbers of the triangles each goes through to ctris. If there's
+ * an index, only the edges that span elev are unmarked, since tracing
+ * the contour looks only at edges it crosses. Writes nothing in pl if
+ * the triangles are already subdivided, so contours at different
+ * elevations can be traced in different threads.
+ */
 {
   vector<uintptr_t> cstarts;
+  vector<int> spanning;
+  vector<triangle *> tris;
   polyline ctour;
   int j;
-  cstarts=contstarts(pl,elev);
-  pl.clearmarks();
+  cstarts=contstarts(pl,elev,inx);
+  if (inx)
+  {
+    spanning=inx->edges.spanning(elev);
+    marks.clear(spanning);
+    spanning=inx->triangles.spanning(elev);
+  }
+  else
+  {
+    marks.clear();
+    for (j=0;j<pl.triangles.size();j++)
+      spanning.push_back(j);
+  }
   for (j=0;j<cstarts.size();j++)
-    if (!ismarked(cstarts[j]))
+    if (!marks.ismarked(cstarts[j]))
     {
-      ctour=trace(cstarts[j],elev);
+      tris.clear();
+      ctour=trace(cstarts[j],elev,marks,ctris?&tris:nullptr);
       ctour.dedup();
-      pl.contours.push_back(ctour);
+      ctours.push_back(ctour);
+      if (ctris)
+        ctris->push_back(triangleNumbers(pl,tris));
     }
-  for (j=0;j<pl.triangles.size();j++)
+  for (j=0;j<spanning.size();j++)
   {
-    ctour=intrace(&pl.triangles[j],elev);
+    ctour=intrace(&pl.triangles[spanning[j]],elev);
     if (ctour.size())
     {
       ctour.setlengths();
-      pl.contours.push_back(ctour);
+      ctours.push_back(ctour);
+      if (ctris)
+        ctris->push_back(vector<int>(1,spanning[j]));
     }
   }
 }
@@ -493,20 +675,64 @@ void roughcontours(pointlist &pl,double conterval)
  * The perimeter must be present in the triangles.
  * Do not attempt to draw contours in the Mariana Trench with conterval
  * less than 5 µm or of Chomolungma with conterval less than 4 µm. It will fail.
+ * The elevations are split among threads, each with its own marks, and
+ * the contours are put in pl.contours in order of elevation. Triangles
+ * left unsubdivided by a lazy findcriticalpts are subdivided first if a
+ * contour may go through them, since subdividing them while tracing
+ * isn't thread-safe.
  */
 {
   array<double,2> tinlohi;
-  int i;
+  ElevationIndex inx;
+  vector<vector<polyline> > levels;
+  vector<vector<vector<int> > > levelTris;
+  vector<ContourMarks> marks;
+  int i,j,lo,hi;
   pl.contours.clear();
+  pl.contourTriangles.clear();
+  pl.contourPyramids.clear();
   tinlohi=pl.lohi();
-  for (i=floor(tinlohi[0]/conterval);i<=ceil(tinlohi[1]/conterval);i++)
-    rough1contour(pl,i*conterval);
+  lo=floor(tinlohi[0]/conterval);
+  hi=ceil(tinlohi[1]/conterval);
+  inx.build(pl);
+  if (threadCount()>1)
+    parallelFor(pl.triangles.size(),[&](int begin,int end,int thread)
+    {
+      int i;
+      array<double,2> range;
+      for (i=begin;i<end;i++)
+      {
+        range=pl.triangles[i].ctrlRange();
+        if (spans(range,floor(range[1]/conterval)*conterval))
+          pl.triangles[i].needSubdiv(true);
+      }
+    });
+  levels.resize(hi-lo+1);
+  levelTris.resize(hi-lo+1);
+  marks.resize(threadCount());
+  parallelFor(levels.size(),[&](int begin,int end,int thread)
+  {
+    int i;
+    marks[thread].setup(pl);
+    for (i=begin;i<end;i++)
+      rough1contour(pl,(i+lo)*conterval,levels[i],marks[thread],&inx,&levelTris[i]);
+  });
+  for (i=0;i<levels.size();i++)
+    for (j=0;j<levels[i].size();j++)
+    {
+      pl.contours.push_back(levels[i][j]);
+      pl.contourTriangles.push_back(levelTris[i][j]);
+    }
 }
 
 void smooth1contour(pointlist &pl,double conterval,int i,bool spiral,PostScript &ps,
                     double we,double ea,double so,double no)
+/* Writes only to contour i, so different contours can be smoothed in
+ * different threads. The stride through the contour starts over for each
+ * contour, so the result doesn't depend on what was smoothed before.
+ */
 {
-  static int n=0;
+  int n=0;
   int j,k,sz,origsz,whichParts;
   double sp,wide,thisElev;
   xy spt;
@@ -517,6 +743,7 @@ void smooth1contour(pointlist &pl,double conterval,int i,bool spiral,PostScript
   segment splitseg,part0,part1,part2,parta;
   vector<double> vex;
   triangle *midptri;
+  Locator loc(pl.qinx);
   thisElev=pl.contours[i].getElevation();
   sarc=pl.contours[i].getspiralarc(0);
   /* Smooth the contours in two passes. The first works with straight lines
@@ -527,7 +754,7 @@ void smooth1contour(pointlist &pl,double conterval,int i,bool spiral,PostScript
   for (j=0;flatTriangles && j<pl.contours[i].size();j+=lrint(sqrt(pl.contours[i].size())))
   {
     sarc=pl.contours[i].getspiralarc(j);
-    midptri=pl.qinx.findt((sarc.getstart()+sarc.getend())/2);
+    midptri=loc.findt((sarc.getstart()+sarc.getend())/2);
     if (midptri)
       flatTriangles=flatTriangles&&midptri->isFlat();
   }
@@ -549,11 +776,11 @@ void smooth1contour(pointlist &pl,double conterval,int i,bool spiral,PostScript
       rpt=sarc.station(sarc.length()*(1-CCHALONG));
       if (lpt.isfinite() && rpt.isfinite())
       {
-        midptri=pl.qinx.findt((sarc.getstart()+sarc.getend())/2);
+        midptri=loc.findt((sarc.getstart()+sarc.getend())/2);
         if (midptri)
           if (allin=(midptri->in(sarc.getstart()) && midptri->in(sarc.getend()) &&
             !(midptri->in(lpt) && midptri->in(rpt))))
-            sp=splitpoint(lpt.elev()-pl.elevation(lpt),rpt.elev()-pl.elevation(rpt),0);
+            sp=splitpoint(lpt.elev()-loc.elevation(lpt),rpt.elev()-loc.elevation(rpt),0);
           else
             sp=splitpoint(lpt.elev()-midptri->elevation(lpt),rpt.elev()-midptri->elevation(rpt),conterval*wide);
         else
@@ -567,7 +794,7 @@ void smooth1contour(pointlist &pl,double conterval,int i,bool spiral,PostScript
         {
           //cout<<"segment "<<n<<" of "<<sz<<" of contour "<<i<<" needs splitting at "<<sp<<endl;
           spt=sarc.getstart()+sp*(sarc.getend()-sarc.getstart());
-          splitseg=pl.qinx.findt(spt,true)->dirclip(spt,dir(xy(sarc.getend()),xy(sarc.getstart()))+DEG90);
+          splitseg=loc.findt(spt,true)->dirclip(spt,dir(xy(sarc.getend()),xy(sarc.getstart()))+DEG90,thisElev);
           if (splitseg.getstart().elev()<splitseg.getend().elev()
               || splitseg.startslope()>0 || splitseg.endslope()>0)
           {
@@ -654,35 +881,238 @@ void smooth1contour(pointlist &pl,double conterval,int i,bool spiral,PostScript
 }
 
 
+void smoothcontours(pointlist &pl,double conterval,int begin,int end,bool spiral,bool log)
+/* Smooths contours begin through end-1, largest first, each in whichever
+ * thread is free. Each contour is smoothed the same no matter which thread
+ * does it or in what order, so the result is the same as with one thread.
+ * If more than one thread is used, the triangles the contours go through
+ * must already be subdivided. If log is true, each thread writes its own
+ * PostScript file, smoothcontours.ps for the first thread and
+ * smoothcontours-1.ps etc. for the others.
+ */
+{
+  int i,nth=threadCount();
+  vector<PostScript> ps(nth);
+  vector<int> order;
+  double we=0,ea=0,so=0,no=0;
+  for (i=begin;i<end;i++)
+    order.push_back(i);
+  stable_sort(order.begin(),order.end(),[&pl](int a,int b){return pl.contours[a].size()>pl.contours[b].size();});
+  if (log)
+  {
+    we=pl.dirbound(0);
+    so=pl.dirbound(DEG90);
+    ea=-pl.dirbound(DEG180);
+    no=-pl.dirbound(DEG270);
+    for (i=0;i<nth;i++)
+    {
+      ps[i].open(i?("smoothcontours-"+to_string(i)+".ps"):string("smoothcontours.ps"));
+      ps[i].setpaper(papersizes["A4 portrait"],0);
+      ps[i].prolog();
+    }
+  }
+  parallelQueue(order.size(),[&](int n,int thread)
+  {
+    smooth1contour(pl,conterval,order[n],spiral,ps[thread],we,ea,so,no);
+  });
+  if (log)
+    for (i=0;i<nth;i++)
+    {
+      ps[i].trailer();
+      ps[i].close();
+    }
+}
+
+void subdivideForSmoothing(pointlist &pl,int begin,int end)
+/* Triangles left unsubdivided by a lazy findcriticalpts are subdivided
+ * before smoothing contours begin through end-1 if one of the contours may
+ * go through them, since subdividing them while smoothing in several threads
+ * isn't thread-safe. This is done even in one thread, so that which
+ * triangles dirclip sees subdivided doesn't depend on the thread count.
+ */
+{
+  vector<double> elevs;
+  int i;
+  for (i=begin;i<end;i++)
+    elevs.push_back(pl.contours[i].getElevation());
+  sort(elevs.begin(),elevs.end());
+  parallelFor(pl.triangles.size(),[&](int begin,int end,int thread)
+  {
+    int i;
+    vector<double>::iterator above;
+    array<double,2> range;
+    for (i=begin;i<end;i++)
+      if (!pl.triangles[i].isSubdivided())
+      {
+        range=pl.triangles[i].ctrlRange();
+        above=upper_bound(elevs.begin(),elevs.end(),range[0]);
+        if (above!=elevs.end() && *above<=range[1])
+          pl.triangles[i].needSubdiv(false);
+      }
+  });
+}
+
 void smoothcontours(pointlist &pl,double conterval,bool spiral,bool log)
 {
+  subdivideForSmoothing(pl,0,pl.contours.size());
+  cout<<"smoothcontours "<<pl.contours.size()<<" contours in "<<threadCount()<<" threads\n";
+  smoothcontours(pl,conterval,0,pl.contours.size(),spiral,log);
+  buildpyramids(pl,conterval*PYRAMIDBASE);
+}
+
+void buildpyramids(pointlist &pl,double tolerance,int begin,int end)
+/* Builds the pyramids of contours begin through end-1, largest first,
+ * each in whichever thread is free. pl.contourPyramids must already have
+ * a place for each.
+ */
+{
+  vector<int> order;
   int i;
-  PostScript ps;
-  double we,ea,so,no;
-  ofstream logfile;
-  we=pl.dirbound(0);
-  so=pl.dirbound(DEG90);
-  ea=-pl.dirbound(DEG180);
-  no=-pl.dirbound(DEG270);
-  //we=443479;
-  //so=164112;
-  //ea=443486;
-  //no=164119;
-  if (log)
+  for (i=begin;i<end;i++)
+    order.push_back(i);
+  stable_sort(order.begin(),order.end(),[&pl](int a,int b){return pl.contours[a].size()>pl.contours[b].size();});
+  parallelQueue(order.size(),[&](int n,int thread)
+  {
+    pl.contourPyramids[order[n]].build(pl.contours[order[n]].approx3d(tolerance),tolerance);
+  });
+}
+
+void buildpyramids(pointlist &pl,double tolerance)
+{
+  pl.contourPyramids.clear();
+  pl.contourPyramids.resize(pl.contours.size());
+  buildpyramids(pl,tolerance,0,pl.contours.size());
+}
+
+int redrawcontours(pointlist &pl,double conterval,bool smooth,bool spiral)
+/* Redraws the contours that go through the dirty region after editing the
+ * TIN, keeps the rest, and clears the dirty region. Returns the number of
+ * contours drawn. If the contours don't say which triangles they go
+ * through, they are all drawn. At each elevation that crosses a triangle
+ * in the dirty region, the open contours are traced from where they start
+ * on the edge of the TIN, and those that don't go through the dirty region
+ * are dropped, since they were kept; then the closed contours are traced
+ * from the edges of the triangles in the dirty region. The contours are
+ * left in order of elevation, as roughcontours leaves them. If the contours
+ * had pyramids, the new ones get them after smoothing.
+ *
+ * Tracing needs the perimeter, and an open contour can go through any
+ * triangle, so the perimeter is added to all of them, then removed before
+ * smoothing, which needs it removed. It's left removed, as it is after
+ * drawing the rough contours and smoothing them.
+ */
+{
+  vector<int> regionTris,edgeNums,levelEdges,levels,numbers,order;
+  vector<bool> inRegion;
+  vector<uintptr_t> cstarts;
+  vector<triangle *> tris;
+  vector<polyspiral> sorted;
+  vector<vector<int> > sortedTris;
+  vector<BezierPyramid> sortedPyramids;
+  ContourMarks marks;
+  array<double,2> range;
+  polyline ctour;
+  triangle *t;
+  double elev;
+  bool inside;
+  int i,j,k,first;
+  pl.addperimeter();
+  if (pl.contourTriangles.size()!=pl.contours.size())
   {
-    ps.open("smoothcontours.ps");
-    ps.setpaper(papersizes["A4 portrait"],0);
-    ps.prolog();
+    roughcontours(pl,conterval);
+    first=0;
   }
-  for (i=0;i<pl.contours.size();i++)
+  else
   {
-    cout<<"smoothcontours "<<i<<'/'<<pl.contours.size()<<" elev "<<i*conterval<<" \r";
-    cout.flush();
-    smooth1contour(pl,conterval,i,spiral,ps,we,ea,so,no);
+    regionTris=pl.invalidateContours(pl.dirtyRegion);
+    first=pl.contours.size();
+    inRegion.assign(pl.triangles.size(),false);
+    for (i=0;i<regionTris.size();i++)
+    {
+      t=&pl.triangles[regionTris[i]];
+      inRegion[regionTris[i]]=true;
+      range=t->ctrlRange();
+      for (j=floor(range[0]/conterval);j*conterval<=range[1];j++)
+        if (spans(range,j*conterval))
+          levels.push_back(j);
+      edgeNums.push_back(pl.edges.find(t->a->edg(t)));
+      edgeNums.push_back(pl.edges.find(t->b->edg(t)));
+      edgeNums.push_back(pl.edges.find(t->c->edg(t)));
+    }
+    for (i=0;i<pl.edges.size();i++)
+      if (!pl.edges[i].isinterior())
+        edgeNums.push_back(i);
+    sort(levels.begin(),levels.end());
+    levels.erase(unique(levels.begin(),levels.end()),levels.end());
+    sort(edgeNums.begin(),edgeNums.end());
+    edgeNums.erase(unique(edgeNums.begin(),edgeNums.end()),edgeNums.end());
+    marks.setup(pl);
+    for (i=0;i<levels.size();i++)
+    {
+      elev=levels[i]*conterval;
+      marks.clear();
+      levelEdges.clear();
+      for (j=0;j<edgeNums.size();j++)
+        if (spans(pl.edges[edgeNums[j]].elevRange(),elev))
+          levelEdges.push_back(edgeNums[j]);
+      cstarts=edgestarts(pl,elev,levelEdges);
+      for (j=0;j<cstarts.size();j++)
+        if (!marks.ismarked(cstarts[j]))
+        {
+          tris.clear();
+          ctour=trace(cstarts[j],elev,marks,&tris);
+          numbers=triangleNumbers(pl,tris);
+          for (inside=false,k=0;!inside && k<numbers.size();k++)
+            inside=inRegion[numbers[k]];
+          if (inside)
+          {
+            ctour.dedup();
+            pl.contours.push_back(ctour);
+            pl.contourTriangles.push_back(numbers);
+          }
+        }
+      for (j=0;j<regionTris.size();j++)
+      {
+        ctour=intrace(&pl.triangles[regionTris[j]],elev);
+        if (ctour.size())
+        {
+          ctour.setlengths();
+          pl.contours.push_back(ctour);
+          pl.contourTriangles.push_back(vector<int>(1,regionTris[j]));
+        }
+      }
+    }
   }
-  if (log)
+  pl.removeperimeter();
+  if (smooth)
+  {
+    subdivideForSmoothing(pl,first,pl.contours.size());
+    smoothcontours(pl,conterval,first,pl.contours.size(),spiral,false);
+    if (pl.contourPyramids.size()==first)
+    {
+      pl.contourPyramids.resize(pl.contours.size());
+      buildpyramids(pl,conterval*PYRAMIDBASE,first,pl.contours.size());
+    }
+  }
+  if (pl.contourPyramids.size()!=pl.contours.size())
+    pl.contourPyramids.clear();
+  if (first>0 && first<pl.contours.size())
   {
-    ps.trailer();
-    ps.close();
+    for (i=0;i<pl.contours.size();i++)
+      order.push_back(i);
+    inplace_merge(order.begin(),order.begin()+first,order.end(),[&pl](int a,int b)
+      {return pl.contours[a].getElevation()<pl.contours[b].getElevation();});
+    for (i=0;i<order.size();i++)
+    {
+      sorted.push_back(std::move(pl.contours[order[i]]));
+      sortedTris.push_back(std::move(pl.contourTriangles[order[i]]));
+      if (pl.contourPyramids.size())
+        sortedPyramids.push_back(std::move(pl.contourPyramids[order[i]]));
+    }
+    pl.contours.swap(sorted);
+    pl.contourTriangles.swap(sortedTris);
+    pl.contourPyramids.swap(sortedPyramids);
   }
+  pl.dirtyRegion.clear();
+  return pl.contours.size()-first;
 }
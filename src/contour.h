@@ -25,12 +25,17 @@
 #ifndef CONTOUR_H
 #define CONTOUR_H
 #include <vector>
+#include <array>
 #include "polyline.h"
 #include "measure.h"
 #include "ps.h"
 #define CCHALONG 0.30754991027012474516361707317
 // This is sqrt(4/27) of the way from 0.5 to 0. See clampcubic.
 #define M_SQRT_10 3.16227766016837933199889354
+#define PYRAMIDBASE (1/64.)
+/* The finest level of a contour's pyramid is within this fraction of the
+ * contour interval. Drawing it finer approximates the contour again.
+ */
 
 class pointlist;
 
@@ -96,15 +101,73 @@ struct ContourLayer
   friend bool operator!=(const ContourLayer &l,const ContourLayer &r);
 };
 
+class RangeIndex
+/* Finds which of a set of ranges span a value, in time proportional to the
+ * logarithm of the number of ranges times the number found. The ranges are
+ * sorted by their low ends, and a tree over them holds the highest high end
+ * of each block, so that blocks wholly below the value are skipped.
+ */
+{
+public:
+  void build(const std::vector<std::array<double,2> > &ranges);
+  std::vector<int> spanning(double val);
+  size_t size()
+  {
+    return order.size();
+  }
+private:
+  std::vector<int> order; // numbers of the ranges, sorted by low end
+  std::vector<double> lows,highs; // in the same order
+  std::vector<double> maxHigh; // node n has children 2n and 2n+1
+  double buildNode(int node,int b,int e);
+  void spanning(int node,int b,int e,int cut,double val,std::vector<int> &ret);
+};
+
+struct ElevationIndex
+/* The elevation ranges of the edges and triangles of a TIN, built once
+ * before drawing all the contours, so that each contour looks only at
+ * those that it can pass through.
+ */
+{
+  RangeIndex edges,triangles;
+  void build(pointlist &pl);
+};
+
+class ContourMarks
+/* Which pieces of which edges have been traced at one elevation, keyed by
+ * edge number, so that several elevations can be traced at once, each in
+ * its own thread with its own marks. Clear it for each elevation.
+ */
+{
+public:
+  ContourMarks();
+  void setup(pointlist &pl);
+  void clear();
+  void clear(const std::vector<int> &edgeNums);
+  void mark(uintptr_t ep);
+  bool ismarked(uintptr_t ep);
+private:
+  pointlist *pl;
+  std::vector<unsigned char> bits;
+};
+
 float splitpoint(double leftclamp,double rightclamp,double tolerance);
-std::vector<uintptr_t> contstarts(pointlist &pts,double elev);
-polyline trace(uintptr_t edgep,double elev);
+bool spans(std::array<double,2> range,double elev);
+std::vector<uintptr_t> edgestarts(pointlist &pts,double elev,const std::vector<int> &edgeNums);
+std::vector<uintptr_t> contstarts(pointlist &pts,double elev,ElevationIndex *inx=nullptr);
+polyline trace(uintptr_t edgep,double elev,ContourMarks &marks,std::vector<triangle *> *tris=nullptr);
 polyline intrace(triangle *tri,double elev);
-bool ismarked(uintptr_t ep);
-void rough1contour(pointlist &pl,double elev);
+std::vector<int> triangleNumbers(pointlist &pl,std::vector<triangle *> &tris);
+void rough1contour(pointlist &pl,double elev,std::vector<polyline> &ctours,ContourMarks &marks,
+                   ElevationIndex *inx=nullptr,std::vector<std::vector<int> > *ctris=nullptr);
 void roughcontours(pointlist &pl,double conterval);
 void smooth1contour(pointlist &pl,double conterval,int i,bool spiral,PostScript &ps,
                     double we,double ea,double so,double no);
+void smoothcontours(pointlist &pl,double conterval,int begin,int end,bool spiral,bool log);
+void subdivideForSmoothing(pointlist &pl,int begin,int end);
 void smoothcontours(pointlist &pl,double conterval,bool spiral=true,bool log=false);
+void buildpyramids(pointlist &pl,double tolerance,int begin,int end);
+void buildpyramids(pointlist &pl,double tolerance);
+int redrawcontours(pointlist &pl,double conterval,bool smooth=true,bool spiral=true);
 void checkedgediscrepancies(pointlist &pl);
 #endif
@@ -0,0 +1,1463 @@
+/******************************************************/
+/*                                                    */
+/* delaunay.cpp - divide-and-conquer Delaunay         */
+/*                                                    */
+/******************************************************/
+/* Copyright 2026 Pierre Abbat.
+ * This file is part of Bezitopo.
+ *
+ * Bezitopo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Bezitopo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License and Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * and Lesser General Public License along with Bezitopo. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+/* This is the divide-and-conquer algorithm in Guibas and Stolfi, "Primitives
+ * for the manipulation of general subdivisions and the computation of
+ * Voronoi diagrams", ACM Transactions on Graphics 4:2 (1985). It takes
+ * O(n log n) time regardless of the order of the points, unlike the
+ * flipping algorithm, which can take quadratic time.
+ *
+ * The type-0 breaklines are then inserted with the algorithm in Anglada,
+ * "An improved incremental algorithm for constructing restricted Delaunay
+ * triangulations", Computers & Graphics 21:2 (1997): the edges crossing
+ * a breakline segment are deleted, and the two sides of the breakline are
+ * retriangulated directly.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+#include "delaunay.h"
+#include "pointlist.h"
+#include "angle.h"
+#include "cogo.h"
+#include "except.h"
+
+using namespace std;
+
+void QuadEdgeMesh::clear()
+{
+  pts.clear();
+  onext.clear();
+  org.clear();
+  dead.clear();
+}
+
+int QuadEdgeMesh::nquads()
+{
+  return onext.size()/4;
+}
+
+int QuadEdgeMesh::rot(int e)
+{
+  return (e&-4)|((e+1)&3);
+}
+
+int QuadEdgeMesh::sym(int e)
+{
+  return e^2;
+}
+
+int QuadEdgeMesh::rotinv(int e)
+{
+  return (e&-4)|((e+3)&3);
+}
+
+int QuadEdgeMesh::oprev(int e)
+{
+  return rot(onext[rot(e)]);
+}
+
+int QuadEdgeMesh::lnext(int e)
+{
+  return rot(onext[rotinv(e)]);
+}
+
+int QuadEdgeMesh::rprev(int e)
+{
+  return onext[sym(e)];
+}
+
+int QuadEdgeMesh::dest(int e)
+{
+  return org[sym(e)];
+}
+
+int QuadEdgeMesh::makeEdge(int a,int b)
+// Makes an isolated edge from pts[a] to pts[b].
+{
+  int e=onext.size();
+  onext.push_back(e);
+  onext.push_back(e+3);
+  onext.push_back(e+2);
+  onext.push_back(e+1);
+  org.push_back(a);
+  org.push_back(-1);
+  org.push_back(b);
+  org.push_back(-1);
+  dead.push_back(false);
+  return e;
+}
+
+void QuadEdgeMesh::splice(int a,int b)
+{
+  int alpha=rot(onext[a]),beta=rot(onext[b]);
+  swap(onext[a],onext[b]);
+  swap(onext[alpha],onext[beta]);
+}
+
+int QuadEdgeMesh::connect(int a,int b)
+// Adds an edge from the destination of a to the origin of b.
+{
+  int e=makeEdge(dest(a),org[b]);
+  splice(e,lnext(a));
+  splice(sym(e),b);
+  return e;
+}
+
+void QuadEdgeMesh::deleteEdge(int e)
+{
+  splice(e,oprev(e));
+  splice(sym(e),oprev(sym(e)));
+  dead[e>>2]=true;
+}
+
+/* The divide-and-conquer algorithm can corrupt the quad-edge structure if
+ * the predicates are inconsistent, as they can be with roundoff when three
+ * points are nearly in a line, as in a row of a lozenge. So the predicates
+ * compute in floating point, and if the result is too close to zero to be
+ * sure of the sign, recompute exactly using Shewchuk's expansion arithmetic.
+ */
+void twoSum(double a,double b,double &x,double &y)
+{
+  double bv,av;
+  x=a+b;
+  bv=x-a;
+  av=x-bv;
+  y=(a-av)+(b-bv);
+}
+
+void twoProduct(double a,double b,double &x,double &y)
+{
+  x=a*b;
+  y=fma(a,b,-x);
+}
+
+void growExpansion(vector<double> &e,double b)
+/* Adds b to the expansion e, whose components are nonoverlapping and
+ * increasing in magnitude, dropping zero components.
+ */
+{
+  int i,j;
+  double q=b,h;
+  for (i=j=0;i<e.size();i++)
+  {
+    twoSum(q,e[i],q,h);
+    if (h!=0)
+      e[j++]=h;
+  }
+  e.resize(j);
+  if (q!=0)
+    e.push_back(q);
+}
+
+vector<double> scaleExpansion(const vector<double> &e,double b)
+{
+  int i;
+  double p,r;
+  vector<double> ret;
+  for (i=0;i<e.size();i++)
+  {
+    twoProduct(e[i],b,p,r);
+    growExpansion(ret,r);
+    growExpansion(ret,p);
+  }
+  return ret;
+}
+
+vector<double> mulExpansion(const vector<double> &e,const vector<double> &f)
+{
+  int i,j;
+  vector<double> ret,part;
+  for (i=0;i<f.size();i++)
+  {
+    part=scaleExpansion(e,f[i]);
+    for (j=0;j<part.size();j++)
+      growExpansion(ret,part[j]);
+  }
+  return ret;
+}
+
+vector<double> diffExpansion(double a,double b)
+{
+  vector<double> ret;
+  growExpansion(ret,a);
+  growExpansion(ret,-b);
+  return ret;
+}
+
+void addExpansion(vector<double> &e,const vector<double> &f,double sign)
+{
+  int i;
+  for (i=0;i<f.size();i++)
+    growExpansion(e,sign*f[i]);
+}
+
+int expansionSign(const vector<double> &e)
+{
+  if (e.size()==0)
+    return 0;
+  return (e.back()>0)-(e.back()<0);
+}
+
+int orient(xy a,xy b,xy c)
+// Returns 1 if a, b, and c are counterclockwise, -1 if clockwise, 0 if in line.
+{
+  double detleft,detright,det,bound;
+  vector<double> e;
+  detleft=(a.getx()-c.getx())*(b.gety()-c.gety());
+  detright=(a.gety()-c.gety())*(b.getx()-c.getx());
+  det=detleft-detright;
+  bound=3.3306690738754716e-16*(fabs(detleft)+fabs(detright));
+  if (det>bound)
+    return 1;
+  if (-det>bound)
+    return -1;
+  addExpansion(e,scaleExpansion(diffExpansion(a.getx(),c.getx()),b.gety()),1);
+  addExpansion(e,scaleExpansion(diffExpansion(a.getx(),c.getx()),-c.gety()),1);
+  addExpansion(e,scaleExpansion(diffExpansion(a.gety(),c.gety()),-b.getx()),1);
+  addExpansion(e,scaleExpansion(diffExpansion(a.gety(),c.gety()),c.getx()),1);
+  return expansionSign(e);
+}
+
+int inCircleSign(xy a,xy b,xy c,xy d)
+/* Returns 1 if d is inside the circle through a, b, and c (counterclockwise),
+ * -1 if outside, 0 if on it.
+ */
+{
+  double adx,ady,bdx,bdy,cdx,cdy,alift,blift,clift,det,perm,bound;
+  vector<double> eadx,eady,ebdx,ebdy,ecdx,ecdy,ealift,eblift,eclift,minor,e;
+  adx=a.getx()-d.getx();
+  ady=a.gety()-d.gety();
+  bdx=b.getx()-d.getx();
+  bdy=b.gety()-d.gety();
+  cdx=c.getx()-d.getx();
+  cdy=c.gety()-d.gety();
+  alift=adx*adx+ady*ady;
+  blift=bdx*bdx+bdy*bdy;
+  clift=cdx*cdx+cdy*cdy;
+  det=alift*(bdx*cdy-cdx*bdy)+blift*(cdx*ady-adx*cdy)+clift*(adx*bdy-bdx*ady);
+  perm=(fabs(bdx*cdy)+fabs(cdx*bdy))*alift+
+       (fabs(cdx*ady)+fabs(adx*cdy))*blift+
+       (fabs(adx*bdy)+fabs(bdx*ady))*clift;
+  bound=1.1102230246251577e-15*perm;
+  if (det>bound)
+    return 1;
+  if (-det>bound)
+    return -1;
+  eadx=diffExpansion(a.getx(),d.getx());
+  eady=diffExpansion(a.gety(),d.gety());
+  ebdx=diffExpansion(b.getx(),d.getx());
+  ebdy=diffExpansion(b.gety(),d.gety());
+  ecdx=diffExpansion(c.getx(),d.getx());
+  ecdy=diffExpansion(c.gety(),d.gety());
+  ealift=mulExpansion(eadx,eadx);
+  addExpansion(ealift,mulExpansion(eady,eady),1);
+  eblift=mulExpansion(ebdx,ebdx);
+  addExpansion(eblift,mulExpansion(ebdy,ebdy),1);
+  eclift=mulExpansion(ecdx,ecdx);
+  addExpansion(eclift,mulExpansion(ecdy,ecdy),1);
+  minor=mulExpansion(ebdx,ecdy);
+  addExpansion(minor,mulExpansion(ecdx,ebdy),-1);
+  addExpansion(e,mulExpansion(ealift,minor),1);
+  minor=mulExpansion(ecdx,eady);
+  addExpansion(minor,mulExpansion(eadx,ecdy),-1);
+  addExpansion(e,mulExpansion(eblift,minor),1);
+  minor=mulExpansion(eadx,ebdy);
+  addExpansion(minor,mulExpansion(ebdx,eady),-1);
+  addExpansion(e,mulExpansion(eclift,minor),1);
+  return expansionSign(e);
+}
+
+bool QuadEdgeMesh::ccw(int a,int b,int c)
+{
+  return orient(*pts[a],*pts[b],*pts[c])>0;
+}
+
+bool QuadEdgeMesh::inCircle(int a,int b,int c,int d)
+// Returns true if pts[d] is inside the circle through a, b, and c.
+{
+  return inCircleSign(*pts[a],*pts[b],*pts[c],*pts[d])>0;
+}
+
+void QuadEdgeMesh::divide(int lo,int hi,int &le,int &re)
+/* Triangulates pts[lo] through pts[hi-1]. Returns in le the counterclockwise
+ * convex hull edge out of the leftmost point, and in re the clockwise
+ * convex hull edge out of the rightmost point.
+ */
+{
+  int a,b,c,mid,ldo,ldi,rdi,rdo,basel,lcand,rcand,t;
+  bool lvalid,rvalid;
+  if (hi-lo==2)
+  {
+    a=makeEdge(lo,lo+1);
+    le=a;
+    re=sym(a);
+  }
+  else if (hi-lo==3)
+  {
+    a=makeEdge(lo,lo+1);
+    b=makeEdge(lo+1,lo+2);
+    splice(sym(a),b);
+    if (ccw(lo,lo+1,lo+2))
+    {
+      connect(b,a);
+      le=a;
+      re=sym(b);
+    }
+    else if (ccw(lo,lo+2,lo+1))
+    {
+      c=connect(b,a);
+      le=sym(c);
+      re=c;
+    }
+    else // the three points are in a straight line
+    {
+      le=a;
+      re=sym(b);
+    }
+  }
+  else
+  {
+    mid=(lo+hi)/2;
+    divide(lo,mid,ldo,ldi);
+    divide(mid,hi,rdi,rdo);
+    // Find the lower common tangent of the two halves.
+    while (true)
+      if (ccw(org[rdi],org[ldi],dest(ldi)))
+        ldi=lnext(ldi);
+      else if (ccw(org[ldi],dest(rdi),org[rdi]))
+        rdi=rprev(rdi);
+      else
+        break;
+    basel=connect(sym(rdi),ldi);
+    if (org[ldi]==org[ldo])
+      ldo=sym(basel);
+    if (org[rdi]==org[rdo])
+      rdo=basel;
+    // Zip the halves together from bottom to top.
+    while (true)
+    {
+      lcand=onext[sym(basel)];
+      if (ccw(dest(lcand),dest(basel),org[basel]))
+        while (inCircle(dest(basel),org[basel],dest(lcand),dest(onext[lcand])))
+        {
+          t=onext[lcand];
+          deleteEdge(lcand);
+          lcand=t;
+        }
+      rcand=oprev(basel);
+      if (ccw(dest(rcand),dest(basel),org[basel]))
+        while (inCircle(dest(basel),org[basel],dest(rcand),dest(oprev(rcand))))
+        {
+          t=oprev(rcand);
+          deleteEdge(rcand);
+          rcand=t;
+        }
+      lvalid=ccw(dest(lcand),dest(basel),org[basel]);
+      rvalid=ccw(dest(rcand),dest(basel),org[basel]);
+      if (!lvalid && !rvalid)
+        break;
+      if (!lvalid || (rvalid && inCircle(dest(lcand),org[lcand],org[rcand],dest(rcand))))
+        basel=connect(rcand,sym(basel));
+      else
+        basel=connect(sym(basel),sym(lcand));
+    }
+    le=ldo;
+    re=rdo;
+  }
+}
+
+bool lessxy(point *a,point *b)
+{
+  if (a->getx()!=b->getx())
+    return a->getx()<b->getx();
+  else
+    return a->gety()<b->gety();
+}
+
+void QuadEdgeMesh::triangulate(vector<point *> points)
+/* Throws samePoints if two points have the same x and y, or flatTriangle
+ * if all the points are in a straight line.
+ */
+{
+  int i,le,re;
+  double len2;
+  bool flat=true;
+  clear();
+  pts=points;
+  sort(pts.begin(),pts.end(),lessxy);
+  for (i=1;i<pts.size();i++)
+    if (xy(*pts[i])==xy(*pts[i-1]))
+      throw BeziExcept(samePoints);
+  /* Points that are in a line except for roundoff, such as a rotated
+   * straight row, count as flat, as they do in goodcenter.
+   */
+  len2=sqr(dist(*pts[0],*pts.back()));
+  for (i=1;flat && i+1<pts.size();i++)
+    if (fabs(area3(*pts[0],*pts[i],*pts.back()))*16777216>len2)
+      flat=false;
+  if (flat)
+    throw BeziExcept(flatTriangle);
+  onext.reserve(12*pts.size());
+  org.reserve(12*pts.size());
+  dead.reserve(3*pts.size());
+  divide(0,pts.size(),le,re);
+}
+
+void pointlist::divideConquerTin(bool spatialSort)
+/* Makes the edges of the Delaunay triangulation of the points, ignoring
+ * breaklines, with the same nexta/nextb links as tryStartPoint and flipPass
+ * make. Onext in the quad-edge structure is the next edge counterclockwise
+ * about the origin, which is what nexta is. If spatialSort, the edges are
+ * numbered in Hilbert-curve order of their midpoints, as sortEdges does.
+ */
+{
+  QuadEdgeMesh mesh;
+  vector<point *> ptrs;
+  vector<int> edgeNum,live,order;
+  vector<xy> midpoints;
+  ptlist::iterator i;
+  int q,n;
+  edge *e;
+  for (i=points.begin();i!=points.end();i++)
+  {
+    i->line=nullptr;
+    ptrs.push_back(&*i);
+  }
+  mesh.triangulate(ptrs);
+  ptrs.clear();
+  edges.clear();
+  for (q=0;q<mesh.nquads();q++)
+    if (!mesh.dead[q])
+    {
+      live.push_back(q);
+      if (spatialSort)
+        midpoints.push_back((xy(*mesh.pts[mesh.org[4*q]])+xy(*mesh.pts[mesh.org[4*q+2]]))/2);
+    }
+  if (spatialSort)
+    order=hilbertSort(midpoints);
+  else
+    for (n=0;n<live.size();n++)
+      order.push_back(n);
+  edgeNum.resize(mesh.nquads(),-1);
+  for (n=0;n<order.size();n++)
+  {
+    q=live[order[n]];
+    edgeNum[q]=n;
+    edges[n].a=mesh.pts[mesh.org[4*q]];
+    edges[n].b=mesh.pts[mesh.org[4*q+2]];
+  }
+  for (n=0;n<order.size();n++)
+  {
+    q=live[order[n]];
+    e=&edges[n];
+    e->nexta=&edges[edgeNum[mesh.onext[4*q]>>2]];
+    e->nextb=&edges[edgeNum[mesh.onext[4*q+2]>>2]];
+    e->a->line=e;
+    e->b->line=e;
+  }
+}
+
+edge *pointlist::findEdge(point *p,point *q)
+// Returns the edge from p to q, or nullptr if there is none.
+{
+  edge *e=p->line;
+  int i,size=points.size();
+  for (i=0;i<size && (i==0 || e!=p->line);i++,e=e->next(p))
+    if (e->otherend(p)==q)
+      return e;
+  return nullptr;
+}
+
+void pointlist::unlinkEdge(edge *e)
+// Takes e out of the rings of edges around its ends.
+{
+  int i,j,size=points.size();
+  point *end[2]={e->a,e->b};
+  edge *f;
+  for (i=0;i<2;i++)
+  {
+    if (e->next(end[i])==e)
+    { // e is the only edge at this end
+      end[i]->line=nullptr;
+      continue;
+    }
+    for (j=0,f=end[i]->line;j<size && f->next(end[i])!=e;j++)
+      f=f->next(end[i]);
+    assert(j<size);
+    f->setnext(end[i],e->next(end[i]));
+    if (end[i]->line==e)
+      end[i]->line=f;
+  }
+}
+
+bool inWedge(xy p,xy f,xy g,xy q)
+/* Returns true if q is strictly inside the wedge from pf counterclockwise
+ * to pg. If f==g, the wedge is the whole plane.
+ */
+{
+  if (f==g)
+    return true;
+  if (orient(p,f,g)>0)
+    return orient(p,f,q)>0 && orient(p,q,g)>0;
+  else
+    return !(orient(p,g,q)>=0 && orient(p,q,f)>=0);
+}
+
+void pointlist::linkEdge(edge *e)
+/* Puts e, whose ends are set, into the rings of edges around its ends,
+ * between the two edges it falls between. An end may have no edges yet.
+ */
+{
+  int i,j,size=points.size();
+  point *end[2]={e->a,e->b};
+  edge *f;
+  for (i=0;i<2;i++)
+  {
+    if (!end[i]->line)
+    { // a point just added to the TIN
+      end[i]->line=e;
+      e->setnext(end[i],e);
+      continue;
+    }
+    f=end[i]->line;
+    for (j=0;j<size && !inWedge(*end[i],*f->otherend(end[i]),
+                                *f->next(end[i])->otherend(end[i]),*e->otherend(end[i]));j++)
+      f=f->next(end[i]);
+    assert(j<size);
+    e->setnext(end[i],f->next(end[i]));
+    f->setnext(end[i],e);
+  }
+}
+
+void pointlist::fillPseudoPolygon(vector<point *> poly,point *a,point *b,vector<edge *> &spare)
+/* poly is the chain of points, on one side of the edge ab, from a to b,
+ * after the edges crossing ab have been deleted. Fills it with Delaunay
+ * triangles, taking the edges from spare.
+ */
+{
+  int i,c;
+  point *p[2];
+  edge *e;
+  if (poly.size()==0)
+    return;
+  for (c=0,i=1;i<poly.size();i++)
+    if (orient(*a,*b,*poly[c])>0)
+    {
+      if (inCircleSign(*a,*b,*poly[c],*poly[i])>0)
+        c=i;
+    }
+    else
+    {
+      if (inCircleSign(*b,*a,*poly[c],*poly[i])>0)
+        c=i;
+    }
+  fillPseudoPolygon(vector<point *>(poly.begin(),poly.begin()+c),a,poly[c],spare);
+  fillPseudoPolygon(vector<point *>(poly.begin()+c+1,poly.end()),poly[c],b,spare);
+  p[0]=a;
+  p[1]=b;
+  for (i=0;i<2;i++)
+    if (!findEdge(p[i],poly[c]))
+    {
+      assert(spare.size());
+      e=spare.back();
+      spare.pop_back();
+      *e=edge();
+      e->a=p[i];
+      e->b=poly[c];
+      linkEdge(e);
+    }
+}
+
+void pointlist::insertConstraint(point *a,point *b)
+/* Makes ab an edge of the TIN, keeping the rest Delaunay. If a point is on
+ * ab, makes the edges from a to it and from it to b instead. Throws
+ * breaklinesCross if ab crosses an edge already inserted.
+ */
+{
+  edge *e,*f;
+  point *u,*v,*w;
+  vector<point *> left,right;
+  vector<edge *> crossing;
+  int i,o,size=points.size();
+  e=findEdge(a,b);
+  if (e)
+  {
+    e->broken=5;
+    return;
+  }
+  // Find the triangle at a that ab goes into.
+  for (i=0,e=a->line;i<size;i++,e=e->next(a))
+  {
+    u=e->otherend(a);
+    v=e->next(a)->otherend(a);
+    if (orient(*a,*u,*v)>0 && orient(*a,*u,*b)>=0 && orient(*a,*b,*v)>=0)
+      break;
+  }
+  assert(i<size);
+  if (orient(*a,*u,*b)==0 || orient(*a,*b,*v)==0)
+  {
+    w=orient(*a,*u,*b)?v:u;
+    insertConstraint(a,w);
+    insertConstraint(w,b);
+    return;
+  }
+  right.push_back(u);
+  left.push_back(v);
+  crossing.push_back(findEdge(u,v));
+  // Walk through the triangles that ab crosses.
+  while (true)
+  {
+    f=crossing.back();
+    w=f->next(v)->otherend(v);
+    if (w==b)
+      break;
+    o=orient(*a,*b,*w);
+    if (o==0)
+    {
+      insertConstraint(a,w);
+      insertConstraint(w,b);
+      return;
+    }
+    if (o<0)
+    {
+      right.push_back(w);
+      u=w;
+    }
+    else
+    {
+      left.push_back(w);
+      v=w;
+    }
+    crossing.push_back(findEdge(u,v));
+  }
+  for (i=0;i<crossing.size();i++)
+    if ((crossing[i]->broken&5)==5)
+      throw BeziExcept(breaklinesCross);
+  for (i=0;i<crossing.size();i++)
+    unlinkEdge(crossing[i]);
+  e=crossing.back();
+  crossing.pop_back();
+  *e=edge();
+  e->a=a;
+  e->b=b;
+  linkEdge(e);
+  e->broken=5;
+  fillPseudoPolygon(right,a,b,crossing);
+  fillPseudoPolygon(left,a,b,crossing);
+  assert(crossing.size()==0);
+}
+
+void pointlist::insertBreaklines()
+/* Makes every type-0 breakline segment an edge, or, if there are points
+ * on it, the edges between them. Since a triangulation of the same points
+ * always has the same number of edges, the edges deleted for each segment
+ * are reused. The edges' breakline bits must have been cleared. break0 is
+ * then remade from the edges, so that each piece of a segment split at
+ * a point is in it.
+ */
+{
+  int i,j;
+  array<int,2> bl;
+  for (i=0;i<type0Breaklines.size();i++)
+    for (j=0;j<type0Breaklines[i].size();j++)
+    {
+      bl=type0Breaklines[i][j];
+      if (bl[0]!=bl[1])
+        insertConstraint(&points[bl[0]],&points[bl[1]]);
+    }
+  remakeBreak0();
+}
+
+void pointlist::remakeBreak0()
+/* Makes break0 from the edges in type-0 breaklines and indexes it. Called
+ * when the edges have changed, such as when a breakline is split at a point
+ * or one of its points gets a new elevation.
+ */
+{
+  int i;
+  break0.clear();
+  for (i=0;i<edges.size();i++)
+    if (edges[i].broken&1)
+      break0.push_back(segment(*edges[i].a,*edges[i].b));
+  break0Grid.build(break0);
+}
+
+bool pointlist::inBreakline(int numb)
+/* Returns true if point numb is an end of a type-0 breakline segment, or of
+ * an edge in a type-0 breakline, as when the point is on a breakline segment.
+ */
+{
+  int i,j;
+  array<int,2> bl;
+  vector<edge *> spokes;
+  for (i=0;i<type0Breaklines.size();i++)
+    for (j=0;j<type0Breaklines[i].size();j++)
+    {
+      bl=type0Breaklines[i][j];
+      if (bl[0]==numb || bl[1]==numb)
+        return true;
+    }
+  spokes=points[numb].incidentEdges();
+  for (i=0;i<spokes.size();i++)
+    if (spokes[i]->broken&1)
+      return true;
+  return false;
+}
+
+/* The rest of this file edits a TIN one point at a time, so that correcting
+ * a few shots in a big TIN doesn't mean making the whole TIN again. A point
+ * is inserted by splitting the triangle (or edge) it's in, or, if it's
+ * outside the convex hull, by joining it to the hull edges it can see; a point
+ * is removed by filling the hole with ears, or, if it's on the hull, by
+ * filling the dents in the new hull. Either way, the TIN is then made Delaunay
+ * again by flipping edges (Lawson's algorithm), and the surface is refit
+ * near the changed triangles.
+ *
+ * Edges and triangles left over after removing a point are taken out of
+ * their Arenas by moving the last ones into their places, so that loops
+ * over the Arenas never see a dead edge or triangle.
+ */
+
+point *thirdCorner(triangle *t,edge *e)
+{
+  if (t->a!=e->a && t->a!=e->b)
+    return t->a;
+  if (t->b!=e->a && t->b!=e->b)
+    return t->b;
+  return t->c;
+}
+
+triangle *ccwTriangle(edge *e,point *end)
+// Returns the triangle counterclockwise from e about end.
+{
+  if (e->a==end)
+    return e->trib;
+  else
+    return e->tria;
+}
+
+void pointlist::attachTriangle(triangle *t)
+/* Puts t's corners in counterclockwise order and points the edges along
+ * its sides to it. The neighbor pointers are set afterward by setNeighbors,
+ * once all the triangles are attached.
+ */
+{
+  int i;
+  point *corner[3];
+  edge *e;
+  if (orient(*t->a,*t->b,*t->c)<0)
+    swap(t->b,t->c);
+  corner[0]=t->a;
+  corner[1]=t->b;
+  corner[2]=t->c;
+  for (i=0;i<3;i++)
+  {
+    e=findEdge(corner[i],corner[(i+1)%3]);
+    assert(e);
+    if (e->a==corner[i])
+      e->trib=t; // trib is on the left going from a to b
+    else
+      e->tria=t;
+  }
+  t->peri=t->perimeter();
+  t->sarea=t->area();
+}
+
+triangle *pointlist::newTriangle(vector<triangle *> &spare)
+{
+  triangle *t;
+  if (spare.size())
+  {
+    t=spare.back();
+    spare.pop_back();
+    *t=triangle();
+  }
+  else
+    t=&triangles[addtriangle()];
+  return t;
+}
+
+edge *pointlist::newEdge(point *a,point *b,vector<edge *> &spare)
+{
+  edge *e;
+  if (spare.size())
+  {
+    e=spare.back();
+    spare.pop_back();
+  }
+  else
+    e=&edges[edges.size()];
+  *e=edge();
+  e->a=a;
+  e->b=b;
+  linkEdge(e);
+  return e;
+}
+
+edge *pointlist::visibleHullEdge(xy pnt)
+/* Returns an edge of the convex hull that pnt is outside of, or nullptr
+ * if there is none. The quad index usually leads to one; if not, all edges
+ * are searched.
+ */
+{
+  int i;
+  triangle *t=qinx.findt(pnt,true);
+  point *corner[3];
+  edge *e;
+  if (t)
+  {
+    corner[0]=t->a;
+    corner[1]=t->b;
+    corner[2]=t->c;
+    for (i=0;i<3;i++)
+    {
+      e=findEdge(corner[i],corner[(i+1)%3]);
+      if (e && !(e->tria && e->trib) && orient(*corner[i],*corner[(i+1)%3],pnt)<0)
+        return e;
+    }
+  }
+  for (i=0;i<edges.size();i++)
+  {
+    e=&edges[i];
+    if (e->trib && !e->tria && orient(*e->a,*e->b,pnt)<0)
+      return e;
+    if (e->tria && !e->trib && orient(*e->b,*e->a,pnt)<0)
+      return e;
+  }
+  return nullptr;
+}
+
+void pointlist::flipToDelaunay(vector<edge *> queue,vector<triangle *> &changed)
+/* Flips edges, starting with those in queue, until the edges around them
+ * are Delaunay. Edges in type-0 breaklines are not flipped. The flipped
+ * triangles are added to changed.
+ */
+{
+  edge *e;
+  point *a,*b,*c,*d;
+  triangle *ta,*tb;
+  while (queue.size())
+  {
+    e=queue.back();
+    queue.pop_back();
+    if (!e->tria || !e->trib || (e->broken&1))
+      continue;
+    a=e->a;
+    b=e->b;
+    c=thirdCorner(e->trib,e); // on the left
+    d=thirdCorner(e->tria,e); // on the right
+    if (inCircleSign(*a,*b,*c,*d)>0)
+    {
+      queue.push_back(findEdge(a,c));
+      queue.push_back(findEdge(c,b));
+      queue.push_back(findEdge(b,d));
+      queue.push_back(findEdge(d,a));
+      ta=e->tria;
+      tb=e->trib;
+      e->tria=e->trib=nullptr; // so that flip leaves the triangles alone
+      e->flip(this);
+      ta->a=c;
+      ta->b=d;
+      ta->c=a;
+      tb->a=d;
+      tb->b=c;
+      tb->c=b;
+      attachTriangle(ta);
+      attachTriangle(tb);
+      e->setNeighbors();
+      findEdge(a,c)->setNeighbors();
+      findEdge(c,b)->setNeighbors();
+      findEdge(b,d)->setNeighbors();
+      findEdge(d,a)->setNeighbors();
+      changed.push_back(ta);
+      changed.push_back(tb);
+    }
+  }
+}
+
+void pointlist::dropEdges(vector<edge *> dead)
+/* Takes the dead edges, which are unlinked, out of edges by moving the last
+ * edges into their places.
+ */
+{
+  int i,j,h,last;
+  vector<int> holes;
+  edge *from,*to,*f;
+  point *end[2];
+  for (i=0;i<dead.size();i++)
+    holes.push_back(edges.find(dead[i]));
+  sort(holes.begin(),holes.end(),greater<int>());
+  for (i=0;i<holes.size();i++)
+  {
+    h=holes[i];
+    last=edges.size()-1;
+    if (h<last)
+    {
+      from=&edges[last];
+      to=&edges[h];
+      *to=*from;
+      end[0]=to->a;
+      end[1]=to->b;
+      for (j=0;j<2;j++)
+      {
+        if (to->next(end[j])==from)
+          to->setnext(end[j],to);
+        else
+        {
+          for (f=to->next(end[j]);f->next(end[j])!=from;f=f->next(end[j]));
+          f->setnext(end[j],to);
+        }
+        if (end[j]->line==from)
+          end[j]->line=to;
+      }
+    }
+    edges.resize(last);
+  }
+}
+
+void pointlist::dropTriangles(vector<triangle *> dead,vector<triangle *> &changed)
+/* Takes the dead triangles, to which nothing points any more, out of
+ * triangles by moving the last triangles into their places, and fixes
+ * the pointers to the moved triangles, including those in changed and
+ * the quad index, and their numbers in contourTriangles.
+ */
+{
+  int i,j,h,last,o;
+  vector<int> holes;
+  unordered_map<int,int> renum; // old number of a triangle -> new number, -1 if dead
+  unordered_map<int,int> orig; // new number of a moved triangle -> old number
+  vector<triangle *> gone;
+  vector<array<triangle *,2> > moves;
+  triangle *from,*to,*neigh[3];
+  point *corner[3];
+  edge *e;
+  for (i=0;i<dead.size();i++)
+    holes.push_back(triangles.find(dead[i]));
+  sort(holes.begin(),holes.end(),greater<int>());
+  for (i=0;i<holes.size();i++)
+  {
+    h=holes[i];
+    last=triangles.size()-1;
+    from=&triangles[last];
+    renum[orig.count(h)?orig[h]:h]=-1;
+    if (h<last)
+    {
+      o=orig.count(last)?orig[last]:last;
+      renum[o]=h;
+      orig[h]=o;
+      to=&triangles[h];
+      *to=*from;
+      corner[0]=to->a;
+      corner[1]=to->b;
+      corner[2]=to->c;
+      for (j=0;j<3;j++)
+      {
+        e=findEdge(corner[j],corner[(j+1)%3]);
+        if (e->tria==from)
+          e->tria=to;
+        if (e->trib==from)
+          e->trib=to;
+      }
+      neigh[0]=to->aneigh;
+      neigh[1]=to->bneigh;
+      neigh[2]=to->cneigh;
+      for (j=0;j<3;j++)
+        if (neigh[j])
+        {
+          if (neigh[j]->aneigh==from)
+            neigh[j]->aneigh=to;
+          if (neigh[j]->bneigh==from)
+            neigh[j]->bneigh=to;
+          if (neigh[j]->cneigh==from)
+            neigh[j]->cneigh=to;
+        }
+      for (j=0;j<changed.size();j++)
+        if (changed[j]==from)
+          changed[j]=to;
+      moves.push_back({from,to});
+    }
+    else
+      gone.push_back(from);
+    triangles.resize(last);
+  }
+  for (i=0;i<gone.size();i++)
+    moves.push_back({gone[i],&triangles[0]});
+  if (moves.size())
+    qinx.replaceTri(moves);
+  renumberContourTriangles(renum);
+}
+
+void pointlist::renumberContourTriangles(const unordered_map<int,int> &renum)
+/* A contour that went through a deleted triangle will be redrawn, since
+ * the triangles that replace it are in the dirty region. One that went
+ * through a triangle that was only moved in the Arena still goes through it.
+ */
+{
+  int i,j;
+  bool moved;
+  unordered_map<int,int>::const_iterator k;
+  if (renum.size())
+    for (i=0;i<contourTriangles.size();i++)
+    {
+      for (moved=false,j=0;j<contourTriangles[i].size();j++)
+        if ((k=renum.find(contourTriangles[i][j]))!=renum.end())
+        {
+          contourTriangles[i][j]=k->second;
+          moved=true;
+        }
+      if (moved)
+        sort(contourTriangles[i].begin(),contourTriangles[i].end());
+    }
+}
+
+triangle *pointlist::insertionTriangle(xy pnt,int o[3],edge *&hull)
+/* Finds where a point at pnt would go in the TIN. Returns the triangle it's
+ * in or on a side of, setting o[i] to its orientation from the side opposite
+ * corner i; or, if it's outside the convex hull, returns nullptr and sets hull
+ * to a hull edge it can see. If it can't be inserted, because it's on a
+ * corner, can see no hull edge, or the exact walk gets lost, returns nullptr
+ * and sets hull to nullptr.
+ */
+{
+  int i,n,nzero;
+  triangle *t;
+  point *corner[3];
+  hull=nullptr;
+  if (qinx.side==0)
+    makeqindex();
+  t=qinx.findt(pnt);
+  /* The quad index walks with inexact areas; make sure with exact ones,
+   * stepping to a neighbor if the point is just outside t.
+   */
+  for (n=0;t && n<16;n++)
+  {
+    corner[0]=t->a;
+    corner[1]=t->b;
+    corner[2]=t->c;
+    for (i=0;i<3;i++)
+      o[i]=orient(*corner[(i+1)%3],*corner[(i+2)%3],pnt);
+    if (o[0]>=0 && o[1]>=0 && o[2]>=0)
+      break;
+    if (o[0]<0)
+      t=t->aneigh;
+    else if (o[1]<0)
+      t=t->bneigh;
+    else
+      t=t->cneigh;
+  }
+  if (n==16)
+    return nullptr;
+  if (t)
+  {
+    for (nzero=i=0;i<3;i++)
+      nzero+=o[i]==0;
+    if (nzero>1)
+      return nullptr; // pnt is on a corner
+  }
+  else
+    hull=visibleHullEdge(pnt);
+  return t;
+}
+
+bool pointlist::insertTinPoint(int numb,point pnt)
+/* Inserts a point into the TIN, keeping it Delaunay except where there are
+ * type-0 breaklines, and refits the surface around it. If it's on an edge
+ * in a breakline, both halves stay in the breakline. Returns false,
+ * changing nothing, if the number is taken, another point is in the same
+ * place, or there are no triangles yet.
+ */
+{
+  int i,n,o[3],nzero=0;
+  triangle *t,*t2,*tn;
+  point *p,*corner[3],*u,*v,*w,*x;
+  edge *e,*f,*hull;
+  char brk=0;
+  vector<point *> chain;
+  vector<edge *> queue,noEdges;
+  vector<triangle *> changed,noTriangles;
+  if (points.count(numb) || !triangles.size())
+    return false;
+  t=insertionTriangle(pnt,o,hull);
+  if (!t && !hull)
+    return false;
+  if (t)
+  {
+    corner[0]=t->a;
+    corner[1]=t->b;
+    corner[2]=t->c;
+    for (i=0;i<3;i++)
+      nzero+=o[i]==0;
+  }
+  p=&points.insertInOrder(numb);
+  *p=pnt;
+  p->line=nullptr;
+  dirtyRegion.include(xy(*p));
+  if (t && nzero==0)
+  { // inside t: split it in three
+    newEdge(p,corner[0],noEdges);
+    newEdge(p,corner[1],noEdges);
+    newEdge(p,corner[2],noEdges);
+    for (i=0;i<3;i++)
+      queue.push_back(findEdge(corner[i],corner[(i+1)%3]));
+    t->a=corner[0];
+    t->b=corner[1];
+    t->c=p;
+    changed.push_back(t);
+    for (i=1;i<3;i++)
+    {
+      tn=newTriangle(noTriangles);
+      tn->a=corner[i];
+      tn->b=corner[(i+1)%3];
+      tn->c=p;
+      changed.push_back(tn);
+    }
+  }
+  else if (t)
+  { // on a side of t: split the side and the triangles on both sides of it
+    for (i=0;o[i];i++);
+    w=corner[i];
+    u=corner[(i+1)%3];
+    v=corner[(i+2)%3];
+    e=findEdge(u,v);
+    t2=e->othertri(t);
+    x=t2?thirdCorner(t2,e):nullptr;
+    brk=e->broken;
+    unlinkEdge(e);
+    e->a=u;
+    e->b=p;
+    e->tria=e->trib=nullptr;
+    linkEdge(e);
+    f=newEdge(p,v,noEdges);
+    f->broken=brk;
+    newEdge(p,w,noEdges);
+    queue.push_back(findEdge(v,w));
+    queue.push_back(findEdge(w,u));
+    t->a=u;
+    t->b=p;
+    t->c=w;
+    tn=newTriangle(noTriangles);
+    tn->a=p;
+    tn->b=v;
+    tn->c=w;
+    changed.push_back(t);
+    changed.push_back(tn);
+    if (t2)
+    {
+      newEdge(p,x,noEdges);
+      queue.push_back(findEdge(u,x));
+      queue.push_back(findEdge(x,v));
+      t2->a=v;
+      t2->b=p;
+      t2->c=x;
+      tn=newTriangle(noTriangles);
+      tn->a=p;
+      tn->b=u;
+      tn->c=x;
+      changed.push_back(t2);
+      changed.push_back(tn);
+    }
+  }
+  else
+  { /* Outside the convex hull: find the hull edges that p can see, going
+     * counterclockwise along the hull (with the inside on the left), and
+     * join p to their ends.
+     */
+    e=hull;
+    if (e->trib)
+    {
+      u=e->a;
+      v=e->b;
+    }
+    else
+    {
+      u=e->b;
+      v=e->a;
+    }
+    for (n=0;n<edges.size();n++)
+    {
+      for (f=u->line;f->next(u)!=e;f=f->next(u));
+      w=f->otherend(u);
+      if (w==v || orient(*w,*u,pnt)>=0)
+        break;
+      e=f;
+      v=u;
+      u=w;
+    }
+    chain.push_back(u);
+    chain.push_back(v);
+    for (n=0;n<edges.size();n++)
+    {
+      f=e->next(v);
+      w=f->otherend(v);
+      if (w==chain[0] || orient(*v,*w,pnt)>=0)
+        break;
+      e=f;
+      u=v;
+      v=w;
+      chain.push_back(w);
+    }
+    for (i=0;i<chain.size();i++)
+      newEdge(p,chain[i],noEdges);
+    for (i=0;i+1<chain.size();i++)
+    {
+      queue.push_back(findEdge(chain[i],chain[i+1]));
+      tn=newTriangle(noTriangles);
+      tn->a=chain[i+1];
+      tn->b=chain[i];
+      tn->c=p;
+      changed.push_back(tn);
+    }
+  }
+  for (i=0;i<changed.size();i++)
+    attachTriangle(changed[i]);
+  for (i=0;i<changed.size();i++)
+  {
+    findEdge(changed[i]->a,changed[i]->b)->setNeighbors();
+    findEdge(changed[i]->b,changed[i]->c)->setNeighbors();
+    findEdge(changed[i]->c,changed[i]->a)->setNeighbors();
+  }
+  flipToDelaunay(queue,changed);
+  if (brk&1)
+    remakeBreak0();
+  if (qinx.quarter(pnt)<0)
+    makeqindex();
+  resurface(changed);
+  localPoints.clear();
+  localEdges.clear();
+  localTriangles.clear();
+  return true;
+}
+
+bool pointlist::removeTinPoint(int numb)
+/* Removes a point from the TIN, keeping it Delaunay, and refits the surface
+ * around the hole. Returns false, changing nothing, if there is no such point,
+ * removing it would leave no triangles, or it's in a type-0 breakline,
+ * which would have to be redone without it.
+ */
+{
+  int i,j,k,n,best,gap=-1,ngaps=0,npop=0;
+  bool bestDelaunay,isDelaunay,isEar;
+  point *p,*a,*b,*c;
+  triangle *t;
+  edge *e;
+  vector<point *> ring,poly,stack;
+  vector<edge *> spokes,sides,queue;
+  vector<triangle *> star,changed;
+  if (!points.count(numb) || !triangles.size() || inBreakline(numb))
+    return false;
+  p=&points[numb];
+  spokes=p->incidentEdges();
+  k=spokes.size();
+  for (i=0;i<k;i++)
+  {
+    ring.push_back(spokes[i]->otherend(p));
+    t=ccwTriangle(spokes[i],p);
+    if (t)
+      star.push_back(t);
+    else
+    {
+      gap=i;
+      ngaps++;
+    }
+  }
+  if (ngaps>1 || k<2)
+    return false;
+  if (gap>=0)
+  { // p is on the convex hull; ring from one hull neighbor to the other
+    for (i=0;i<k;i++)
+      poly.push_back(ring[(gap+1+i)%k]);
+    for (i=0;i<k;i++)
+    {
+      while (stack.size()>=2 && orient(*stack[stack.size()-2],*stack.back(),*poly[i])>0)
+      {
+        stack.pop_back();
+        npop++;
+      }
+      stack.push_back(poly[i]);
+    }
+    if (triangles.size()-star.size()+npop==0)
+      return false;
+    stack.clear();
+  }
+  else
+    poly=ring;
+  dirtyRegion.include(xy(*p));
+  for (i=0;i<star.size();i++)
+  {
+    e=findEdge(star[i]->a,star[i]->b);
+    if (e->a!=p && e->b!=p)
+      sides.push_back(e);
+    e=findEdge(star[i]->b,star[i]->c);
+    if (e->a!=p && e->b!=p)
+      sides.push_back(e);
+    e=findEdge(star[i]->c,star[i]->a);
+    if (e->a!=p && e->b!=p)
+      sides.push_back(e);
+  }
+  for (i=0;i<sides.size();i++)
+  {
+    if (find(star.begin(),star.end(),sides[i]->trib)!=star.end())
+      sides[i]->trib=nullptr;
+    if (find(star.begin(),star.end(),sides[i]->tria)!=star.end())
+      sides[i]->tria=nullptr;
+  }
+  for (i=0;i<k;i++)
+    unlinkEdge(spokes[i]);
+  points.eraseInOrder(numb);
+  if (gap<0)
+  { /* Clip ears off the hole until it's a triangle, choosing ears whose
+     * circumcircles have no other corner of the hole in them when there
+     * are such ears, so that there is little left to flip.
+     */
+    while (poly.size()>3)
+    {
+      n=poly.size();
+      best=-1;
+      bestDelaunay=false;
+      for (i=0;i<n && !bestDelaunay;i++)
+      {
+        a=poly[(i+n-1)%n];
+        b=poly[i];
+        c=poly[(i+1)%n];
+        isEar=orient(*a,*b,*c)>0;
+        isDelaunay=true;
+        for (j=0;isEar && j<n;j++)
+          if (poly[j]!=a && poly[j]!=b && poly[j]!=c)
+          {
+            if (orient(*a,*b,*poly[j])>=0 && orient(*b,*c,*poly[j])>=0 && orient(*c,*a,*poly[j])>=0)
+              isEar=false;
+            if (inCircleSign(*a,*b,*c,*poly[j])>0)
+              isDelaunay=false;
+          }
+        if (isEar && (best<0 || isDelaunay))
+        {
+          best=i;
+          bestDelaunay=isDelaunay;
+        }
+      }
+      assert(best>=0);
+      a=poly[(best+n-1)%n];
+      c=poly[(best+1)%n];
+      t=newTriangle(star);
+      t->a=a;
+      t->b=poly[best];
+      t->c=c;
+      changed.push_back(t);
+      queue.push_back(newEdge(a,c,spokes));
+      poly.erase(poly.begin()+best);
+    }
+    t=newTriangle(star);
+    t->a=poly[0];
+    t->b=poly[1];
+    t->c=poly[2];
+    changed.push_back(t);
+  }
+  else
+    for (i=0;i<k;i++)
+    {
+      while (stack.size()>=2 && orient(*stack[stack.size()-2],*stack.back(),*poly[i])>0)
+      {
+        t=newTriangle(star);
+        t->a=stack[stack.size()-2];
+        t->b=stack.back();
+        t->c=poly[i];
+        changed.push_back(t);
+        queue.push_back(newEdge(t->a,t->c,spokes));
+        stack.pop_back();
+      }
+      stack.push_back(poly[i]);
+    }
+  for (i=0;i<changed.size();i++)
+    attachTriangle(changed[i]);
+  for (i=0;i<sides.size();i++)
+    sides[i]->setNeighbors();
+  for (i=0;i<changed.size();i++)
+  {
+    findEdge(changed[i]->a,changed[i]->b)->setNeighbors();
+    findEdge(changed[i]->b,changed[i]->c)->setNeighbors();
+    findEdge(changed[i]->c,changed[i]->a)->setNeighbors();
+  }
+  flipToDelaunay(queue,changed);
+  dropTriangles(star,changed);
+  dropEdges(spokes);
+  resurface(changed,ring);
+  localPoints.clear();
+  localEdges.clear();
+  localTriangles.clear();
+  return true;
+}
+
+bool pointlist::moveTinPoint(int numb,xyz pnt)
+/* Moves a point of the TIN. If only its elevation changes, only the surface
+ * around it (and any breakline through it) is refit; else it is removed and
+ * inserted again, which can't be done to a point in a type-0 breakline.
+ * Returns false if it can't be moved there, in which case it stays where
+ * it was. Where it's going is checked before removing it; if inserting it
+ * there fails anyway and it can't be put back, which shouldn't happen, it's
+ * kept out of the TIN until the TIN is made again.
+ */
+{
+  int i,o[3];
+  bool brk=false;
+  point *p,saved;
+  edge *hull;
+  vector<triangle *> noTriangles;
+  vector<edge *> moved;
+  vector<point *> ring;
+  if (!points.count(numb) || !triangles.size())
+    return false;
+  p=&points[numb];
+  if (xy(pnt)==xy(*p))
+  { // the neighbors' gradients depend on the elevation too
+    p->setelev(pnt.elev());
+    moved=p->incidentEdges();
+    for (i=0;i<moved.size();i++)
+    {
+      ring.push_back(moved[i]->otherend(p));
+      brk|=(moved[i]->broken&1)!=0;
+    }
+    ring.push_back(p);
+    if (brk)
+      remakeBreak0();
+    resurface(noTriangles,ring);
+    return true;
+  }
+  if (!insertionTriangle(pnt,o,hull) && !hull)
+    return false;
+  saved=*p;
+  if (!removeTinPoint(numb))
+    return false;
+  if (insertTinPoint(numb,point(pnt,saved.note)))
+  {
+    points[numb].flags=saved.flags;
+    return true;
+  }
+  if (!insertTinPoint(numb,saved))
+  {
+    p=&points.insertInOrder(numb);
+    *p=saved;
+    p->line=nullptr;
+  }
+  return false;
+}
@@ -0,0 +1,61 @@
+/******************************************************/
+/*                                                    */
+/* delaunay.h - divide-and-conquer Delaunay           */
+/*                                                    */
+/******************************************************/
+/* Copyright 2026 Pierre Abbat.
+ * This file is part of Bezitopo.
+ *
+ * Bezitopo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Bezitopo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License and Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * and Lesser General Public License along with Bezitopo. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DELAUNAY_H
+#define DELAUNAY_H
+#include <vector>
+#include "point.h"
+
+int orient(xy a,xy b,xy c);
+int inCircleSign(xy a,xy b,xy c,xy d);
+
+/* Guibas and Stolfi's quad-edge structure. Edge e's four rotations are
+ * numbered 4q..4q+3; rotations 0 and 2 are the edge and its reverse,
+ * 1 and 3 are the dual edges, which are kept only for splicing.
+ */
+class QuadEdgeMesh
+{
+public:
+  std::vector<point *> pts; // sorted by x, then y
+  std::vector<int> onext,org;
+  std::vector<char> dead;
+  void clear();
+  int nquads();
+  static int rot(int e);
+  static int sym(int e);
+  static int rotinv(int e);
+  int oprev(int e);
+  int lnext(int e);
+  int rprev(int e);
+  int dest(int e);
+  int makeEdge(int a,int b);
+  void splice(int a,int b);
+  int connect(int a,int b);
+  void deleteEdge(int e);
+  bool ccw(int a,int b,int c);
+  bool inCircle(int a,int b,int c,int d);
+  void divide(int lo,int hi,int &le,int &re);
+  void triangulate(std::vector<point *> points);
+};
+#endif
@@ -54,10 +54,10 @@ void document::copytopopoints(int dst,int src)
   {
     include=false;
     for (j=0;j<pl[dst].crit.size();j++)
-      if (pl[dst].crit[j].match(i->second,i->first))
+      if (pl[dst].crit[j].match(*i,i->num))
 	include=pl[dst].crit[j].istopo;
     if (include)
-      pl[dst].addpoint(i->first,i->second);
+      pl[dst].addpoint(i->num,*i);
   }
 }
 
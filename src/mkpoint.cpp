@@ -94,8 +94,8 @@ void listpoints(string args)
   ptlist::iterator i;
   for (i=doc.pl[0].points.begin();i!=doc.pl[0].points.end();i++)
   {
-    cout<<i->first<<' ';
-    outpnt(i->second);
+    cout<<i->num<<' ';
+    outpnt(*i);
     cout<<endl;
   }
 }
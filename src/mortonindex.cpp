@@ -0,0 +1,441 @@
+/******************************************************/
+/*                                                    */
+/* mortonindex.cpp - linear quadtree index            */
+/*                                                    */
+/******************************************************/
+/* Copyright 2026 Pierre Abbat.
+ * This file is part of Bezitopo.
+ *
+ * Bezitopo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Bezitopo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License and Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * and Lesser General Public License along with Bezitopo. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <array>
+#include "binio.h"
+#include "mortonindex.h"
+using namespace std;
+
+unsigned long long spreadBits(unsigned int n)
+// Puts bit i of n in bit 2i of the result.
+{
+  unsigned long long r=n;
+  r=(r|(r<<16))&0x0000ffff0000ffffULL;
+  r=(r|(r<<8))&0x00ff00ff00ff00ffULL;
+  r=(r|(r<<4))&0x0f0f0f0f0f0f0f0fULL;
+  r=(r|(r<<2))&0x3333333333333333ULL;
+  r=(r|(r<<1))&0x5555555555555555ULL;
+  return r;
+}
+
+unsigned int gatherBits(unsigned long long r)
+// Inverse of spreadBits, ignoring the odd bits.
+{
+  r&=0x5555555555555555ULL;
+  r=(r|(r>>1))&0x3333333333333333ULL;
+  r=(r|(r>>2))&0x0f0f0f0f0f0f0f0fULL;
+  r=(r|(r>>4))&0x00ff00ff00ff00ffULL;
+  r=(r|(r>>8))&0x0000ffff0000ffffULL;
+  r=(r|(r>>16))&0x00000000ffffffffULL;
+  return r;
+}
+
+unsigned long long mortonCode(unsigned int ix,unsigned int iy)
+/* The x bits are even and the y bits odd, so the four subsquares of a square
+ * are in the same order as in a qindex: lower left, lower right, upper left,
+ * upper right.
+ */
+{
+  return spreadBits(ix)|(spreadBits(iy)<<1);
+}
+
+MortonIndex::MortonIndex()
+{
+  x=y=side=0;
+}
+
+void MortonIndex::clear()
+{
+  x=y=side=0;
+  codes.clear();
+  depths.clear();
+  firstPoint.clear();
+  pnts.clear();
+  tris.clear();
+}
+
+int MortonIndex::leaves()
+{
+  return codes.size();
+}
+
+int MortonIndex::size()
+{
+  return codes.size()?(4*codes.size()-1)/3:0;
+}
+
+unsigned long long MortonIndex::code(xy pnt,bool clip,bool &inside)
+{
+  const double n=1<<MORTON_DEPTH;
+  double fx,fy;
+  fx=(pnt.getx()-x)/side*n;
+  fy=(pnt.gety()-y)/side*n;
+  inside=fx>=0 && fx<n && fy>=0 && fy<n;
+  if (std::isnan(fx) || std::isnan(fy) || side==0)
+  {
+    inside=false;
+    return 0;
+  }
+  fx=min(max(fx,0.),n-1);
+  fy=min(max(fy,0.),n-1);
+  return mortonCode(fx,fy);
+}
+
+xy MortonIndex::middle(int leaf)
+{
+  double cell=side/(1<<MORTON_DEPTH);
+  double leafSide=ldexp(side,-depths[leaf]);
+  return xy(x+gatherBits(codes[leaf])*cell+leafSide/2,
+            y+gatherBits(codes[leaf]>>1)*cell+leafSide/2);
+}
+
+int MortonIndex::findLeaf(unsigned long long c)
+{
+  return upper_bound(codes.begin(),codes.end(),c)-codes.begin()-1;
+}
+
+void MortonIndex::build(pointlist &pl)
+/* Sizes the square like qindex::sizefit, radix-sorts the points by Morton
+ * code, and splits the sorted array the way qindex::split splits the square,
+ * until no leaf has more than three distinct points.
+ */
+{
+  int i,shift;
+  bool inside;
+  qindex sizer;
+  vector<xy> plist;
+  vector<point *> unsorted,sorted;
+  vector<unsigned long long> keys,keys1;
+  vector<int> count;
+  ptlist::iterator j;
+  function<void(int,unsigned long long,int,int)> split;
+  clear();
+  for (j=pl.points.begin();j!=pl.points.end();++j)
+  {
+    plist.push_back(*j);
+    unsorted.push_back(&*j);
+  }
+  sizer.sizefit(plist);
+  x=sizer.x;
+  y=sizer.y;
+  side=sizer.side;
+  for (i=0;i<unsorted.size();i++)
+    keys.push_back(code(*unsorted[i],true,inside));
+  keys1.resize(keys.size());
+  sorted.resize(keys.size());
+  for (shift=0;shift<2*MORTON_DEPTH;shift+=10)
+  {
+    count.assign(1025,0);
+    for (i=0;i<keys.size();i++)
+      count[((keys[i]>>shift)&1023)+1]++;
+    for (i=1;i<1025;i++)
+      count[i]+=count[i-1];
+    for (i=0;i<keys.size();i++)
+    {
+      keys1[count[(keys[i]>>shift)&1023]]=keys[i];
+      sorted[count[(keys[i]>>shift)&1023]++]=unsorted[i];
+    }
+    keys.swap(keys1);
+    unsorted.swap(sorted);
+  }
+  pnts=unsorted;
+  split=[&](int level,unsigned long long start,int lo,int hi)
+  {
+    int i,q,mid,distinct;
+    unsigned long long quarter;
+    for (i=lo+1,distinct=(hi>lo);i<hi && distinct<4;i++)
+      if (keys[i]!=keys[i-1])
+        distinct++;
+    if (distinct<=3 || level==MORTON_DEPTH)
+    {
+      codes.push_back(start);
+      depths.push_back(level);
+      firstPoint.push_back(lo);
+    }
+    else
+    {
+      quarter=1ULL<<(2*(MORTON_DEPTH-level-1));
+      for (q=0;q<4;q++)
+      {
+        mid=lower_bound(keys.begin()+lo,keys.begin()+hi,start+(q+1)*quarter)-keys.begin();
+        split(level+1,start+q*quarter,lo,mid);
+        lo=mid;
+      }
+    }
+  };
+  if (side>0)
+    split(0,0,0,keys.size());
+  firstPoint.push_back(keys.size());
+  tris.assign(codes.size(),nullptr);
+}
+
+void MortonIndex::settri(pointlist &pl)
+// Like qindex::settri, but walks the leaves in Z-order.
+{
+  int i;
+  triangle *thistri;
+  if (pl.triangles.size())
+  {
+    thistri=&pl.triangles[0];
+    for (i=0;i<codes.size();i++)
+    {
+      thistri=thistri->findt(middle(i),true);
+      tris[i]=thistri;
+    }
+  }
+}
+
+triangle *MortonIndex::findt(xy pnt,bool clip)
+{
+  bool inside;
+  unsigned long long c=code(pnt,clip,inside);
+  triangle *tri;
+  if (codes.empty() || (!inside && !(clip && !pnt.isnan())))
+    return nullptr;
+  tri=tris[findLeaf(c)];
+  return tri?tri->findt(pnt,clip):nullptr;
+}
+
+point *MortonIndex::findp(xy pnt)
+{
+  bool inside;
+  int i,leaf;
+  unsigned long long c=code(pnt,false,inside);
+  point *ret=nullptr;
+  if (inside && codes.size())
+  {
+    leaf=findLeaf(c);
+    for (i=firstPoint[leaf];i<firstPoint[leaf+1];i++)
+      if (xy(*pnts[i])==pnt)
+        ret=pnts[i];
+  }
+  return ret;
+}
+
+void MortonIndex::localTriangles(int level,unsigned long long start,xy center,double radius,set<triangle *> &list)
+{
+  int i=findLeaf(start),q;
+  double nodeSide=ldexp(side,-level);
+  unsigned long long quarter;
+  xy mid;
+  if (depths[i]<=level)
+  {
+    if (tris[i] && dist(middle(i),center)<=radius)
+      list.insert(tris[i]);
+  }
+  else
+  {
+    mid=xy(x+gatherBits(start)*side/(1<<MORTON_DEPTH)+nodeSide/2,
+           y+gatherBits(start>>1)*side/(1<<MORTON_DEPTH)+nodeSide/2);
+    if (dist(mid,center)<=radius+nodeSide/M_SQRT2)
+    {
+      quarter=1ULL<<(2*(MORTON_DEPTH-level-1));
+      for (q=0;q<4;q++)
+        localTriangles(level+1,start+q*quarter,center,radius,list);
+    }
+  }
+}
+
+set<triangle *> MortonIndex::localTriangles(xy center,double radius,int max)
+/* Returns the triangles of the leaves whose centers are within radius of
+ * center, as qindex::localTriangles does, or a single nullptr if there are
+ * more than max.
+ */
+{
+  set<triangle *> list;
+  if (codes.size())
+    localTriangles(0,0,center,radius,list);
+  if (max<0 || list.size()>max)
+  {
+    list.clear();
+    list.insert(nullptr);
+  }
+  return list;
+}
+
+double MortonIndex::boxDist(int level,unsigned long long start,xy pnt)
+// Distance from pnt to the square of the node, 0 if pnt is in it.
+{
+  double cell=side/(1<<MORTON_DEPTH);
+  double nodeSide=ldexp(side,-level);
+  double lox=x+gatherBits(start)*cell,loy=y+gatherBits(start>>1)*cell;
+  double dx=fmax(fmax(lox-pnt.getx(),pnt.getx()-lox-nodeSide),0);
+  double dy=fmax(fmax(loy-pnt.gety(),pnt.gety()-loy-nodeSide),0);
+  return hypot(dx,dy);
+}
+
+void MortonIndex::nearest(int level,unsigned long long start,xy pnt,int k,vector<pair<double,point *> > &heap)
+/* heap is a max-heap of the k nearest points found so far. The subsquares
+ * are searched nearest first, and a square is skipped if it's farther than
+ * the kth nearest point.
+ */
+{
+  int i=findLeaf(start),q;
+  double d;
+  unsigned long long quarter;
+  array<pair<double,unsigned long long>,4> order;
+  if (heap.size()==k && boxDist(level,start,pnt)>=heap[0].first)
+    return;
+  if (depths[i]<=level)
+    for (q=firstPoint[i];q<firstPoint[i+1];q++)
+    {
+      d=dist(xy(*pnts[q]),pnt);
+      if (heap.size()<k)
+      {
+        heap.push_back(make_pair(d,pnts[q]));
+        push_heap(heap.begin(),heap.end());
+      }
+      else if (d<heap[0].first)
+      {
+        pop_heap(heap.begin(),heap.end());
+        heap.back()=make_pair(d,pnts[q]);
+        push_heap(heap.begin(),heap.end());
+      }
+    }
+  else
+  {
+    quarter=1ULL<<(2*(MORTON_DEPTH-level-1));
+    for (q=0;q<4;q++)
+      order[q]=make_pair(boxDist(level+1,start+q*quarter,pnt),start+q*quarter);
+    sort(order.begin(),order.end());
+    for (q=0;q<4;q++)
+      nearest(level+1,order[q].second,pnt,k,heap);
+  }
+}
+
+vector<point *> MortonIndex::nearest(xy pnt,int k)
+/* Returns the k points nearest pnt, nearest first, or all the points if
+ * there are fewer than k. pnt need not be in the square.
+ */
+{
+  int i;
+  vector<pair<double,point *> > heap;
+  vector<point *> ret;
+  if (codes.size() && k>0 && !pnt.isnan())
+    nearest(0,0,pnt,k,heap);
+  sort_heap(heap.begin(),heap.end());
+  for (i=0;i<heap.size();i++)
+    ret.push_back(heap[i].second);
+  return ret;
+}
+
+void MortonIndex::within(int level,unsigned long long start,xy center,double radius,vector<point *> &list)
+{
+  int i=findLeaf(start),q;
+  unsigned long long quarter;
+  if (boxDist(level,start,center)>radius)
+    return;
+  if (depths[i]<=level)
+  {
+    for (q=firstPoint[i];q<firstPoint[i+1];q++)
+      if (dist(xy(*pnts[q]),center)<=radius)
+        list.push_back(pnts[q]);
+  }
+  else
+  {
+    quarter=1ULL<<(2*(MORTON_DEPTH-level-1));
+    for (q=0;q<4;q++)
+      within(level+1,start+q*quarter,center,radius,list);
+  }
+}
+
+vector<point *> MortonIndex::within(xy center,double radius)
+// Returns the points within radius of center, in Z-order.
+{
+  vector<point *> list;
+  if (codes.size() && !center.isnan())
+    within(0,0,center,radius,list);
+  return list;
+}
+
+void MortonIndex::write(ostream &file,pointlist &pl)
+/* Writes the index, with points as point numbers and triangles as indices
+ * into pl.triangles, so that it can be read back with the same TIN.
+ */
+{
+  int i;
+  unordered_map<triangle *,int> triNums;
+  for (i=0;i<pl.triangles.size();i++)
+    triNums[&pl.triangles[i]]=i;
+  writeleint(file,MORTON_DEPTH);
+  writeledouble(file,x);
+  writeledouble(file,y);
+  writeledouble(file,side);
+  writeleint(file,codes.size());
+  writeleint(file,pnts.size());
+  for (i=0;i<codes.size();i++)
+  {
+    writelelong(file,codes[i]);
+    writeleshort(file,depths[i]);
+    writeleint(file,firstPoint[i]);
+    writeleint(file,tris[i]?triNums[tris[i]]:-1);
+  }
+  for (i=0;i<pnts.size();i++)
+    writeleint(file,pnts[i]->num);
+}
+
+bool MortonIndex::read(istream &file,pointlist &pl)
+/* Reads an index written by write. Returns false, leaving the index empty,
+ * if the file is bad or doesn't match the TIN.
+ */
+{
+  int i,nleaves,npoints,tri,num;
+  bool ok;
+  clear();
+  ok=readleint(file)==MORTON_DEPTH;
+  x=readledouble(file);
+  y=readledouble(file);
+  side=readledouble(file);
+  nleaves=readleint(file);
+  npoints=readleint(file);
+  ok=ok && file.good() && nleaves>=0 && npoints==pl.points.size();
+  for (i=0;ok && i<nleaves;i++)
+  {
+    codes.push_back(readlelong(file));
+    depths.push_back(readleshort(file));
+    firstPoint.push_back(readleint(file));
+    tri=readleint(file);
+    ok=file.good() && tri>=-1 && tri<(int)pl.triangles.size() && depths.back()<=MORTON_DEPTH &&
+       firstPoint.back()>=(i?firstPoint[i-1]:0) && firstPoint.back()<=npoints &&
+       (i==0 || codes[i]>codes[i-1]);
+    if (!ok)
+      break; // indexing pl.triangles with a bad number would add triangles
+    tris.push_back(tri>=0?&pl.triangles[tri]:nullptr);
+  }
+  firstPoint.push_back(npoints);
+  for (i=0;ok && i<npoints;i++)
+  {
+    num=readleint(file);
+    ok=!file.fail() && pl.points.count(num);
+    if (ok)
+      pnts.push_back(&pl.points[num]);
+  }
+  if (!ok)
+    clear();
+  return ok;
+}
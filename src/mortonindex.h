@@ -0,0 +1,83 @@
+/******************************************************/
+/*                                                    */
+/* mortonindex.h - linear quadtree index              */
+/*                                                    */
+/******************************************************/
+/* Copyright 2026 Pierre Abbat.
+ * This file is part of Bezitopo.
+ *
+ * Bezitopo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Bezitopo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License and Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * and Lesser General Public License along with Bezitopo. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MORTONINDEX_H
+#define MORTONINDEX_H
+#include <vector>
+#include <set>
+#include <iostream>
+#include "pointlist.h"
+
+#define MORTON_DEPTH 30
+
+/* A MortonIndex is a qindex flattened into arrays. It covers the same square
+ * and splits it into the same leaves, at most three points to a leaf, but
+ * instead of nodes pointing to their subsquares, it has the leaves in
+ * Z-order, each identified by the Morton code of its lower left corner at
+ * MORTON_DEPTH levels. Finding the leaf of a point is a binary search on
+ * the codes. Each leaf has a triangle to start walking from, like a qindex
+ * leaf, and the range of its points, so that it can both findt and findp.
+ * write and read store the points and triangles by number, so an index
+ * read back is good only for a TIN with the same numbering. No TIN file
+ * that Bezitopo writes is read back yet, so nothing saves an index.
+ *
+ * It also answers nearest-neighbor and radius queries on the points, which
+ * a qindex can't once settri has replaced its leaves' points with triangles.
+ * These need only build, not settri, so they work on a pointlist with no TIN.
+ */
+
+class MortonIndex
+{
+public:
+  double x,y,side;
+  MortonIndex();
+  void clear();
+  void build(pointlist &pl);
+  void settri(pointlist &pl);
+  triangle *findt(xy pnt,bool clip=false);
+  point *findp(xy pnt);
+  std::set<triangle *> localTriangles(xy center,double radius,int max);
+  std::vector<point *> nearest(xy pnt,int k);
+  std::vector<point *> within(xy center,double radius);
+  int leaves();
+  int size(); // number of nodes of the equivalent qindex
+  void write(std::ostream &file,pointlist &pl);
+  bool read(std::istream &file,pointlist &pl);
+private:
+  std::vector<unsigned long long> codes; // Morton code of each leaf's corner
+  std::vector<unsigned char> depths; // level of each leaf; the root is 0
+  std::vector<int> firstPoint; // leaf i's points are [firstPoint[i],firstPoint[i+1])
+  std::vector<point *> pnts; // in Z-order
+  std::vector<triangle *> tris;
+  unsigned long long code(xy pnt,bool clip,bool &inside);
+  xy middle(int leaf);
+  int findLeaf(unsigned long long c);
+  void localTriangles(int level,unsigned long long start,xy center,double radius,std::set<triangle *> &list);
+  double boxDist(int level,unsigned long long start,xy pnt);
+  void nearest(int level,unsigned long long start,xy pnt,int k,std::vector<std::pair<double,point *> > &heap);
+  void within(int level,unsigned long long start,xy center,double radius,std::vector<point *> &list);
+};
+
+unsigned long long mortonCode(unsigned int ix,unsigned int iy);
+#endif
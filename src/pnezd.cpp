@@ -108,11 +108,11 @@ int writepnezd(document *doc,string fname,Measure ms)
   {
     for (i=doc->pl[0].points.begin();i!=doc->pl[0].points.end();i++)
     {
-      p=i->first;
-      n=i->second.north();
-      e=i->second.east();
-      z=i->second.elev();
-      d=i->second.note;
+      p=i->num;
+      n=i->north();
+      e=i->east();
+      z=i->elev();
+      d=i->note;
       pstr=to_string(p);
       nstr=ldecimal(ms.fromCoherent(n,LENGTH),0,true);
       estr=ldecimal(ms.fromCoherent(e,LENGTH),0,true);
@@ -196,11 +196,11 @@ int writepenzd(document *doc,string fname,Measure ms)
   {
     for (i=doc->pl[0].points.begin();i!=doc->pl[0].points.end();i++)
     {
-      p=i->first;
-      n=i->second.north();
-      e=i->second.east();
-      z=i->second.elev();
-      d=i->second.note;
+      p=i->num;
+      n=i->north();
+      e=i->east();
+      z=i->elev();
+      d=i->note;
       pstr=to_string(p);
       nstr=ldecimal(ms.fromCoherent(n,LENGTH));
       estr=ldecimal(ms.fromCoherent(e,LENGTH));
@@ -286,11 +286,11 @@ int writezoom(document *doc,string fname,Measure ms)
   {
     for (i=doc->pl[0].points.begin();i!=doc->pl[0].points.end();i++)
     {
-      p=i->first;
-      n=i->second.north();
-      e=i->second.east();
-      z=i->second.elev();
-      d=i->second.note;
+      p=i->num;
+      n=i->north();
+      e=i->east();
+      z=i->elev();
+      d=i->note;
       pstr=to_string(p);
       nstr=ldecimal(ms.fromCoherent(n,LENGTH));
       estr=ldecimal(ms.fromCoherent(e,LENGTH));
@@ -458,7 +458,9 @@ const xyz nanxyz(NAN,NAN,NAN);
 point::point()
 {
   x=y=z=0;
+  num=0;
   line=NULL;
+  localMark=0;
   flags=0;
   note="";
 }
@@ -468,7 +470,9 @@ point::point(double e,double n,double h,string desc)
   x=e;
   y=n;
   z=h;
+  num=0;
   line=0;
+  localMark=0;
   note=desc;
 }
 
@@ -477,7 +481,9 @@ point::point(xy pnt,double h,string desc)
   x=pnt.x;
   y=pnt.y;
   z=h;
+  num=0;
   line=0;
+  localMark=0;
   note=desc;
 }
 
@@ -486,13 +492,17 @@ point::point(xyz pnt,string desc)
   x=pnt.x;
   y=pnt.y;
   z=pnt.z;
+  num=0;
   line=0;
+  localMark=0;
   note=desc;
 }
 
 point::point(const point &rhs) : xyz(rhs)
 {
+  num=rhs.num;
   line=rhs.line;
+  localMark=0;
   note=rhs.note;
 }
 
@@ -512,7 +522,7 @@ const point& point::operator=(const point &rhs)
 
 //void point::dump(document doc)
 //{
-//  printf("address=%p\nnum=%d\n(%f,%f,%f)\nline=%p\n",this,doc.pl[1].revpoints[this],x,y,z,line);
+//  printf("address=%p\nnum=%d\n(%f,%f,%f)\nline=%p\n",this,num,x,y,z,line);
 //}
 
 bool point::hasProperty(int prop)
@@ -522,7 +532,7 @@ bool point::hasProperty(int prop)
 
 void point::writeXml(ofstream &ofile,pointlist &pl)
 {
-  ofile<<"<point n=\""<<pl.revpoints[this]<<"\" d=\""<<xmlEscape(note)<<"\">"<<ldecimal(x)<<' '<<ldecimal(y)<<' '<<ldecimal(z);
+  ofile<<"<point n=\""<<num<<"\" d=\""<<xmlEscape(note)<<"\">"<<ldecimal(x)<<' '<<ldecimal(y)<<' '<<ldecimal(z);
   ofile<<"<grad>";
   gradient.writeXml(ofile);
   ofile<<"</grad>";
@@ -626,14 +636,17 @@ void point::insertEdge(edge *edg)
 }
 
 edge *point::edg(triangle *tri)
+/* Doesn't move line, so that triangles sharing this point can look up their
+ * sides in different threads.
+ */
 {
   int i;
-  edge *oldline,*ret;
-  for (i=0,oldline=line,ret=NULL;!ret && (!i || oldline!=line);i++)
+  edge *e,*ret;
+  for (i=0,e=line,ret=NULL;e && !ret && (!i || e!=line);i++)
   {
-    if (line->tri(this)==tri)
-      ret=line;
-    line=line->next(this);
+    if (e->tri(this)==tri)
+      ret=e;
+    e=e->next(this);
   }
   return ret;
 }
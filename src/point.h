@@ -85,7 +85,13 @@ public:
    * 3: a point ignored because it's in a group that was merged
    */
   std::string note;
+  int num;
+  /* The point's number in its pointlist, set by the pointlist. Assigning
+   * one point to another doesn't change it, since the point being assigned
+   * to stays in the same place in its pointlist.
+   */
   edge *line; // a line incident on this point in the TIN. Used to arrange the lines in order around their endpoints.
+  unsigned int localMark; // equals pointlist::localEpoch if the point is in localPoints
   edge *edg(triangle *tri);
   // tri.a->edg(tri) is the side opposite tri.b
 public:
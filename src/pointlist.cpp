@@ -23,6 +23,8 @@
  */
 
 #include <cmath>
+#include <algorithm>
+#include <chrono>
 #include "angle.h"
 #include "globals.h"
 #include "pointlist.h"
@@ -32,9 +34,196 @@
 #include "except.h"
 #include "stl.h"
 #include "dxf.h"
+#include "threads.h"
 
 using namespace std;
 
+ptlist::iterator::iterator()
+{
+  list=nullptr;
+  pos=0;
+}
+
+ptlist::iterator::iterator(ptlist *l,int p)
+{
+  list=l;
+  pos=p;
+}
+
+point &ptlist::iterator::operator*()
+{
+  return list->slots[list->order[pos]];
+}
+
+point *ptlist::iterator::operator->()
+{
+  return &list->slots[list->order[pos]];
+}
+
+ptlist::iterator &ptlist::iterator::operator++()
+{
+  pos++;
+  return *this;
+}
+
+ptlist::iterator ptlist::iterator::operator++(int)
+{
+  iterator ret=*this;
+  pos++;
+  return ret;
+}
+
+bool ptlist::iterator::operator==(const iterator &b) const
+{
+  return list==b.list && pos==b.pos;
+}
+
+bool ptlist::iterator::operator!=(const iterator &b) const
+{
+  return !(*this==b);
+}
+
+ptlist::ptlist()
+{
+  sorted=true;
+}
+
+ptlist::ptlist(const ptlist &b)
+{
+  *this=b;
+}
+
+ptlist &ptlist::operator=(const ptlist &b)
+/* Assigning a point doesn't copy its number, so the numbers are set
+ * from the index.
+ */
+{
+  unordered_map<int,int>::iterator i;
+  slots=b.slots;
+  index=b.index;
+  order=b.order;
+  sorted=b.sorted;
+  for (i=index.begin();i!=index.end();++i)
+    slots[i->second].num=i->first;
+  return *this;
+}
+
+point &ptlist::operator[](int num)
+{
+  int slot;
+  unordered_map<int,int>::iterator i=index.find(num);
+  if (i!=index.end())
+    return slots[i->second];
+  slot=slots.size();
+  slots[slot].num=num;
+  index[num]=slot;
+  if (sorted && (order.size()==0 || slots[order.back()].num<num))
+    order.push_back(slot);
+  else
+    sorted=false;
+  return slots[slot];
+}
+
+point &ptlist::insertInOrder(int num)
+/* Like operator[], but if the order is sorted, keeps it sorted with a
+ * memmove instead of sorting all the points on the next iteration. This is
+ * for editing a TIN one point at a time; adding many points out of order
+ * this way would take quadratic time.
+ */
+{
+  int slot;
+  unordered_map<int,int>::iterator i=index.find(num);
+  if (i!=index.end() || !sorted)
+    return (*this)[num];
+  slot=slots.size();
+  slots[slot].num=num;
+  index[num]=slot;
+  order.insert(orderPos(num),slot);
+  return slots[slot];
+}
+
+int ptlist::count(int num)
+{
+  return index.count(num);
+}
+
+size_t ptlist::size()
+{
+  return index.size();
+}
+
+void ptlist::clear()
+{
+  slots.clear();
+  index.clear();
+  order.clear();
+  sorted=true;
+}
+
+void ptlist::erase(int num)
+/* The point's slot is not reused, since something may still point to it,
+ * until the ptlist is cleared.
+ */
+{
+  if (index.erase(num))
+    sorted=false;
+}
+
+void ptlist::eraseInOrder(int num)
+// Like erase, but keeps a sorted order sorted. See insertInOrder.
+{
+  unordered_map<int,int>::iterator i=index.find(num);
+  if (i!=index.end())
+  {
+    if (sorted)
+      order.erase(orderPos(num));
+    index.erase(i);
+  }
+}
+
+vector<int>::iterator ptlist::orderPos(int num)
+// Returns where num is or would be in order, which must be sorted.
+{
+  return lower_bound(order.begin(),order.end(),num,
+                     [this](int slot,int n){return slots[slot].num<n;});
+}
+
+void ptlist::sortOrder()
+{
+  unordered_map<int,int>::iterator i;
+  order.clear();
+  for (i=index.begin();i!=index.end();++i)
+    order.push_back(i->second);
+  sort(order.begin(),order.end(),[this](int a,int b){return slots[a].num<slots[b].num;});
+  sorted=true;
+}
+
+ptlist::iterator ptlist::begin()
+{
+  if (!sorted)
+    sortOrder();
+  return iterator(this,0);
+}
+
+ptlist::iterator ptlist::end()
+{
+  if (!sorted)
+    sortOrder();
+  return iterator(this,order.size());
+}
+
+int ptlist::lowest()
+{
+  return begin()->num;
+}
+
+int ptlist::highest()
+{
+  if (!sorted)
+    sortOrder();
+  return slots[order.back()].num;
+}
+
 criterion::criterion()
 {
   lo=hi=0;
@@ -64,24 +253,64 @@ void criterion::writeXml(ostream &ofile)
   ofile<<"\"/>"<<endl;
 }
 
+DirtyRegion::DirtyRegion()
+{
+  clear();
+}
+
+void DirtyRegion::clear()
+{
+  lo=xy(INFINITY,INFINITY);
+  hi=xy(-INFINITY,-INFINITY);
+}
+
+bool DirtyRegion::isEmpty()
+{
+  return lo.east()>hi.east();
+}
+
+void DirtyRegion::include(xy pnt)
+{
+  if (pnt.east()<lo.east())
+    lo=xy(pnt.east(),lo.north());
+  if (pnt.north()<lo.north())
+    lo=xy(lo.east(),pnt.north());
+  if (pnt.east()>hi.east())
+    hi=xy(pnt.east(),hi.north());
+  if (pnt.north()>hi.north())
+    hi=xy(hi.east(),pnt.north());
+}
+
+bool DirtyRegion::overlaps(xy otherLo,xy otherHi)
+{
+  return !isEmpty() && otherLo.east()<=hi.east() && otherHi.east()>=lo.east() &&
+         otherLo.north()<=hi.north() && otherHi.north()>=lo.north();
+}
+
 pointlist::pointlist()
 {
+  gradCorr=0.15;
+  localEpoch=0;
+  critLog.edgeSeconds=critLog.critSeconds=critLog.subdivSeconds=0;
+  critLog.threads=0;
   initStlTable();
 }
 
 void pointlist::clear()
 {
   contours.clear();
+  contourTriangles.clear();
+  contourPyramids.clear();
   triangles.clear();
   edges.clear();
   points.clear();
-  revpoints.clear();
   triPolyLog.clear();
 }
 
 void pointlist::clearTin()
 {
   triangles.clear();
+  contourTriangles.clear();
   edges.clear();
 }
 
@@ -113,7 +342,7 @@ int pointlist::size()
 int pointlist::lastPointNum()
 {
   if (size())
-    return points.rbegin()->first;
+    return points.highest();
   else
     return 0;
 }
@@ -125,9 +354,9 @@ bool pointlist::pointExists(int n)
 
 void pointlist::clearmarks()
 {
-  map<int,edge>::iterator e;
-  for (e=edges.begin();e!=edges.end();e++)
-    e->second.clearmarks();
+  int i;
+  for (i=0;i<edges.size();i++)
+    edges[i].clearmarks();
 }
 
 int symhash(int a,int b)
@@ -161,24 +390,24 @@ bool pointlist::checkTinConsistency()
   edge *ed;
   for (p=points.begin();p!=points.end();p++)
   {
-    ed=p->second.line;
-    if (ed==nullptr || (ed->a!=&p->second && ed->b!=&p->second))
+    ed=p->line;
+    if (ed==nullptr || (ed->a!=&*p && ed->b!=&*p))
     {
       ret=false;
-      cerr<<"Point "<<p->first<<" line pointer is wrong.\n";
+      cerr<<"Point "<<p->num<<" line pointer is wrong.\n";
     }
     edgebearings.clear();
     do
     {
       if (ed)
-	ed=ed->next(&p->second);
+	ed=ed->next(&*p);
       if (ed)
-	edgebearings.push_back(ed->bearing(&p->second));
-    } while (ed && ed!=p->second.line && edgebearings.size()<=edges.size());
+	edgebearings.push_back(ed->bearing(&*p));
+    } while (ed && ed!=p->line && edgebearings.size()<=edges.size());
     if (edgebearings.size()>=edges.size())
     {
       ret=false;
-      cerr<<"Point "<<p->first<<" next pointers do not return to line pointer.\n";
+      cerr<<"Point "<<p->num<<" next pointers do not return to line pointer.\n";
     }
     for (totturn=i=0;i<edgebearings.size();i++)
     {
@@ -187,13 +416,13 @@ bool pointlist::checkTinConsistency()
       if (turn1==0)
       {
 	ret=false;
-	cerr<<"Point "<<p->first<<" has two equal bearings.\n";
+	cerr<<"Point "<<p->num<<" has two equal bearings.\n";
       }
     }
     if (totturn!=(long long)DEG360) // DEG360 is construed as positive when cast to long long
     {
       ret=false;
-      cerr<<"Point "<<p->first<<" bearings do not wind once counterclockwise.\n";
+      cerr<<"Point "<<p->num<<" bearings do not wind once counterclockwise.\n";
     }
   }
   for (i=0;i<edges.size();i++)
@@ -205,7 +434,7 @@ bool pointlist::checkTinConsistency()
       ed=&edges[i];
       ret=false;
       cerr<<"Edge "<<i<<" has wrong number of adjacent triangles.\n";
-      cerr<<"a "<<revpoints[ed->a]<<" b "<<revpoints[ed->b]<<endl;
+      cerr<<"a "<<ed->a->num<<" b "<<ed->b->num<<endl;
       cerr<<"tria "<<ed->tria<<" trib "<<ed->trib<<" isinterior "<<ed->isinterior()<<endl;
     }
     if (edges[i].tria)
@@ -304,14 +533,14 @@ bool pointlist::checkTinConsistency()
      * For example, arrange points 1-8 counterclockwise and make these triangles:
      * (1 2 3), (1 2 4), (1 4 5), (1 5 6), (1 6 7), (1 7 8).
      */
-    orderedEdge[0]=revpoints[triangles[i].a];
-    orderedEdge[1]=revpoints[triangles[i].b];
+    orderedEdge[0]=triangles[i].a->num;
+    orderedEdge[1]=triangles[i].b->num;
     edgeHash[symhash(orderedEdge[0],orderedEdge[1])].push_back(orderedEdge);
-    orderedEdge[0]=revpoints[triangles[i].b];
-    orderedEdge[1]=revpoints[triangles[i].c];
+    orderedEdge[0]=triangles[i].b->num;
+    orderedEdge[1]=triangles[i].c->num;
     edgeHash[symhash(orderedEdge[0],orderedEdge[1])].push_back(orderedEdge);
-    orderedEdge[0]=revpoints[triangles[i].c];
-    orderedEdge[1]=revpoints[triangles[i].a];
+    orderedEdge[0]=triangles[i].c->num;
+    orderedEdge[1]=triangles[i].a->num;
     edgeHash[symhash(orderedEdge[0],orderedEdge[1])].push_back(orderedEdge);
   }
   for (eh=edgeHash.begin();eh!=edgeHash.end();eh++)
@@ -376,7 +605,7 @@ int1loop pointlist::toInt1loop(vector<point *> ptrLoop)
   int i;
   int1loop ret;
   for (i=0;i<ptrLoop.size();i++)
-    ret.push_back(revpoints[ptrLoop[i]]);
+    ret.push_back(ptrLoop[i]->num);
   return ret;
 }
 
@@ -412,7 +641,7 @@ intloop pointlist::boundary()
       e=&edges[i];
       while (!e->contour)
       {
-	bdy1.push_back(revpoints[e->a]);
+	bdy1.push_back(e->a->num);
 	e->contour++;
 	e=e->nexta;
       }
@@ -422,6 +651,88 @@ intloop pointlist::boundary()
   return ret;
 }
 
+vector<int> pointlist::invalidateContours(DirtyRegion region)
+/* Removes the contours that go through a triangle that overlaps region or
+ * has been deleted, and returns the numbers of the triangles that overlap
+ * region, where the contours have to be traced again. If the contours
+ * don't say which triangles they go through, removes them all and returns
+ * all the triangles.
+ */
+{
+  int i,j,k,n;
+  bool gone;
+  xy corner[3],lo,hi;
+  vector<int> ret;
+  vector<bool> inRegion(triangles.size(),false);
+  if (contourPyramids.size()!=contours.size())
+    contourPyramids.clear();
+  if (contourTriangles.size()!=contours.size())
+  {
+    contours.clear();
+    contourTriangles.clear();
+    contourPyramids.clear();
+    for (i=0;i<triangles.size();i++)
+      ret.push_back(i);
+    return ret;
+  }
+  for (i=0;i<triangles.size();i++)
+  {
+    corner[0]=*triangles[i].a;
+    corner[1]=*triangles[i].b;
+    corner[2]=*triangles[i].c;
+    lo=hi=corner[0];
+    for (j=1;j<3;j++)
+    {
+      lo=xy(min(lo.east(),corner[j].east()),min(lo.north(),corner[j].north()));
+      hi=xy(max(hi.east(),corner[j].east()),max(hi.north(),corner[j].north()));
+    }
+    if (region.overlaps(lo,hi))
+    {
+      inRegion[i]=true;
+      ret.push_back(i);
+    }
+  }
+  for (i=j=0;i<contours.size();i++)
+  {
+    for (gone=false,k=0;!gone && k<contourTriangles[i].size();k++)
+    {
+      n=contourTriangles[i][k];
+      gone=n<0 || n>=triangles.size() || inRegion[n];
+    }
+    if (!gone)
+    {
+      if (j<i)
+      {
+        contours[j]=contours[i];
+        contourTriangles[j].swap(contourTriangles[i]);
+        if (contourPyramids.size())
+          contourPyramids[j]=contourPyramids[i];
+      }
+      j++;
+    }
+  }
+  contours.erase(contours.begin()+j,contours.end());
+  contourTriangles.resize(j);
+  if (contourPyramids.size())
+    contourPyramids.resize(j);
+  return ret;
+}
+
+bezier3d pointlist::contourApprox(int i,double precision)
+/* Returns the coarsest level of contour i's pyramid that is within
+ * precision, or approximates the contour if there are no pyramids or
+ * the pyramid isn't fine enough.
+ */
+{
+  bezier3d *level=nullptr;
+  if (contourPyramids.size()==contours.size())
+    level=contourPyramids[i].level(precision);
+  if (level)
+    return *level;
+  else
+    return contours[i].approx3d(precision);
+}
+
 int pointlist::readCriteria(string fname,Measure ms)
 {
   ifstream infile;
@@ -490,12 +801,12 @@ void pointlist::addpoint(int numb,point pnt,bool overwrite)
        points[a=numb]=pnt;
     else
        {if (numb<0)
-           {a=points.begin()->first-1;
+           {a=points.lowest()-1;
             if (a>=0)
                a=-1;
             }
         else
-           {a=points.rbegin()->first+1;
+           {a=points.highest()+1;
             if (a<=0)
                a=1;
             }
@@ -503,7 +814,6 @@ void pointlist::addpoint(int numb,point pnt,bool overwrite)
         }
  else
     points[a=numb]=pnt;
- revpoints[&(points[a])]=a;
  }
 
 int pointlist::addtriangle(int n)
@@ -524,7 +834,7 @@ void pointlist::makeqindex()
   ptlist::iterator i;
   qinx.clear();
   for (i=points.begin();i!=points.end();i++)
-    plist.push_back(i->second);
+    plist.push_back(*i);
   qinx.sizefit(plist);
   qinx.split(plist);
   if (triangles.size())
@@ -551,6 +861,56 @@ double pointlist::elevation(xy location)
     return nan("");
 }
 
+void pointlist::elevations(const vector<xy> &pnts,vector<double> &elevs)
+/* Computes the elevations at many points, such as the nodes of a grid.
+ * The points are sorted along a Hilbert curve and split among threads.
+ * Each thread finds the triangle of the first point of a run with its own
+ * Locator, which is quick because successive points are close, counts how
+ * many of the following points are in the same triangle, and evaluates
+ * them together with triangle::elevations.
+ */
+{
+  int i;
+  vector<xy> finite;
+  vector<int> which,order;
+  elevs.resize(pnts.size());
+  for (i=0;i<pnts.size();i++)
+    if (pnts[i].isnan())
+      elevs[i]=nan("");
+    else
+    {
+      finite.push_back(pnts[i]);
+      which.push_back(i);
+    }
+  order=hilbertSort(finite);
+  parallelFor(order.size(),[&](int begin,int end,int thread)
+  {
+    int i,j,k;
+    Locator loc(qinx);
+    triangle *tri;
+    vector<xy> sorted;
+    vector<double> sortedElev(end-begin);
+    for (i=begin;i<end;i++)
+      sorted.push_back(finite[order[i]]);
+    for (i=0;i<sorted.size();i=j)
+    {
+      tri=loc.findt(sorted[i]);
+      if (tri)
+      {
+        j=i+1+tri->countIn(&sorted[i+1],sorted.size()-i-1);
+        tri->elevations(&sorted[i],&sortedElev[i],j-i);
+      }
+      else
+      {
+        j=i+1;
+        sortedElev[i]=nan("");
+      }
+    }
+    for (k=begin;k<end;k++)
+      elevs[which[order[k]]]=sortedElev[k-begin];
+  });
+}
+
 void pointlist::setgradient(bool flat)
 {
   int i;
@@ -577,7 +937,7 @@ double pointlist::dirbound(int angle)
   double s=sin(angle),c=cos(angle);
   for (i=points.begin();i!=points.end();i++)
   {
-    turncoord=i->second.east()*c+i->second.north()*s;
+    turncoord=i->east()*c+i->north()*s;
     if (turncoord<bound)
       bound=turncoord;
   }
@@ -586,35 +946,72 @@ double pointlist::dirbound(int angle)
 
 void pointlist::findedgecriticalpts()
 {
-  map<int,edge>::iterator e;
-  for (e=edges.begin();e!=edges.end();e++)
-    e->second.findextrema();
+  parallelFor(edges.size(),[&](int begin,int end,int thread)
+  {
+    int i;
+    for (i=begin;i<end;i++)
+      edges[i].findextrema();
+  });
 }
 
-void pointlist::findcriticalpts()
+void pointlist::findcriticalpts(bool lazy)
+/* Each phase is done in parallel. The edges' extrema are found first, since
+ * subdividing a triangle needs the extrema of its sides. After that, each
+ * triangle's critical points and subdivision depend only on the triangle
+ * and its sides, so the result is the same for any number of threads.
+ * The time of each phase is in critLog.
+ *
+ * If lazy is true, only the edges' extrema are found, and each triangle is
+ * subdivided, with its perimeter, when contour tracing first reaches it.
+ * Contours at a coarse interval, or in a TIN that is mostly flat, then don't
+ * pay for subdividing triangles they don't go through. Lazy subdivision
+ * is not thread-safe; trace contours in one thread, or subdivide first.
+ */
 {
-  map<int,triangle>::iterator t;
+  int i;
+  chrono::steady_clock::time_point start;
+  critLog.threads=threadCount();
+  start=chrono::steady_clock::now();
   findedgecriticalpts();
-  for (t=triangles.begin();t!=triangles.end();t++)
+  critLog.edgeSeconds=chrono::duration<double>(chrono::steady_clock::now()-start).count();
+  critLog.critSeconds=critLog.subdivSeconds=0;
+  if (lazy)
   {
-    t->second.findcriticalpts();
-    t->second.subdivide();
+    for (i=0;i<triangles.size();i++)
+      triangles[i].dropCold();
+    return;
   }
+  start=chrono::steady_clock::now();
+  parallelFor(triangles.size(),[&](int begin,int end,int thread)
+  {
+    int i;
+    for (i=begin;i<end;i++)
+      triangles[i].findcriticalpts();
+  });
+  critLog.critSeconds=chrono::duration<double>(chrono::steady_clock::now()-start).count();
+  start=chrono::steady_clock::now();
+  parallelFor(triangles.size(),[&](int begin,int end,int thread)
+  {
+    int i;
+    for (i=begin;i<end;i++)
+      triangles[i].subdivide();
+  });
+  critLog.subdivSeconds=chrono::duration<double>(chrono::steady_clock::now()-start).count();
 }
 
 void pointlist::addperimeter()
 {
-  map<int,triangle>::iterator t;
+  int i;
   cout<<"Adding perimeter to "<<triangles.size()<<" triangles\n";
-  for (t=triangles.begin();t!=triangles.end();t++)
-    t->second.addperimeter();
+  for (i=0;i<triangles.size();i++)
+    triangles[i].addperimeter();
 }
 
 void pointlist::removeperimeter()
 {
-  map<int,triangle>::iterator t;
-  for (t=triangles.begin();t!=triangles.end();t++)
-    t->second.removeperimeter();
+  int i;
+  for (i=0;i<triangles.size();i++)
+    triangles[i].removeperimeter();
 }
 
 triangle *pointlist::findt(xy pnt,bool clip)
@@ -667,7 +1064,7 @@ void pointlist::edgesToBreaklines()
   type0Breaklines.clear();
   for (i=0;i<edges.size();i++)
     if (!edges[i].delaunay() || (edges[i].broken&1))
-      type0Breaklines.push_back(Breakline0(revpoints[edges[i].a],revpoints[edges[i].b]));
+      type0Breaklines.push_back(Breakline0(edges[i].a->num,edges[i].b->num));
   joinBreaklines();
   whichBreak0Valid=3;
 }
@@ -712,13 +1109,13 @@ string pointlist::hitTestString(triangleHit hit)
 {
   string ret;
   if (hit.cor)
-    ret=to_string(revpoints[hit.cor])+' '+hit.cor->note;
+    ret=to_string(hit.cor->num)+' '+hit.cor->note;
   if (hit.edg)
-    ret=to_string(revpoints[hit.edg->a])+'-'+to_string(revpoints[hit.edg->b]);
+    ret=to_string(hit.edg->a->num)+'-'+to_string(hit.edg->b->num);
   if (hit.tri)
-    ret='('+to_string(revpoints[hit.tri->a])+' '+
-        to_string(revpoints[hit.tri->b])+' '+
-        to_string(revpoints[hit.tri->c])+')';
+    ret='('+to_string(hit.tri->a->num)+' '+
+        to_string(hit.tri->b->num)+' '+
+        to_string(hit.tri->c->num)+')';
   return ret;
 }
 
@@ -728,20 +1125,39 @@ string pointlist::hitTestPointString(xy pnt,double radius)
   string ret;
   for (i=points.begin();i!=points.end();++i)
   {
-    if (dist(i->second,pnt)<radius)
+    if (dist(*i,pnt)<radius)
     {
       if (ret.length())
         ret+=' ';
-      ret+=to_string(i->first)+' '+i->second.note;
+      ret+=to_string(i->num)+' '+i->note;
     }
   }
   return ret;
 }
 
-void pointlist::addIfIn(triangle *t,set<triangle *> &addenda,xy pnt,double radius)
+void pointlist::newLocalEpoch()
+/* Starts a new epoch, so that nothing is marked as in the local sets.
+ * When the epoch wraps around, all the marks are cleared.
+ */
+{
+  int i;
+  ptlist::iterator j;
+  if (++localEpoch==0)
+  {
+    for (i=0;i<triangles.size();i++)
+      triangles[i].localMark=0;
+    for (i=0;i<edges.size();i++)
+      edges[i].localMark=0;
+    for (j=points.begin();j!=points.end();++j)
+      j->localMark=0;
+    localEpoch=1;
+  }
+}
+
+bool pointlist::localAll()
+// True if the local sets are {nullptr}, meaning that everything should be drawn.
 {
-  if (t && !localTriangles.count(t) && t->inCircle(pnt,radius))
-    addenda.insert(t);
+  return localEdges.size()==1 && localEdges[0]==nullptr;
 }
 
 void pointlist::setLocalSets(xy pnt,double radius)
@@ -750,65 +1166,97 @@ void pointlist::setLocalSets(xy pnt,double radius)
  *   all the edges.
  * • There are no triangles. A qindex is an index of triangles.
  * An empty qindex would produce {}, so this condition has to be checked.
+ *
+ * The triangles found through the qindex are flooded to their neighbors
+ * that touch the circle, breadth first, using localTriangles as the queue.
+ * Membership is checked by localMark, so this takes time proportional to
+ * the number of triangles in view and doesn't allocate once the vectors
+ * have grown to fit the view.
  */
 {
-  set<point *>::iterator i;
-  set<edge *>::iterator j;
-  set<triangle *>::iterator k;
-  int n;
-  vector<edge *> pointEdges;
-  set<triangle *> addenda;
+  int i,n;
+  triangle *t;
+  triangle *neigh[3];
+  point *corner[3];
+  edge *e;
   localTriangles.clear();
   localEdges.clear();
   localPoints.clear();
-  if (triangles.size())
-    localTriangles=qinx.localTriangles(pnt,radius,triangles.size()/64+100);
-  else
-    localTriangles.insert(nullptr);
-  if (localTriangles.count(nullptr))
+  newLocalEpoch();
+  if (triangles.size()==0 || !qinx.localTriangles(pnt,radius,triangles.size()/64+100,localTriangles,localEpoch))
   {
-    localEdges.insert(nullptr);
-    localPoints.insert(nullptr);
+    localTriangles.clear();
+    localTriangles.push_back(nullptr);
+    localEdges.push_back(nullptr);
+    localPoints.push_back(nullptr);
     //cout<<"No triangles or view is too big\n";
   }
   else
   {
-    do
+    for (i=0;i<localTriangles.size();i++)
     {
-      addenda.clear();
-      for (k=localTriangles.begin();k!=localTriangles.end();++k)
-      {
-	addIfIn((*k)->aneigh,addenda,pnt,radius);
-	addIfIn((*k)->bneigh,addenda,pnt,radius);
-	addIfIn((*k)->cneigh,addenda,pnt,radius);
-      }
-      for (k=addenda.begin();k!=addenda.end();++k)
-	localTriangles.insert(*k);
-    } while (addenda.size());
-    for (k=localTriangles.begin();k!=localTriangles.end();++k)
-    {
-      localPoints.insert((*k)->a);
-      localPoints.insert((*k)->b);
-      localPoints.insert((*k)->c);
+      t=localTriangles[i];
+      neigh[0]=t->aneigh;
+      neigh[1]=t->bneigh;
+      neigh[2]=t->cneigh;
+      for (n=0;n<3;n++)
+        if (neigh[n] && neigh[n]->localMark!=localEpoch && neigh[n]->inCircle(pnt,radius))
+        {
+          neigh[n]->localMark=localEpoch;
+          localTriangles.push_back(neigh[n]);
+        }
     }
-    for (i=localPoints.begin();i!=localPoints.end();++i)
+    for (i=0;i<localTriangles.size();i++)
     {
-      pointEdges=(*i)->incidentEdges();
-      for (n=0;n<pointEdges.size();n++)
-	localEdges.insert(pointEdges[n]);
+      t=localTriangles[i];
+      corner[0]=t->a;
+      corner[1]=t->b;
+      corner[2]=t->c;
+      for (n=0;n<3;n++)
+        if (corner[n]->localMark!=localEpoch)
+        {
+          corner[n]->localMark=localEpoch;
+          localPoints.push_back(corner[n]);
+        }
     }
-    for (j=localEdges.begin();j!=localEdges.end();++j)
+    for (i=0;i<localPoints.size();i++)
+      if (localPoints[i]->line)
+      {
+        e=localPoints[i]->line;
+        do
+        {
+          if (e->localMark!=localEpoch)
+          {
+            e->localMark=localEpoch;
+            localEdges.push_back(e);
+          }
+          e=e->next(localPoints[i]);
+        } while (e!=localPoints[i]->line);
+      }
+    for (i=0;i<localEdges.size();i++)
     { // localTriangles() usually doesn't find all triangles, and may even miss a point.
-      if ((*j)->tria)
-	localTriangles.insert((*j)->tria);
-      if ((*j)->trib)
-	localTriangles.insert((*j)->trib);
-      localPoints.insert((*j)->a);
-      localPoints.insert((*j)->b);
+      e=localEdges[i];
+      if (e->tria && e->tria->localMark!=localEpoch)
+      {
+        e->tria->localMark=localEpoch;
+        localTriangles.push_back(e->tria);
+      }
+      if (e->trib && e->trib->localMark!=localEpoch)
+      {
+        e->trib->localMark=localEpoch;
+        localTriangles.push_back(e->trib);
+      }
+      if (e->a->localMark!=localEpoch)
+      {
+        e->a->localMark=localEpoch;
+        localPoints.push_back(e->a);
+      }
+      if (e->b->localMark!=localEpoch)
+      {
+        e->b->localMark=localEpoch;
+        localPoints.push_back(e->b);
+      }
     }
-    assert(!localPoints.count(nullptr));
-    assert(!localEdges.count(nullptr));
-    assert(!localTriangles.count(nullptr));
     //cout<<localPoints.size()<<" points "<<localEdges.size()<<" edges "<<localTriangles.size()<<" triangles\n";
   }
 }
@@ -817,7 +1265,6 @@ void pointlist::writeXml(ofstream &ofile)
 {
   int i;
   ptlist::iterator p;
-  map<int,triangle>::iterator t;
   ofile<<"<Pointlist><Criteria>";
   for (i=0;i<crit.size();i++)
     crit[i].writeXml(ofile);
@@ -826,15 +1273,15 @@ void pointlist::writeXml(ofstream &ofile)
   {
     if (i && (i%1)==0)
       ofile<<endl;
-    p->second.writeXml(ofile,*this);
+    p->writeXml(ofile,*this);
   }
   ofile<<"</Points>"<<endl;
   ofile<<"<TIN>";
-  for (t=triangles.begin(),i=0;t!=triangles.end();t++,i++)
+  for (i=0;i<triangles.size();i++)
   {
     if (i && (i%1)==0)
       ofile<<endl;
-    t->second.writeXml(ofile,*this);
+    triangles[i].writeXml(ofile,*this);
   }
   ofile<<"</TIN>"<<endl;
   ofile<<"<Contours>";
@@ -856,7 +1303,8 @@ void pointlist::roscat(xy tfrom,int ro,double sca,xy tto)
   ptlist::iterator j;
   for (i=0;i<contours.size();i++)
     contours[i]._roscat(tfrom,ro,sca,cossin(ro)*sca,tto);
+  contourPyramids.clear();
   for (j=points.begin();j!=points.end();j++)
-    j->second._roscat(tfrom,ro,sca,cossin(ro)*sca,tto);
+    j->_roscat(tfrom,ro,sca,cossin(ro)*sca,tto);
 }
 
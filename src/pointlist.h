@@ -25,6 +25,7 @@
 #define POINTLIST_H
 
 #include <map>
+#include <unordered_map>
 #include <string>
 #include <vector>
 #include <array>
@@ -37,13 +38,70 @@
 #include "contour.h"
 #include "breakline.h"
 #include "intloop.h"
+#include "arena.h"
 
 #ifdef _MSC_VER
 typedef long long ssize_t;
 #endif
 
-typedef std::map<int,point> ptlist;
-typedef std::map<point*,int> revptlist;
+/* Ways of making a TIN. The flip engine starts with a sweep-hull fan
+ * and flips edges until it's Delaunay; the parallel flip engine does
+ * the same, flipping edges in several threads at once; the
+ * divide-and-conquer engine makes the Delaunay triangulation directly.
+ * All insert type-0 breaklines directly, not by flipping.
+ */
+#define TIN_FLIP 0
+#define TIN_DIVCONQ 1
+#define TIN_PARFLIP 2
+
+class ptlist
+/* The points of a pointlist, kept in an Arena so that they don't move,
+ * with a hash from point number to place in the Arena. Each point holds
+ * its own number. Iterating goes in order of point number, as with the map
+ * this replaces; the order is sorted only when points have been added out
+ * of order or deleted, except that insertInOrder and eraseInOrder, used
+ * when editing a TIN point by point, keep it sorted. Indexing a number
+ * that isn't there adds a point.
+ */
+{
+public:
+  class iterator
+  {
+  public:
+    iterator();
+    iterator(ptlist *l,int p);
+    point &operator*();
+    point *operator->();
+    iterator &operator++();
+    iterator operator++(int);
+    bool operator==(const iterator &b) const;
+    bool operator!=(const iterator &b) const;
+  private:
+    ptlist *list;
+    int pos;
+  };
+  ptlist();
+  ptlist(const ptlist &b);
+  ptlist &operator=(const ptlist &b);
+  point &operator[](int num);
+  int count(int num);
+  size_t size();
+  void clear();
+  void erase(int num);
+  point &insertInOrder(int num);
+  void eraseInOrder(int num);
+  iterator begin();
+  iterator end();
+  int lowest();
+  int highest();
+private:
+  Arena<point> slots;
+  std::unordered_map<int,int> index;
+  std::vector<int> order; // slots in order of point number
+  bool sorted;
+  void sortOrder();
+  std::vector<int>::iterator orderPos(int num);
+};
 
 class criterion
 {
@@ -63,6 +121,33 @@ typedef std::vector<criterion> criteria;
  * is included in the topo. If none matches, it is not included.
  */
 
+struct GradLogEntry
+{
+  double maxChange; // the most any point's gradient changed in the sweep
+  double seconds;
+};
+
+struct CritLog
+// Seconds taken by each phase of the last findcriticalpts
+{
+  double edgeSeconds,critSeconds,subdivSeconds;
+  int threads;
+};
+
+class DirtyRegion
+/* The rectangle of a TIN whose surface has been changed by inserting,
+ * moving, or removing points, where the contours have to be redrawn.
+ */
+{
+public:
+  xy lo,hi;
+  DirtyRegion();
+  void clear();
+  bool isEmpty();
+  void include(xy pnt);
+  bool overlaps(xy otherLo,xy otherHi);
+};
+
 struct TriPolyLogEntry
 {
   std::vector<point *> loop;
@@ -73,23 +158,35 @@ class pointlist
 {
 private:
   std::vector<segment> break0;
+  SegmentGrid break0Grid;
 public:
   ptlist points;
-  revptlist revpoints;
-  std::map<int,edge> edges;
-  std::map<int,triangle> triangles;
-  /* edges and triangles are logically arrays from 0 to size()-1, but are
-   * implemented as maps, because they have pointers to each other, and points
-   * point to edges, and the pointers would be messed up by moving memory
-   * when a vector is resized.
+  Arena<edge> edges;
+  Arena<triangle> triangles;
+  /* edges and triangles are arrays from 0 to size()-1, but are Arenas, not
+   * vectors, because they have pointers to each other, and points point to
+   * edges, and the pointers would be messed up by moving memory when a
+   * vector is resized.
    */
   std::vector<polyspiral> contours;
-  std::set<point *> localPoints;
-  std::set<edge *> localEdges;
-  std::set<triangle *> localTriangles;
+  std::vector<std::vector<int> > contourTriangles;
+  /* The numbers of the triangles each contour goes through, sorted, so that
+   * after editing the TIN only the contours through the dirty region are
+   * redrawn. -1 is a triangle that has been deleted.
+   */
+  std::vector<BezierPyramid> contourPyramids;
+  /* Approximations of each contour for drawing at different scales, made
+   * after smoothing. If there aren't as many as contours, there are none.
+   */
+  std::vector<point *> localPoints;
+  std::vector<edge *> localEdges;
+  std::vector<triangle *> localTriangles;
   /* localPoints, localEdges, and localTriangles are used to speed up repainting
-   * when the view is of a small fraction of a huge TIN.
+   * when the view is of a small fraction of a huge TIN. They are vectors,
+   * kept between repaints so that they don't allocate, and each point, edge,
+   * or triangle in them has its localMark set to localEpoch.
    */
+  unsigned int localEpoch;
   criteria crit;
   ContourInterval contourInterval;
   std::vector<Breakline0> type0Breaklines;
@@ -102,6 +199,10 @@ public:
    */
   qindex qinx;
   std::vector<TriPolyLogEntry> triPolyLog;
+  std::vector<GradLogEntry> gradLog;
+  CritLog critLog;
+  double gradCorr; // the corr of the last makegrad, used when editing the TIN
+  DirtyRegion dirtyRegion;
   pointlist();
   void addpoint(int numb,point pnt,bool overwrite=false);
   int addtriangle(int n=1);
@@ -119,10 +220,12 @@ public:
   int1loop toInt1loop(std::vector<point *> ptrLoop);
   std::vector<point *> fromInt1loop(int1loop intLoop);
   intloop boundary();
+  std::vector<int> invalidateContours(DirtyRegion region);
+  bezier3d contourApprox(int i,double precision);
   int readCriteria(std::string fname,Measure ms);
   void setgradient(bool flat=false);
   void findedgecriticalpts();
-  void findcriticalpts();
+  void findcriticalpts(bool lazy=false);
   void addperimeter();
   void removeperimeter();
   triangle *findt(xy pnt,bool clip=false);
@@ -133,9 +236,34 @@ public:
   void readBreaklines(std::string filename);
   std::string hitTestString(triangleHit hit);
   std::string hitTestPointString(xy pnt,double radius);
-  void addIfIn(triangle *t,std::set<triangle *> &addenda,xy pnt,double radius);
+  void newLocalEpoch();
+  bool localAll();
   void setLocalSets(xy pnt,double radius);
   virtual void writeXml(std::ofstream &ofile);
+  // the following methods are in delaunay.cpp
+  void divideConquerTin(bool spatialSort=true);
+  edge *findEdge(point *p,point *q);
+  void unlinkEdge(edge *e);
+  void linkEdge(edge *e);
+  void fillPseudoPolygon(std::vector<point *> poly,point *a,point *b,std::vector<edge *> &spare);
+  void insertConstraint(point *a,point *b);
+  void insertBreaklines();
+  bool insertTinPoint(int numb,point pnt);
+  bool removeTinPoint(int numb);
+  bool moveTinPoint(int numb,xyz pnt);
+private:
+  void attachTriangle(triangle *t);
+  triangle *newTriangle(std::vector<triangle *> &spare);
+  edge *newEdge(point *a,point *b,std::vector<edge *> &spare);
+  edge *visibleHullEdge(xy pnt);
+  triangle *insertionTriangle(xy pnt,int o[3],edge *&hull);
+  void remakeBreak0();
+  bool inBreakline(int numb);
+  void flipToDelaunay(std::vector<edge *> queue,std::vector<triangle *> &changed);
+  void dropEdges(std::vector<edge *> dead);
+  void dropTriangles(std::vector<triangle *> dead,std::vector<triangle *> &changed);
+  void renumberContourTriangles(const std::unordered_map<int,int> &renum);
+public:
   // the following methods are in tin.cpp
 private:
   void dumpedges();
@@ -149,8 +277,11 @@ public:
   bool tryStartPoint(PostScript &ps,xy &startpnt);
   int1loop convexHull();
   int flipPass(PostScript &ps,bool colorfibaster);
-  void maketin(std::string filename="",bool colorfibaster=false);
-  void makegrad(double corr);
+  int parallelFlipPass();
+  void sortEdges();
+  int maketin(std::string filename="",bool colorfibaster=false,int engine=TIN_DIVCONQ,bool spatialSort=true);
+  int makegrad(double corr,double tolerance=1e-9,int maxSweeps=10);
+  void resurface(std::vector<triangle *> &changed,std::vector<point *> moved=std::vector<point *>());
   void maketriangles();
   void makeqindex();
   void updateqindex();
@@ -161,6 +292,7 @@ public:
   void fillInBareTin();
   double totalEdgeLength();
   double elevation(xy location);
+  void elevations(const std::vector<xy> &pnts,std::vector<double> &elevs);
   double dirbound(int angle);
   std::array<double,2> lohi();
   virtual void roscat(xy tfrom,int ro,double sca,xy tto); // rotate, scale, translate
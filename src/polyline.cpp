@@ -167,35 +167,44 @@ int polyline::size()
   return lengths.size();
 }
 
+template <class T> unsigned memHash(ChunkVector<T> &v,unsigned previous)
+// Same as memHash of the elements laid end to end, as they were in a vector.
+{
+  int i;
+  for (i=0;i<v.size();i++)
+    previous=memHash(&v[i],sizeof(T),previous);
+  return previous;
+}
+
 unsigned polyline::hash()
 {
-  return memHash(&lengths[0],lengths.size()*sizeof(double),
-         memHash(&cumLengths[0],cumLengths.size()*sizeof(double),
-         memHash(&endpoints[0],endpoints.size()*sizeof(xy),
+  return memHash(lengths,
+         memHash(cumLengths,
+         memHash(endpoints,
          memHash(&elevation,sizeof(double)))));
 }
 
 unsigned polyarc::hash()
 {
-  return memHash(&deltas[0],deltas.size()*sizeof(int),
-         memHash(&lengths[0],lengths.size()*sizeof(double),
-         memHash(&cumLengths[0],cumLengths.size()*sizeof(double),
-         memHash(&endpoints[0],endpoints.size()*sizeof(xy),
+  return memHash(deltas,
+         memHash(lengths,
+         memHash(cumLengths,
+         memHash(endpoints,
          memHash(&elevation,sizeof(double))))));
 }
 
 unsigned polyspiral::hash()
 {
-  return memHash(&bearings[0],bearings.size()*sizeof(int),
-         memHash(&delta2s[0],delta2s.size()*sizeof(int),
-         memHash(&midbearings[0],midbearings.size()*sizeof(int),
-         memHash(&midpoints[0],midpoints.size()*sizeof(xy),
-         memHash(&curvatures[0],curvatures.size()*sizeof(double),
-         memHash(&clothances[0],clothances.size()*sizeof(double),
-         memHash(&deltas[0],deltas.size()*sizeof(int),
-         memHash(&lengths[0],lengths.size()*sizeof(double),
-         memHash(&cumLengths[0],cumLengths.size()*sizeof(double),
-         memHash(&endpoints[0],endpoints.size()*sizeof(xy),
+  return memHash(bearings,
+         memHash(delta2s,
+         memHash(midbearings,
+         memHash(midpoints,
+         memHash(curvatures,
+         memHash(clothances,
+         memHash(deltas,
+         memHash(lengths,
+         memHash(cumLengths,
+         memHash(endpoints,
          memHash(&elevation,sizeof(double))))))))))));
 }
 
@@ -292,9 +301,6 @@ void polyline::dedup()
  */
 {
   int h,i,j,k;
-  vector<xy>::iterator ptit;
-  vector<double>::iterator lenit;
-  vector<bcir>::iterator bcit;
   xy avg;
   //if (dist(endpoints[0],xy(999992.534,1499993.823))<0.001)
   //  cout<<"Debug contour\r";
@@ -321,14 +327,10 @@ void polyline::dedup()
     if (i!=j && (dist(endpoints[i],endpoints[j])*16777216<=dist(endpoints[h],endpoints[i]) || dist(endpoints[i],endpoints[j])*16777216<=dist(endpoints[j],endpoints[k]) || dist(endpoints[i],endpoints[j])*281474976710656.<=dist(endpoints[i],-endpoints[j]) || endpoints[j].isnan()))
     {
       avg=(endpoints[i]+endpoints[j])/2;
-      ptit=endpoints.begin()+i;
-      lenit=lengths.begin()+i;
-      endpoints.erase(ptit);
-      lengths.erase(lenit);
-      lenit=cumLengths.begin()+i;
-      cumLengths.erase(lenit);
-      bcit=boundCircles.begin()+i;
-      boundCircles.erase(bcit);
+      endpoints.erase(i);
+      lengths.erase(i);
+      cumLengths.erase(i);
+      boundCircles.erase(i);
       if (h>i)
 	h--;
       if (k>i)
@@ -360,26 +362,22 @@ void polyline::insert(xy newpoint,int pos)
  */
 {
   bool wasopen;
-  int i;
-  vector<xy>::iterator ptit;
-  vector<double>::iterator lenit;
-  vector<bcir>::iterator bcit;
+  int i,segpos;
   if (newpoint.isnan())
     cerr<<"Inserting NaN"<<endl;
   wasopen=isopen();
   if (pos<0 || pos>endpoints.size())
     pos=endpoints.size();
-  ptit=endpoints.begin()+pos;
-  lenit=lengths.begin()+pos;
-  endpoints.insert(ptit,newpoint);
-  lengths.insert(lenit,0);
-  bcit=boundCircles.begin()+pos;
-  boundCircles.insert(bcit,{xy(0,0),0});
-  lenit=cumLengths.begin()+pos;
-  if (pos<cumLengths.size())
-    cumLengths.insert(lenit,cumLengths[pos]);
+  segpos=pos;
+  if (segpos>lengths.size())
+    segpos=lengths.size(); // after the last point of an open polyline
+  endpoints.insert(pos,newpoint);
+  lengths.insert(segpos,0);
+  boundCircles.insert(segpos,{xy(0,0),0});
+  if (segpos<cumLengths.size())
+    cumLengths.insert(segpos,cumLengths[segpos]);
   else
-    cumLengths.insert(lenit,0);
+    cumLengths.insert(segpos,0);
   pos--;
   if (pos<0)
     if (wasopen)
@@ -406,27 +404,21 @@ void polyarc::insert(xy newpoint,int pos)
 {
   bool wasopen;
   double totdist=0,totdelta=0;
-  int i,savepos,newdelta[2];
-  vector<xy>::iterator ptit;
-  vector<int>::iterator arcit;
-  vector<double>::iterator lenit;
-  vector<bcir>::iterator bcit;
+  int i,savepos,segpos,newdelta[2];
   wasopen=isopen();
   if (pos<0 || pos>endpoints.size())
     pos=endpoints.size();
-  ptit=endpoints.begin()+pos;
-  lenit=lengths.begin()+pos;
-  arcit=deltas.begin()+pos;
-  endpoints.insert(ptit,newpoint);
-  deltas.insert(arcit,0);
-  lengths.insert(lenit,0);
-  bcit=boundCircles.begin()+pos;
-  boundCircles.insert(bcit,{xy(0,0),0});
-  lenit=cumLengths.begin()+pos;
-  if (pos<cumLengths.size())
-    cumLengths.insert(lenit,cumLengths[pos]);
+  segpos=pos;
+  if (segpos>lengths.size())
+    segpos=lengths.size(); // after the last point of an open polyarc
+  endpoints.insert(pos,newpoint);
+  deltas.insert(segpos,0);
+  lengths.insert(segpos,0);
+  boundCircles.insert(segpos,{xy(0,0),0});
+  if (segpos<cumLengths.size())
+    cumLengths.insert(segpos,cumLengths[segpos]);
   else
-    cumLengths.insert(lenit,0);
+    cumLengths.insert(segpos,0);
   pos--;
   if (pos<0)
     if (wasopen)
@@ -947,10 +939,6 @@ void polyspiral::insert(xy newpoint,int pos)
 {
   bool wasopen;
   int i,savepos,newBearing=0;
-  vector<xy>::iterator ptit,midit;
-  vector<int>::iterator arcit,brgit,d2it,mbrit;
-  vector<double>::iterator lenit,cloit,crvit;
-  vector<bcir>::iterator bcit;
   wasopen=isopen();
   if (pos<0 || pos>endpoints.size())
     pos=endpoints.size();
@@ -959,35 +947,24 @@ void polyspiral::insert(xy newpoint,int pos)
       newBearing=bearings[pos];
     else
       newBearing=bearings[pos-1];
-  ptit=endpoints.begin()+pos;
-  brgit=bearings.begin()+pos;
+  endpoints.insert(pos,newpoint);
+  bearings.insert(pos,newBearing);
   savepos=pos;
   pos--;
   if (pos<0)
-    if (wasopen || endpoints.size()==0)
+    if (wasopen || endpoints.size()==1)
       pos=0;
     else
-      pos+=endpoints.size();
-  midit=midpoints.begin()+pos;
-  lenit=lengths.begin()+pos;
-  arcit=deltas.begin()+pos;
-  d2it=delta2s.begin()+pos;
-  mbrit=midbearings.begin()+pos;
-  cloit=clothances.begin()+pos;
-  crvit=curvatures.begin()+pos;
-  endpoints.insert(ptit,newpoint);
-  deltas.insert(arcit,0);
-  lengths.insert(lenit,1);
-  midpoints.insert(midit,newpoint);
-  bearings.insert(brgit,newBearing);
-  delta2s.insert(d2it,0);
-  midbearings.insert(mbrit,0);
-  curvatures.insert(crvit,0);
-  clothances.insert(cloit,0);
-  lenit=cumLengths.begin()+pos;
-  cumLengths.insert(lenit,0);
-  bcit=boundCircles.begin()+pos;
-  boundCircles.insert(bcit,{xy(0,0),0});
+      pos+=endpoints.size()-1;
+  deltas.insert(pos,0);
+  lengths.insert(pos,1);
+  midpoints.insert(pos,newpoint);
+  delta2s.insert(pos,0);
+  midbearings.insert(pos,0);
+  curvatures.insert(pos,0);
+  clothances.insert(pos,0);
+  cumLengths.insert(pos,0);
+  boundCircles.insert(pos,{xy(0,0),0});
   pos=savepos;
   for (i=-1;i<2;i++)
     setbear((pos+i+endpoints.size())%endpoints.size());
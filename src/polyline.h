@@ -30,6 +30,7 @@
 #include "arc.h"
 #include "bezier3d.h"
 #include "spiral.h"
+#include "chunkvector.h"
 
 extern int bendlimit;
 /* The maximum angle through which a segment of polyspiral can bend. If the bend
@@ -52,9 +53,13 @@ class polyline: public drawobj
 {
 protected:
   double elevation;
-  std::vector<xy> endpoints;
-  std::vector<double> lengths,cumLengths;
-  std::vector<bcir> boundCircles;
+  ChunkVector<xy> endpoints;
+  ChunkVector<double> lengths,cumLengths;
+  ChunkVector<bcir> boundCircles;
+  /* These are ChunkVectors, not vectors, because smoothing a contour inserts
+   * points all over it. cumLengths is not updated past an inserted point
+   * until setlengths is called.
+   */
 public:
   friend class polyarc;
   friend class polyspiral;
@@ -96,7 +101,7 @@ public:
 class polyarc: public polyline
 {
 protected:
-  std::vector<int> deltas;
+  ChunkVector<int> deltas;
 public:
   friend class polyspiral;
   polyarc();
@@ -124,11 +129,11 @@ public:
 class polyspiral: public polyarc
 {
 protected:
-  std::vector<int> bearings; // correspond to endpoints
-  std::vector<int> delta2s;
-  std::vector<int> midbearings;
-  std::vector<xy> midpoints;
-  std::vector<double> clothances,curvatures;
+  ChunkVector<int> bearings; // correspond to endpoints
+  ChunkVector<int> delta2s;
+  ChunkVector<int> midbearings;
+  ChunkVector<xy> midpoints;
+  ChunkVector<double> clothances,curvatures;
   bool curvy;
 public:
   friend class polyarc;
@@ -328,7 +328,7 @@ void PostScript::line(edge lin,int num,int colorwhat,bool directed)
   b=turn(b,orientation);
   if (lin.delaunay())
     if (colorwhat==1)
-      switch (fibmod3(abs(pl->revpoints[lin.a]-pl->revpoints[lin.b])))
+      switch (fibmod3(abs(lin.a->num-lin.b->num)))
       {
 	case -1:
 	  setcolor(0.3,0.3,0.3);
@@ -115,6 +115,58 @@ triangle *qindex::findt(xy pnt,bool clip)
     return sub[i]->findt(pnt,clip);
 }
 
+Locator::Locator(qindex &q)
+{
+  qinx=&q;
+  last=nullptr;
+  queries=steps=jumps=0;
+}
+
+triangle *Locator::findt(xy pnt,bool clip)
+/* If the walk leaves the TIN, the point is outside the convex hull, and
+ * the answer is the same as the qindex would give, except that with clip
+ * it's the last triangle the walk was in rather than the one the qindex
+ * would walk to.
+ */
+{
+  triangle *here,*there;
+  int i;
+  queries++;
+  if (pnt.isnan())
+    return nullptr;
+  if (last)
+  {
+    for (here=there=last,i=0;here && i<LOCATOR_WALK;i++)
+    {
+      if (here->in(pnt))
+	return last=here;
+      here=here->nexttoward(pnt);
+      if (here)
+	there=here;
+      steps++;
+    }
+    if (!here)
+    {
+      last=there;
+      return clip?there:nullptr;
+    }
+  }
+  jumps++;
+  here=qinx->findt(pnt,clip);
+  if (here)
+    last=here;
+  return here;
+}
+
+double Locator::elevation(xy pnt)
+{
+  triangle *t=findt(pnt);
+  if (t)
+    return t->elevation(pnt);
+  else
+    return nan("");
+}
+
 point *qindex::findp(xy pont,bool clip)
 {
   int i;
@@ -333,6 +385,24 @@ void qindex::settri(triangle *starttri)
   }
 }
 
+void qindex::replaceTri(const vector<array<triangle *,2> > &moves)
+/* Each leaf pointing to moves[i][0] is made to point to moves[i][1], in
+ * order. Used when editing the TIN moves triangles or deletes them, so that
+ * no leaf is left pointing to where there is no triangle. Any triangle will
+ * do to start the walk, so the leaves are not set to the triangles containing
+ * their centers, as settri does.
+ */
+{
+  int i;
+  if (sub[3])
+    for (i=0;i<4;i++)
+      sub[i]->replaceTri(moves);
+  else
+    for (i=0;i<moves.size();i++)
+      if (tri==moves[i][0])
+        tri=moves[i][1];
+}
+
 set<triangle *> qindex::localTriangles(xy center,double radius,int max)
 /* Returns up to max pointers to triangles, the leaves of the tree whose centers
  * are within radius of center. If there are more than max in the circle, returns
@@ -373,3 +443,26 @@ set<triangle *> qindex::localTriangles(xy center,double radius,int max)
     list.insert(tri);
   return list;
 }
+
+bool qindex::localTriangles(xy center,double radius,int max,vector<triangle *> &list,unsigned int epoch)
+/* Same as above, but appends the triangles to list, using their localMark
+ * instead of a set to skip those already in it, and returns false if
+ * there are more than max. Allocates nothing once list has room.
+ */
+{
+  int i;
+  bool ret=max>=0;
+  if (sub[3])
+  {
+    if (dist(middle(),center)<=radius+side/M_SQRT2)
+      for (i=0;ret && i<4;i++)
+        ret=sub[i]->localTriangles(center,radius,max,list,epoch);
+  }
+  else if (tri && tri->localMark!=epoch && dist(middle(),center)<=radius)
+  {
+    tri->localMark=epoch;
+    list.push_back(tri);
+    ret=list.size()<=max;
+  }
+  return ret;
+}
@@ -26,6 +26,7 @@
 #ifndef QINDEX_H
 #define QINDEX_H
 #include <vector>
+#include <array>
 #include <set>
 #include "pointlist.h"
 #include "bezier.h"
@@ -60,9 +61,31 @@ public:
   void draw(PostScript &ps,bool root=true);
   std::vector<qindex*> traverse(int dir=0);
   void settri(triangle *starttri);
+  void replaceTri(const std::vector<std::array<triangle *,2> > &moves);
   std::set<triangle *> localTriangles(xy center,double radius,int max);
+  bool localTriangles(xy center,double radius,int max,std::vector<triangle *> &list,unsigned int epoch);
   qindex();
   ~qindex();
   int size(); // This returns the total number of nodes, which is 4n+1. The number of leaves is 3n+1.
 };
+
+#define LOCATOR_WALK 8
+
+class Locator
+/* Finds the triangle a point is in by walking from the last triangle found,
+ * which for a run of nearby points is one or two steps. If the walk takes
+ * more than LOCATOR_WALK steps, it jumps through the qindex instead.
+ * A Locator is not shared between threads; make one in each thread.
+ * The TIN must not change while a Locator is in use.
+ */
+{
+public:
+  Locator(qindex &q);
+  triangle *findt(xy pnt,bool clip=false);
+  double elevation(xy pnt);
+  long long queries,steps,jumps;
+private:
+  qindex *qinx;
+  triangle *last;
+};
 #endif
@@ -27,6 +27,7 @@
 #include <cmath>
 #include <stdexcept>
 #include "raster.h"
+#include "qindex.h"
 
 using namespace std;
 fstream rfile;
@@ -119,6 +120,7 @@ void rasterdraw(pointlist &pts,xy center,double width,double height,
   int pwidth,pheight;
   xy pnt;
   double z;
+  Locator loc(pts.qinx);
   //hvec bend,dir,center,lastcenter,jump;
   char letter;
   ropen(filename);
@@ -133,7 +135,7 @@ void rasterdraw(pointlist &pts,xy center,double width,double height,
     for (j=0;j<pwidth;j++)
     {
       pnt=xy(j-pwidth/2.,pheight/2.-i);
-      z=pts.elevation(center+pnt/scale);
+      z=loc.elevation(center+pnt/scale);
       pixel=color(z/zscale);
       rfile<<pixel;
     }
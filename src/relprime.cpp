@@ -22,12 +22,14 @@
  * <http://www.gnu.org/licenses/>.
  */
 #include <map>
+#include <mutex>
 #include <cmath>
 #include "relprime.h"
 
 using namespace std;
 
 map<unsigned,unsigned> relprimes;
+mutex relprimeMutex; // contours are smoothed in several threads
 
 unsigned gcd(unsigned a,unsigned b)
 {
@@ -49,6 +51,7 @@ unsigned relprime(unsigned n)
 {
   unsigned ret,twice;
   double phin;
+  lock_guard<mutex> lock(relprimeMutex);
   ret=relprimes[n];
   if (!ret)
   {
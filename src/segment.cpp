@@ -132,7 +132,7 @@ double segment::elev(double along) const
   return vcurve(start.elev(),control1,control2,end.elev(),along/length());
 }
 
-double segment::slope(double along)
+double segment::slope(double along) const
 {
   return vslope(start.elev(),control1,control2,end.elev(),along/length())/length();
 }
@@ -166,7 +166,7 @@ xyz segment::station(double along) const
 	     elev(along));
 }
 
-double segment::contourcept(double e)
+double segment::contourcept(double e) const
 /* Finds ret such that elev(ret)=e. Used for tracing a contour from one subedge
  * to the next within a triangle.
  * 
@@ -48,11 +48,11 @@ public:
   segment();
   segment(xyz kra,xyz fam);
   segment(xyz kra,double c1,double c2,xyz fam);
-  xyz getstart()
+  xyz getstart() const
   {
     return start;
   }
-  xyz getend()
+  xyz getend() const
   {
     return end;
   }
@@ -71,14 +71,14 @@ public:
   {
   }
   double elev(double along) const;
-  double slope(double along);
+  double slope(double along) const;
   double accel(double along);
   double jerk();
   double startslope();
   double endslope();
-  double contourcept(double e);
+  double contourcept(double e) const;
   double contourcept_br(double e);
-  bool crosses(double e)
+  bool crosses(double e) const
   {
     return (end.elev()<e)^(start.elev()<e);
   }
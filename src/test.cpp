@@ -32,7 +32,7 @@ using std::map;
 
 void dumppoints()
 {
-  map<int,point>::iterator i;
+  ptlist::iterator i;
   printf("dumppoints\n");
   //for (i=doc.pl[1].points.begin();i!=doc.pl[1].points.end();i++)
   //    i->second.dump();
@@ -41,10 +41,10 @@ void dumppoints()
 
 void dumppointsvalence(document &doc)
 {
-  map<int,point>::iterator i;
+  ptlist::iterator i;
   printf("dumppoints\n");
   for (i=doc.pl[1].points.begin();i!=doc.pl[1].points.end();i++)
-    printf("%d %d\n",i->first,i->second.valence());
+    printf("%d %d\n",i->num,i->valence());
   printf("end dump\n");
 }
 
@@ -156,6 +156,22 @@ void aster(document &doc,int n)
       }
  }
 
+void scrambledAster(document &doc,int n)
+/* Same as aster, but the points are numbered in an order that has
+ * nothing to do with where they are, as in field data. n should not be
+ * a multiple of 7919.
+ */
+{
+  int i;
+  double angle=(sqrt(5)-1)*M_PI;
+  xy pnt;
+  for (i=0;i<n;i++)
+  {
+    pnt=xy(cos(angle*i)*sqrt(i+0.5),sin(angle*i)*sqrt(i+0.5));
+    doc.pl[1].addpoint((long long)i*7919%n+1,point(pnt,testsurface(pnt),"test"));
+  }
+}
+
 void _ellipse(document &doc,int n,double skewness)
 /* Skewness is not eccentricity. When skewness=0.01, eccentricity=0.14072. */
 {
@@ -244,13 +260,13 @@ void wheelwindow(document &doc,int n)
 void rotate(document &doc,int n)
 {int i;
  double tmpx,tmpy;
- map<int,point>::iterator j;
+ ptlist::iterator j;
  for (j=doc.pl[1].points.begin();j!=doc.pl[1].points.end();j++)
      for (i=0;i<n;i++)
-         {tmpx=j->second.x*0.6-j->second.y*0.8;
-          tmpy=j->second.y*0.6+j->second.x*0.8;
-          j->second.x=tmpx;
-          j->second.y=tmpy;
+         {tmpx=j->x*0.6-j->y*0.8;
+          tmpy=j->y*0.6+j->x*0.8;
+          j->x=tmpx;
+          j->y=tmpy;
           }
  }
 
@@ -258,28 +274,28 @@ void movesideways(document &doc,double sw)
 {
   int i;
   double tmpx,tmpy;
-  map<int,point>::iterator j;
+  ptlist::iterator j;
   for (j=doc.pl[1].points.begin();j!=doc.pl[1].points.end();j++)
-    j->second.x+=sw;
+    j->x+=sw;
 }
 
 void moveup(document &doc,double sw)
 {
   int i;
   double tmpx,tmpy;
-  map<int,point>::iterator j;
+  ptlist::iterator j;
   for (j=doc.pl[1].points.begin();j!=doc.pl[1].points.end();j++)
-    j->second.z+=sw;
+    j->z+=sw;
 }
 
 void enlarge(document &doc,double sc)
 {
   int i;
   double tmpx,tmpy;
-  map<int,point>::iterator j;
+  ptlist::iterator j;
   for (j=doc.pl[1].points.begin();j!=doc.pl[1].points.end();j++)
   {
-    j->second.x*=sc;
-    j->second.y*=sc;
+    j->x*=sc;
+    j->y*=sc;
   }
 }
@@ -57,6 +57,7 @@ void setsurface(int surf);
 void dumppoints();
 void dumppointsvalence(document &doc);
 void aster(document &doc,int n);
+void scrambledAster(document &doc,int n);
 void ring(document &doc,int n);
 void regpolygon(document &doc,int n);
 void ellipse(document &doc,int n);
@@ -68,4 +69,5 @@ void rotate(document &doc,int n);
 void movesideways(document &doc,double sw);
 void moveup(document &doc,double sw);
 void enlarge(document &doc,double sc);
+extern double (*testsurface)(xy pnt);
 extern xy (*testsurfacegrad)(xy pnt);
@@ -0,0 +1,96 @@
+/******************************************************/
+/*                                                    */
+/* threads.cpp - worker threads                       */
+/*                                                    */
+/******************************************************/
+/* Copyright 2026 Pierre Abbat.
+ * This file is part of Bezitopo.
+ *
+ * Bezitopo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Bezitopo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License and Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * and Lesser General Public License along with Bezitopo. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <thread>
+#include <vector>
+#include <exception>
+#include <atomic>
+#include "threads.h"
+
+using namespace std;
+
+int nThreads=0;
+
+int threadCount()
+{
+  int n=nThreads;
+  if (n<=0)
+    n=thread::hardware_concurrency();
+  if (n<=0)
+    n=1;
+  return n;
+}
+
+void setThreadCount(int n)
+{
+  nThreads=n;
+}
+
+void parallelFor(int n,function<void(int,int,int)> body)
+/* If body throws in any thread, the exception is rethrown in the calling
+ * thread after all threads have finished.
+ */
+{
+  int i,nth=threadCount();
+  vector<thread> threads;
+  vector<exception_ptr> excepts;
+  if (nth>n)
+    nth=n;
+  if (nth<=1)
+  {
+    if (n>0)
+      body(0,n,0);
+    return;
+  }
+  excepts.resize(nth);
+  auto work=[&](int th)
+  {
+    try
+    {
+      body((int)((long long)n*th/nth),(int)((long long)n*(th+1)/nth),th);
+    }
+    catch (...)
+    {
+      excepts[th]=current_exception();
+    }
+  };
+  for (i=1;i<nth;i++)
+    threads.push_back(thread(work,i));
+  work(0);
+  for (i=0;i<threads.size();i++)
+    threads[i].join();
+  for (i=0;i<nth;i++)
+    if (excepts[i])
+      rethrow_exception(excepts[i]);
+}
+
+void parallelQueue(int n,function<void(int,int)> body)
+{
+  atomic<int> next(0);
+  parallelFor(threadCount(),[&](int begin,int end,int thread)
+  {
+    int i;
+    while ((i=next++)<n)
+      body(i,thread);
+  });
+}
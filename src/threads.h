@@ -0,0 +1,44 @@
+/******************************************************/
+/*                                                    */
+/* threads.h - worker threads                         */
+/*                                                    */
+/******************************************************/
+/* Copyright 2026 Pierre Abbat.
+ * This file is part of Bezitopo.
+ *
+ * Bezitopo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Bezitopo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License and Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * and Lesser General Public License along with Bezitopo. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef THREADS_H
+#define THREADS_H
+#include <functional>
+
+/* Splits the numbers 0 through n-1 into contiguous blocks, one per thread,
+ * and calls body(begin,end,thread) on each block in its own thread. Returns
+ * when all threads have finished. The blocks depend only on n and the number
+ * of threads, so a body that writes only to its own block's slots gives the
+ * same result as running serially.
+ */
+void parallelFor(int n,std::function<void(int,int,int)> body);
+/* Calls body(i,thread) for each i from 0 through n-1, handing the numbers
+ * out in order to whichever thread is free, for work whose pieces differ
+ * much in size. Put the biggest pieces first.
+ */
+void parallelQueue(int n,std::function<void(int,int)> body);
+int threadCount();
+void setThreadCount(int n);
+// 0 means one thread per processor.
+#endif
@@ -0,0 +1,368 @@
+/******************************************************/
+/*                                                    */
+/* tiledtin.cpp - TINs of huge point clouds           */
+/*                                                    */
+/******************************************************/
+/* Copyright 2026 Pierre Abbat.
+ * This file is part of Bezitopo.
+ *
+ * Bezitopo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Bezitopo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License and Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * and Lesser General Public License along with Bezitopo. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <set>
+#include "binio.h"
+#include "cogo.h"
+#include "except.h"
+#include "pointlist.h"
+#include "dxf.h"
+#include "tiledtin.h"
+using namespace std;
+
+TinTile::TinTile()
+{
+  count=0;
+  lo=xy(INFINITY,INFINITY);
+  hi=xy(-INFINITY,-INFINITY);
+}
+
+TiledTin::TiledTin(string scratchDir,double tileSide)
+{
+  dir=scratchDir;
+  side=tileSide;
+  npoints=nbuffered=0;
+  maxLoaded=retries=0;
+}
+
+TiledTin::~TiledTin()
+{
+  map<array<int,2>,TinTile>::iterator i;
+  for (i=tiles.begin();i!=tiles.end();++i)
+    remove(tileFileName(i->first).c_str());
+}
+
+array<int,2> TiledTin::tileOf(xy pnt)
+{
+  array<int,2> ret;
+  ret[0]=floor(pnt.east()/side);
+  ret[1]=floor(pnt.north()/side);
+  return ret;
+}
+
+string TiledTin::tileFileName(array<int,2> key)
+{
+  return dir+"/tintile_"+to_string(key[0])+"_"+to_string(key[1])+".bin";
+}
+
+void TiledTin::flush(array<int,2> key)
+{
+  int i;
+  TinTile &tile=tiles[key];
+  if (tile.buffer.size())
+  {
+    ofstream file(tileFileName(key),ios::binary|ios::app);
+    for (i=0;i<tile.buffer.size();i++)
+    {
+      writeledouble(file,tile.buffer[i].getx());
+      writeledouble(file,tile.buffer[i].gety());
+      writeledouble(file,tile.buffer[i].getz());
+    }
+    nbuffered-=tile.buffer.size();
+    tile.buffer.clear();
+    tile.buffer.shrink_to_fit();
+  }
+}
+
+void TiledTin::flushAll()
+{
+  map<array<int,2>,TinTile>::iterator i;
+  for (i=tiles.begin();i!=tiles.end();++i)
+    flush(i->first);
+}
+
+void TiledTin::addPoint(xyz pnt)
+/* Puts the point in its tile. Each tile's points are held in a small buffer
+ * until there are enough to be worth writing to its file, or until there
+ * are too many points in all the buffers.
+ */
+{
+  array<int,2> key=tileOf(pnt);
+  TinTile &tile=tiles[key];
+  if (tile.count==0)
+    remove(tileFileName(key).c_str()); // left over from a crashed run
+  tile.count++;
+  tile.lo=xy(fmin(tile.lo.east(),pnt.east()),fmin(tile.lo.north(),pnt.north()));
+  tile.hi=xy(fmax(tile.hi.east(),pnt.east()),fmax(tile.hi.north(),pnt.north()));
+  tile.buffer.push_back(pnt);
+  npoints++;
+  nbuffered++;
+  if (tile.buffer.size()>=TILE_BUFFER)
+    flush(key);
+  if (nbuffered>=TILE_BUFFER*64)
+    flushAll();
+}
+
+void TiledTin::finishPoints()
+{
+  flushAll();
+}
+
+size_t TiledTin::size()
+{
+  return npoints;
+}
+
+size_t TiledTin::ntiles()
+{
+  return tiles.size();
+}
+
+void TiledTin::loadTile(array<int,2> key,vector<xyz> &pnts)
+{
+  int i;
+  double x,y,z;
+  ifstream file(tileFileName(key),ios::binary);
+  for (i=0;i<tiles[key].count;i++)
+  {
+    x=readledouble(file);
+    y=readledouble(file);
+    z=readledouble(file);
+    pnts.push_back(xyz(x,y,z));
+  }
+}
+
+bool TiledTin::reaches(array<int,2> key,xy center,double radius)
+/* Returns true if the bounding rectangle of the tile's points reaches into
+ * the circle. A point on the circle counts as in it, so that the tile gets
+ * loaded and the cocircular points are triangulated together.
+ */
+{
+  TinTile &tile=tiles[key];
+  double dx,dy;
+  dx=fmax(fmax(tile.lo.east()-center.east(),center.east()-tile.hi.east()),0);
+  dy=fmax(fmax(tile.lo.north()-center.north(),center.north()-tile.hi.north()),0);
+  return dx*dx+dy*dy<=radius*radius*(1+1e-9);
+}
+
+bool TiledTin::reaches(array<int,2> key,xy a,xy b)
+/* Returns true if any corner of the bounding rectangle of the tile's points
+ * is strictly right of the line from a to b. A point on the line beyond
+ * a or b doesn't change the hull edge ab.
+ */
+{
+  TinTile &tile=tiles[key];
+  return area3(a,b,tile.lo)<0 || area3(a,b,tile.hi)<0 ||
+         area3(a,b,xy(tile.lo.east(),tile.hi.north()))<0 ||
+         area3(a,b,xy(tile.hi.east(),tile.lo.north()))<0;
+}
+
+xy circumcenter(xy a,xy b,xy c)
+{
+  double d,bb,cc;
+  b-=a;
+  c-=a;
+  d=2*(b.east()*c.north()-b.north()*c.east());
+  bb=sqr(b.length());
+  cc=sqr(c.length());
+  return a+xy(c.north()*bb-b.north()*cc,b.east()*cc-c.east()*bb)/d;
+}
+
+bool lowerCorner(xy a,xy b)
+{
+  return a.east()<b.east() || (a.east()==b.east() && a.north()<b.north());
+}
+
+void writeGroups(ostream &file,vector<GroupCode> &codes,bool asc)
+// Writes more groups to a file already begun with writeDxfGroups.
+{
+  int i;
+  for (i=0;i<codes.size();i++)
+    if (asc)
+      writeDxfText(file,codes[i]);
+    else
+      writeDxfBinary(file,codes[i]);
+}
+
+int TiledTin::triangulate(ostream &dxfFile,bool asc,double outUnit)
+/* Writes the Delaunay TIN of all the points as 3DFACEs, one tile at a time.
+ * Each triangle is written by the tile holding its lowest corner (least x,
+ * then least y).
+ *
+ * A tile is triangulated with the tiles around it. If a triangle at one of
+ * its points has a circumcircle that reaches a tile not loaded, or a hull
+ * edge at one of its points has a tile not loaded on the outside, the
+ * triangle or edge may not be in the TIN of the whole cloud, so those tiles
+ * are loaded too and the tile is done over. When none is left, the star of
+ * each of the tile's points is the same as in the TIN of the whole cloud.
+ * This needs no stitching: the triangles along a seam are written by one
+ * tile, and the other tile finds the same triangles and leaves them alone.
+ *
+ * If four points are cocircular, the two tiles may split the quadrilateral
+ * differently. Returns the number of triangles written. If a tile and the
+ * tiles around it have two points in the same place, or all their points
+ * in a line, throws at once.
+ */
+{
+  vector<GroupCode> dxfCodes;
+  vector<DxfLayer> dxfLayers;
+  DxfLayer layer;
+  map<array<int,2>,TinTile>::iterator i;
+  set<array<int,2> > loaded,need;
+  set<array<int,2> >::iterator j;
+  array<int,2> key,lokey,hikey,minkey,maxkey;
+  vector<xyz> pnts;
+  vector<char> owned;
+  vector<point *> corners;
+  int m,n,ring,ntri=0;
+  int x,y;
+  bool done;
+  xy center;
+  double radius;
+  edge *e;
+  triangle *tri;
+  flushAll();
+  minkey=maxkey={0,0};
+  if (tiles.size())
+    minkey=maxkey=tiles.begin()->first;
+  for (i=tiles.begin();i!=tiles.end();++i)
+    for (m=0;m<2;m++)
+    {
+      minkey[m]=min(minkey[m],i->first[m]);
+      maxkey[m]=max(maxkey[m],i->first[m]);
+    }
+  layer.name="TIN";
+  layer.number=1;
+  layer.color=1;
+  dxfLayers.push_back(layer);
+  tableSection(dxfCodes,dxfLayers);
+  openEntitySection(dxfCodes);
+  writeDxfGroups(dxfFile,dxfCodes,asc);
+  for (i=tiles.begin();i!=tiles.end();++i)
+  {
+    loaded.clear();
+    for (ring=1,done=false;!done;)
+    {
+      if (loaded.size()==0)
+        for (x=i->first[0]-ring;x<=i->first[0]+ring;x++)
+          for (y=i->first[1]-ring;y<=i->first[1]+ring;y++)
+            if (tiles.count(key={x,y}))
+              loaded.insert(key);
+      pointlist pl;
+      owned.clear();
+      owned.push_back(false);
+      for (j=loaded.begin();j!=loaded.end();++j)
+      {
+        pnts.clear();
+        loadTile(*j,pnts);
+        for (m=0;m<pnts.size();m++)
+        {
+          pl.addpoint(owned.size(),point(pnts[m],""));
+          owned.push_back(*j==i->first);
+        }
+      }
+      if (pl.points.size()>maxLoaded)
+        maxLoaded=pl.points.size();
+      try
+      {
+        pl.maketin();
+        pl.maketriangles();
+      }
+      catch (BeziExcept &ex)
+      { /* Too few points to make a triangle can be fixed by loading more
+         * tiles around this one. Two points in the same place or all the
+         * points in a line are given up on at once, rather than loading
+         * ring after ring of tiles until the whole cloud is in memory.
+         */
+        if (ex.getNumber()!=notri || loaded.size()==tiles.size())
+          throw;
+        loaded.clear();
+        ring++;
+        retries++;
+        continue;
+      }
+      need.clear();
+      for (m=0;m<pl.triangles.size();m++)
+      {
+        tri=&pl.triangles[m];
+        if (owned[tri->a->num] || owned[tri->b->num] || owned[tri->c->num])
+        {
+          center=circumcenter(*tri->a,*tri->b,*tri->c);
+          radius=dist(center,*tri->a);
+          lokey=tileOf(center-xy(radius,radius));
+          hikey=tileOf(center+xy(radius,radius));
+          for (n=0;n<2;n++)
+          {
+            lokey[n]=max(lokey[n],minkey[n]);
+            hikey[n]=min(hikey[n],maxkey[n]);
+          }
+          if ((double)(hikey[0]-lokey[0]+1)*(hikey[1]-lokey[1]+1)<=tiles.size())
+          {
+            for (x=lokey[0];x<=hikey[0];x++)
+              for (y=lokey[1];y<=hikey[1];y++)
+                if (tiles.count(key={x,y}) && !loaded.count(key) && reaches(key,center,radius))
+                  need.insert(key);
+          }
+          else
+            for (auto k=tiles.begin();k!=tiles.end();++k)
+              if (!loaded.count(k->first) && reaches(k->first,center,radius))
+                need.insert(k->first);
+        }
+      }
+      for (m=0;m<pl.edges.size();m++)
+      {
+        e=&pl.edges[m];
+        if ((e->tria==nullptr)!=(e->trib==nullptr) && (owned[e->a->num] || owned[e->b->num]))
+          for (auto k=tiles.begin();k!=tiles.end();++k)
+            if (!loaded.count(k->first))
+            {
+              if (e->tria==nullptr && reaches(k->first,*e->a,*e->b))
+                need.insert(k->first);
+              if (e->trib==nullptr && reaches(k->first,*e->b,*e->a))
+                need.insert(k->first);
+            }
+      }
+      if (need.size())
+      {
+        loaded.insert(need.begin(),need.end());
+        retries++;
+        continue;
+      }
+      done=true;
+      dxfCodes.clear();
+      for (m=0;m<pl.triangles.size();m++)
+      {
+        tri=&pl.triangles[m];
+        corners={tri->a,tri->b,tri->c};
+        for (n=1;n<3;n++)
+          if (lowerCorner(*corners[n],*corners[0]))
+            swap(corners[0],corners[n]);
+        if (owned[corners[0]->num])
+        {
+          insertTriangle(dxfCodes,*tri,outUnit);
+          ntri++;
+        }
+      }
+      writeGroups(dxfFile,dxfCodes,asc);
+    }
+  }
+  dxfCodes.clear();
+  closeEntitySection(dxfCodes);
+  dxfEnd(dxfCodes);
+  writeGroups(dxfFile,dxfCodes,asc);
+  return ntri;
+}
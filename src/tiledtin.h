@@ -0,0 +1,78 @@
+/******************************************************/
+/*                                                    */
+/* tiledtin.h - TINs of huge point clouds             */
+/*                                                    */
+/******************************************************/
+/* Copyright 2026 Pierre Abbat.
+ * This file is part of Bezitopo.
+ *
+ * Bezitopo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Bezitopo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License and Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * and Lesser General Public License along with Bezitopo. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILEDTIN_H
+#define TILEDTIN_H
+#include <string>
+#include <vector>
+#include <map>
+#include <array>
+#include <iostream>
+#include "xyz.h"
+
+/* A TiledTin makes the Delaunay TIN of a point cloud that doesn't fit in
+ * memory. The points are sorted into square tiles, which are kept in files
+ * in a scratch directory. Each tile is then triangulated together with as
+ * many of the tiles around it as it takes to be sure that the triangles
+ * around its points are the same as in the TIN of the whole cloud, and
+ * those triangles are written out before going on to the next tile.
+ * At most a few tiles' worth of points are in memory at once.
+ */
+
+#define TILE_BUFFER 1024
+
+struct TinTile
+{
+  int count;
+  xy lo,hi; // bounding rectangle of the points in the tile
+  std::vector<xyz> buffer; // points not yet written to the tile's file
+  TinTile();
+};
+
+class TiledTin
+{
+public:
+  TiledTin(std::string scratchDir,double tileSide);
+  ~TiledTin();
+  void addPoint(xyz pnt);
+  void finishPoints();
+  int triangulate(std::ostream &dxfFile,bool asc,double outUnit=1);
+  size_t size();
+  size_t ntiles();
+  int maxLoaded; // most points in memory at once while triangulating
+  int retries; // times a tile had to be done over with more tiles around it
+private:
+  std::string dir;
+  double side;
+  size_t npoints,nbuffered;
+  std::map<std::array<int,2>,TinTile> tiles;
+  std::array<int,2> tileOf(xy pnt);
+  std::string tileFileName(std::array<int,2> key);
+  void flush(std::array<int,2> key);
+  void flushAll();
+  void loadTile(std::array<int,2> key,std::vector<xyz> &pnts);
+  bool reaches(std::array<int,2> key,xy center,double radius);
+  bool reaches(std::array<int,2> key,xy a,xy b);
+};
+#endif
@@ -23,6 +23,10 @@
  */
 
 #include <map>
+#include <unordered_set>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <iostream>
 #include "globals.h"
@@ -37,6 +41,7 @@
 #include "smooth5.h"
 #include "relprime.h"
 #include "stl.h"
+#include "threads.h"
 
 #define THR 16777216
 //threshold for goodcenter to determine if a point is sufficiently
@@ -55,6 +60,7 @@ edge::edge()
   extrema[0]=extrema[1]=NAN;
   broken=contour=stlsplit=0;
   flipcnt=0;
+  localMark=0;
 }
 
 edge* edge::next(point* end)
@@ -129,7 +135,7 @@ xy edge::midpoint()
 }
 
 void edge::dump(pointlist *topopoints)
-{printf("addr=%p a=%d b=%d nexta=%p nextb=%p\n",static_cast<void*>(this),topopoints->revpoints[a],topopoints->revpoints[b],static_cast<void*>(nexta),static_cast<void*>(nextb));
+{printf("addr=%p a=%d b=%d nexta=%p nextb=%p\n",static_cast<void*>(this),a->num,b->num,static_cast<void*>(nexta),static_cast<void*>(nextb));
  }
 
 void edge::flip(pointlist *topopoints)
@@ -284,31 +290,30 @@ void dumphull()
 
 void pointlist::dumpedges()
 {
-  map<int,edge>::iterator i;
+  int i;
   printf("dump edges:\n");
-  for (i=edges.begin();i!=edges.end();i++)
-     i->second.dump(this);
+  for (i=0;i<edges.size();i++)
+     edges[i].dump(this);
   printf("end dump\n");
 }
 
 void pointlist::dumpedges_ps(PostScript &ps,bool colorfibaster)
 {
-  map<int,edge>::iterator i;
   int n;
-  for (i=edges.begin(),n=0;i!=edges.end();i++,n++)
-     ps.line(i->second,n,colorfibaster);
+  for (n=0;n<edges.size();n++)
+     ps.line(edges[n],n,colorfibaster);
 }
 
 void pointlist::dumpnext_ps(PostScript &ps)
 {
-  map<int,edge>::iterator i;
+  int i;
   ps.setcolor(0,0.7,0);
-  for (i=edges.begin();i!=edges.end();i++)
+  for (i=0;i<edges.size();i++)
   {
-    if (i->second.nexta)
-      ps.line2p(i->second.midpoint(),i->second.nexta->midpoint());
-    if (i->second.nextb)
-      ps.line2p(i->second.midpoint(),i->second.nextb->midpoint());
+    if (edges[i].nexta)
+      ps.line2p(edges[i].midpoint(),edges[i].nexta->midpoint());
+    if (edges[i].nextb)
+      ps.line2p(edges[i].midpoint(),edges[i].nextb->midpoint());
   }
 }
 
@@ -335,14 +340,14 @@ void dumphull_ps(PostScript &ps)
 
 void pointlist::dumptriangles()
 {
-  map<int,triangle>::iterator i;
-  for (i=triangles.begin();i!=triangles.end();i++)
+  int i;
+  for (i=0;i<triangles.size();i++)
   {
-    cout<<i->first<<": ";
-    cout<<revpoints[i->second.a]<<' ';
-    cout<<revpoints[i->second.b]<<' ';
-    cout<<revpoints[i->second.c]<<' ';
-    cout<<i->second.sarea<<endl;
+    cout<<i<<": ";
+    cout<<triangles[i].a->num<<' ';
+    cout<<triangles[i].b->num<<' ';
+    cout<<triangles[i].c->num<<' ';
+    cout<<triangles[i].sarea<<endl;
   }
 }
 
@@ -360,6 +365,7 @@ void pointlist::splitBreaklines()
         throw BeziExcept(badBreaklineEnd);
       break0.push_back(segment(points[bl[0]],points[bl[1]]));
     }
+  break0Grid.build(break0);
 }
 
 double edge::length()
@@ -406,6 +412,26 @@ array<double,4> edge::ctrlpts()
   return ret;
 }
 
+array<double,2> edge::elevRange()
+/* Returns the lowest and highest elevation along the edge. findextrema must
+ * have been called.
+ */
+{
+  int i;
+  double e;
+  array<double,2> ret;
+  ret[0]=min(a->z,b->z);
+  ret[1]=max(a->z,b->z);
+  for (i=0;i<2;i++)
+    if (std::isfinite(extrema[i]))
+    {
+      e=critpoint(i).elev();
+      ret[0]=min(ret[0],e);
+      ret[1]=max(ret[1],e);
+    }
+  return ret;
+}
+
 void edge::findextrema()
 {
   int i;
@@ -492,18 +518,23 @@ bool goodcenter(xy a,xy b,xy c,xy d)
 }
 
 int pointlist::checkBreak0(edge &e)
+/* Only the breakline segments near the edge, according to break0Grid,
+ * can cross or coincide with it, so only they are checked.
+ */
 {
   int i;
   segment s;
+  vector<int> nearby;
   if ((e.broken&4)==0)
   {
     e.broken&=-4;
     s=e.getsegment();
-    for (i=0;i<break0.size();i++)
+    nearby=break0Grid.near(*e.a,*e.b);
+    for (i=0;i<nearby.size();i++)
     {
-      if (intersection_type(s,break0[i])==ACXBD)
+      if (intersection_type(s,break0[nearby[i]])==ACXBD)
         e.broken|=2;
-      if (sameXyz(s,break0[i]))
+      if (sameXyz(s,break0[nearby[i]]))
         e.broken|=1;
     }
     e.broken|=4;
@@ -554,7 +585,7 @@ bool pointlist::tryStartPoint(PostScript &ps,xy &startpnt)
   {
     outward.clear();
     for (i=points.begin();i!=points.end();i++)
-      outward.insert(ipoint(dist(startpnt,i->second),&i->second));
+      outward.insert(ipoint(dist(startpnt,*i),&*i));
     for (j=outward.begin(),n=0;j!=outward.end();j++,n++)
     {
       if (n==0)
@@ -580,14 +611,14 @@ bool pointlist::tryStartPoint(PostScript &ps,xy &startpnt)
   minx=maxx=startpnt.east();
   for (i=points.begin();i!=points.end();i++)
   {
-    if (i->second.east()>maxx)
-      maxx=i->second.east();
-    if (i->second.east()<minx)
-      minx=i->second.east();
-    if (i->second.north()>maxy)
-      maxy=i->second.north();
-    if (i->second.north()<miny)
-      miny=i->second.north();
+    if (i->east()>maxx)
+      maxx=i->east();
+    if (i->east()<minx)
+      minx=i->east();
+    if (i->north()>maxy)
+      maxy=i->north();
+    if (i->north()<miny)
+      miny=i->north();
   }
   if (ps.isOpen())
   {
@@ -597,7 +628,7 @@ bool pointlist::tryStartPoint(PostScript &ps,xy &startpnt)
     ps.dot(startpnt);
     ps.setcolor(1,.5,0);
     for (i=points.begin();i!=points.end();i++)
-      ps.dot(i->second,to_string(revpoints[&i->second]));
+      ps.dot(*i,to_string(i->num));
     ps.endpage();
   }
   j=outward.begin();
@@ -753,15 +784,15 @@ int1loop pointlist::convexHull()
   convexhull.clear();
   for (i=points.begin();i!=points.end();i++)
   {
-    xsum.push_back(i->second.east());
-    ysum.push_back(i->second.north());
+    xsum.push_back(i->east());
+    ysum.push_back(i->north());
   }
   startpnt=xy(pairwisesum(xsum)/xsum.size(),pairwisesum(ysum)/ysum.size());
   for (m=0;m<100;m++)
   {
     outward.clear();
     for (i=points.begin();i!=points.end();i++)
-      outward.insert(ipoint(dist(startpnt,i->second),&i->second));
+      outward.insert(ipoint(dist(startpnt,*i),&*i));
     for (j=outward.begin(),n=0;j!=outward.end();j++,n++)
     {
       if (n==0)
@@ -882,7 +913,7 @@ int1loop pointlist::convexHull()
       convexhull.erase(dir(startpnt,*visible[m]));
   }
   for (j=convexhull.begin();j!=convexhull.end();j++)
-    ret.push_back(revpoints[j->second]);
+    ret.push_back(j->second->num);
   return ret;
 }
 
@@ -924,10 +955,170 @@ int pointlist::flipPass(PostScript &ps,bool colorfibaster)
   return m;
 }
 
-void pointlist::maketin(string filename,bool colorfibaster)
+unsigned long long hilbertKey(xy pnt,xy corner,double side)
+/* Returns the distance along a Hilbert curve of pnt in the square with
+ * lower left corner corner and side side, divided into 2^20×2^20 cells.
+ */
+{
+  const unsigned int n=1<<20;
+  unsigned int x,y,s,rx,ry,flip;
+  unsigned long long d=0;
+  x=min(max((pnt.getx()-corner.getx())/side*n,0.),n-1.);
+  y=min(max((pnt.gety()-corner.gety())/side*n,0.),n-1.);
+  for (s=n/2;s>0;s/=2)
+  {
+    rx=(x&s)>0;
+    ry=(y&s)>0;
+    d+=(unsigned long long)s*s*((3*rx)^ry);
+    /* If ry is 0, reflect if rx is 1, then swap x and y. This is done
+     * without branches, which are taken at random.
+     */
+    flip=(n-1)&-(rx&(ry^1));
+    x^=flip;
+    y^=flip;
+    flip=(x^y)&-(ry^1);
+    x^=flip;
+    y^=flip;
+  }
+  return d;
+}
+
+vector<int> hilbertSort(const vector<xy> &pnts)
+/* Returns the indices of pnts in order along a Hilbert curve
+ * through their bounding square. The keys are 40 bits, so they are
+ * radix-sorted, 10 bits at a time; points with equal keys stay in order.
+ */
+{
+  int i,shift;
+  double minx=INFINITY,miny=INFINITY,maxx=-INFINITY,maxy=-INFINITY,side;
+  vector<unsigned long long> keys(pnts.size()),keys1(pnts.size());
+  vector<int> ret(pnts.size()),ret1(pnts.size());
+  vector<int> count;
+  for (i=0;i<pnts.size();i++)
+  {
+    minx=min(minx,pnts[i].getx());
+    miny=min(miny,pnts[i].gety());
+    maxx=max(maxx,pnts[i].getx());
+    maxy=max(maxy,pnts[i].gety());
+  }
+  side=max(maxx-minx,maxy-miny);
+  if (!(side>0))
+    side=1; // one point, or all the same
+  for (i=0;i<pnts.size();i++)
+  {
+    keys[i]=hilbertKey(pnts[i],xy(minx,miny),side);
+    ret[i]=i;
+  }
+  for (shift=0;shift<40;shift+=10)
+  {
+    count.assign(1025,0);
+    for (i=0;i<keys.size();i++)
+      count[((keys[i]>>shift)&1023)+1]++;
+    for (i=1;i<1025;i++)
+      count[i]+=count[i-1];
+    for (i=0;i<keys.size();i++)
+    {
+      keys1[count[(keys[i]>>shift)&1023]]=keys[i];
+      ret1[count[(keys[i]>>shift)&1023]++]=ret[i];
+    }
+    keys.swap(keys1);
+    ret.swap(ret1);
+  }
+  return ret;
+}
+
+void pointlist::sortEdges()
+/* Renumbers the edges in Hilbert-curve order of their midpoints. Point
+ * numbers usually have nothing to do with where the points are, so the
+ * edges come out of tryStartPoint scattered through memory; sorting them
+ * makes the passes over the edges, and maketriangles, which makes
+ * triangles in edge order, go through memory in step with going through
+ * the TIN. Does not touch the triangles, so call it before maketriangles.
+ * divideConquerTin numbers the edges in this order to begin with.
+ */
+{
+  int i;
+  vector<xy> midpoints;
+  vector<int> order;
+  unordered_map<edge *,edge *> newaddr;
+  Arena<edge> sorted;
+  ptlist::iterator j;
+  for (i=0;i<edges.size();i++)
+    midpoints.push_back(edges[i].midpoint());
+  order=hilbertSort(midpoints);
+  newaddr.reserve(order.size());
+  for (i=0;i<order.size();i++)
+  {
+    sorted[i]=edges[order[i]];
+    newaddr[&edges[order[i]]]=&sorted[i];
+  }
+  for (i=0;i<sorted.size();i++)
+  {
+    sorted[i].nexta=newaddr[sorted[i].nexta];
+    sorted[i].nextb=newaddr[sorted[i].nextb];
+  }
+  for (j=points.begin();j!=points.end();j++)
+    if (j->line)
+      j->line=newaddr[j->line];
+  edges.swap(sorted);
+}
+
+int pointlist::parallelFlipPass()
+/* Decides in parallel which edges should be flipped. Then, going through
+ * them in order, picks those whose quadrilaterals share no corner with one
+ * already picked, and flips them in parallel. Flipping an edge changes only
+ * the links around the corners of its quadrilateral, so flips that share no
+ * corner can't interfere with each other, and whether one should be flipped
+ * doesn't depend on whether the other was. The edges not picked are left
+ * for the next pass. Returns the number of edges flipped.
+ */
+{
+  int i,n=edges.size();
+  vector<edge *> eptr(n);
+  vector<char> want(n);
+  vector<int> picked;
+  unordered_set<point *> used;
+  point *corner[4];
+  for (i=0;i<n;i++)
+    eptr[i]=&edges[i];
+  parallelFor(n,[&](int begin,int end,int th)
+  {
+    int j;
+    for (j=begin;j<end;j++)
+      want[j]=shouldFlip(*eptr[j]);
+  });
+  for (i=0;i<n;i++)
+    if (want[i])
+    {
+      corner[0]=eptr[i]->a;
+      corner[1]=eptr[i]->b;
+      corner[2]=eptr[i]->nexta->otherend(corner[0]);
+      corner[3]=eptr[i]->nextb->otherend(corner[1]);
+      if (used.count(corner[0]) || used.count(corner[1]) ||
+          used.count(corner[2]) || used.count(corner[3]))
+        continue;
+      used.insert(corner,corner+4);
+      picked.push_back(i);
+    }
+  parallelFor(picked.size(),[&](int begin,int end,int th)
+  {
+    int j;
+    for (j=begin;j<end;j++)
+      eptr[picked[j]]->flip(this);
+  });
+  return picked.size();
+}
+
+int pointlist::maketin(string filename,bool colorfibaster,int engine,bool spatialSort)
 /* Makes a triangulated irregular network. If <3 points, throws noTriangle without altering
  * the existing TIN. If two points are equal, or close enough to likely cause problems,
  * throws samePoints; the TIN is partially constructed and will have to be destroyed.
+ * engine is TIN_DIVCONQ, TIN_FLIP, or TIN_PARFLIP, which is TIN_FLIP with
+ * the flipping done in parallel. All make a Delaunay TIN, then insert the
+ * type-0 breaklines with insertBreaklines, splitting a segment at any point
+ * on it, so no flipping is needed to enforce them.
+ * If spatialSort, the edges are numbered along a Hilbert curve before flipping.
+ * Returns the number of edges flipped.
  */
 {
   ptlist::iterator i;
@@ -938,16 +1129,17 @@ void pointlist::maketin(string filename,bool colorfibaster)
     throw BeziExcept(noTriangle);
   startpnt=xy(0,0);
   for (i=points.begin();i!=points.end();i++)
-    startpnt+=i->second;
+    startpnt+=*i;
   startpnt/=points.size();
   edges.clear();
-  splitBreaklines();
+  break0.clear();
+  break0Grid.clear();
   /* startpnt has to be within or out the side of the triangle formed
    * by the three nearest points. In a 100-point asteraceous pattern,
    * the centroid is out one corner, and the first triangle is drawn
    * negative, with point 0 connected wrong.
    */
-  startpnt=points.begin()->second;
+  startpnt=*points.begin();
   if (filename.length())
   {
     ps.open(filename);
@@ -955,14 +1147,19 @@ void pointlist::maketin(string filename,bool colorfibaster)
     ps.prolog();
     ps.setPointlist(*this);
   }
-  for (m2=0,fail=true;m2<100 && fail;m2++)
-    fail=tryStartPoint(ps,startpnt);
-  if (fail)
+  if (engine==TIN_DIVCONQ)
+    divideConquerTin(spatialSort);
+  else
   {
-    throw BeziExcept(flatTriangle);
-    /* Failing to make a proper TIN, after trying a hundred start points,
-     * normally means that all triangles are flat.
-     */
+    for (m2=0,fail=true;m2<100 && fail;m2++)
+      fail=tryStartPoint(ps,startpnt);
+    if (fail)
+    {
+      throw BeziExcept(flatTriangle);
+      /* Failing to make a proper TIN, after trying a hundred start points,
+       * normally means that all triangles are flat.
+       */
+    }
   }
   if (ps.isOpen())
   {
@@ -972,6 +1169,8 @@ void pointlist::maketin(string filename,bool colorfibaster)
     ps.dot(startpnt);
     ps.endpage();
   }
+  if (spatialSort && engine!=TIN_DIVCONQ)
+    sortEdges();
   flipcount=passcount=0;
   //debugdel=1;
   /* The flipping algorithm can take quadratic time, but usually does not
@@ -981,14 +1180,33 @@ void pointlist::maketin(string filename,bool colorfibaster)
    * around 13 points forever. To stop this, I put a cap on the number of passes.
    * The worst cases are ring with lots of rotation and ellipse. They take about
    * 280 passes for 1000 points. I think that a cap of 1 pass per 3 points is
-   * reasonable.
+   * reasonable. After divideConquerTin, the edges are already Delaunay.
    */
-  flipcount=passcount=0;
-  do
-  {
-    flipcount+=m=flipPass(ps,colorfibaster);
-    passcount++;
-  } while (m && passcount*3<=points.size());
+  /* When there are many edges to flip, flip them in parallel. When there
+   * are few, most of a parallel pass is spent deciding not to flip edges,
+   * so finish serially.
+   */
+  if (engine==TIN_PARFLIP)
+    do
+    {
+      flipcount+=m=parallelFlipPass();
+      passcount++;
+    } while (m>edges.size()/64 && passcount*3<=points.size());
+  if (engine!=TIN_DIVCONQ)
+    do
+    {
+      flipcount+=m=flipPass(ps,colorfibaster);
+      passcount++;
+    } while (m && passcount*3<=points.size());
+  /* The TIN is now Delaunay without regard to breaklines. The edges'
+   * breakline bits were computed with no breaklines, so clear them, then
+   * insert the breaklines, which sets the bits of their edges; the others
+   * are recomputed when needed.
+   */
+  splitBreaklines();
+  for (m=0;m<edges.size();m++)
+    edges[m].broken&=~7;
+  insertBreaklines();
   //printf("Total %d edges flipped in %d passes\n",flipcount,passcount);
   if (ps.isOpen())
   {
@@ -999,81 +1217,204 @@ void pointlist::maketin(string filename,bool colorfibaster)
     ps.trailer();
     ps.close();
   }
+  return flipcount;
 }
 
-void pointlist::makegrad(double corr)
-// Compute the gradient at each point.
-// corr is a correlation factor which is how much the slope
-// at one end of an edge affects the slope at the other.
+void fitGradient(point *pnt,double corr)
+/* Sets pnt->newgradient to the slope of the plane fitted to pnt and its
+ * neighbors, reading only the current gradients, so that it can be done
+ * on many points at once.
+ */
 {
-  ptlist::iterator i;
-  int n,m;
+  int m;
   edge *e;
   double zdiff,zxtrap,zthere;
   xy gradthere,diff;
   double sum1,sumx,sumy,sumz,sumxx,sumxy,sumxz,sumzz,sumyy,sumyz;
+  sum1=sumx=sumy=sumz=sumxx=sumxy=sumxz=sumzz=sumyy=sumyz=0;
+  for (m=0,e=pnt->line;m==0 || e!=pnt->line;m++,e=e->next(pnt))
+  if (!(e->broken&8))
+  {
+    gradthere=e->otherend(pnt)->gradient;
+    diff=(xy)(*e->otherend(pnt))-(xy)*pnt;
+    zdiff=e->otherend(pnt)->elev()-pnt->elev();
+    zxtrap=zdiff-dot(gradthere,diff);
+    zthere=zdiff+corr*zxtrap;
+    sum1+=1;
+    sumx+=diff.east();
+    sumy+=diff.north();
+    sumz+=zthere;
+    sumxx+=diff.east()*diff.east();
+    sumyy+=diff.north()*diff.north();
+    sumzz+=zthere*zthere;
+    sumxy+=diff.east()*diff.north();
+    sumxz+=diff.east()*zthere;
+    sumyz+=diff.north()*zthere;
+  }
+  //printf("point %d sum1=%f zdiff=%f zthere=%f\n",pnt->num,sum1,zdiff,zthere);
+  if (sum1)
+  {
+    sum1++; //add the point i to the set
+    sumx/=sum1;
+    sumy/=sum1;
+    sumz/=sum1;
+    sumxx/=sum1;
+    sumyy/=sum1;
+    sumzz/=sum1;
+    sumxy/=sum1;
+    sumxz/=sum1;
+    sumyz/=sum1;
+    sumxx-=sumx*sumx;
+    sumyy-=sumy*sumy;
+    sumzz-=sumz*sumz;
+    sumxy-=sumx*sumy;
+    sumxz-=sumx*sumz;
+    sumyz-=sumy*sumz;
+    /* Gradient is computed by this matrix equation:
+    (xx xy)   (gradx)
+    (     ) × (     ) = (xz yz)
+    (xy yy)   (grady) */
+    pnt->newgradient=xy(sumxz/sumxx,sumyz/sumyy);
+    /*if (pnt->num==63)
+    printf("sumxz %f sumxx %f sumyz %f sumyy %f\n",sumxz,sumxx,sumyz,sumyy);*/
+  }
+  else
+    fprintf(stderr,"Warning: point at address %p has no edges that don't cross breaklines\n",static_cast<void*>(pnt));
+}
+
+int pointlist::makegrad(double corr,double tolerance,int maxSweeps)
+/* Compute the gradient at each point.
+ * corr is a correlation factor which is how much the slope
+ * at one end of an edge affects the slope at the other.
+ * Each sweep computes every point's gradient from its neighbors' gradients
+ * in the previous sweep, so the points are done in parallel. Stops when no
+ * gradient changes by more than tolerance, or after maxSweeps sweeps, and
+ * returns the number of sweeps. Each sweep is logged in gradLog.
+ */
+{
+  ptlist::iterator i;
+  vector<point *> pts;
+  vector<double> threadMax(threadCount());
+  GradLogEntry entry;
+  int n,j;
+  chrono::steady_clock::time_point start;
+  gradLog.clear();
+  gradCorr=corr;
   for (i=points.begin();i!=points.end();i++)
-    i->second.gradient=xy(0,0);
-  for (n=0;n<10;n++)
   {
-    for (i=points.begin();i!=points.end();i++)
+    i->gradient=xy(0,0);
+    pts.push_back(&*i);
+  }
+  for (n=0;n<maxSweeps;)
+  {
+    start=chrono::steady_clock::now();
+    for (j=0;j<threadMax.size();j++)
+      threadMax[j]=0;
+    parallelFor(pts.size(),[&](int begin,int end,int thread)
     {
-      //i->second.gradient=xy(0,0);
-      sum1=sumx=sumy=sumz=sumxx=sumxy=sumxz=sumzz=sumyy=sumyz=0;
-      for (m=0,e=i->second.line;m==0 || e!=i->second.line;m++,e=e->next(&i->second))
-      if (!(e->broken&8))
-      {
-	gradthere=e->otherend(&i->second)->gradient;
-	diff=(xy)(*e->otherend(&i->second))-(xy)i->second;
-	zdiff=e->otherend(&i->second)->elev()-i->second.elev();
-	zxtrap=zdiff-dot(gradthere,diff);
-	zthere=zdiff+corr*zxtrap;
-	sum1+=1;
-	sumx+=diff.east();
-	sumy+=diff.north();
-	sumz+=zthere;
-	sumxx+=diff.east()*diff.east();
-	sumyy+=diff.north()*diff.north();
-	sumzz+=zthere*zthere;
-	sumxy+=diff.east()*diff.north();
-	sumxz+=diff.east()*zthere;
-	sumyz+=diff.north()*zthere;
-      }
-      //printf("point %d sum1=%f zdiff=%f zthere=%f\n",i->first,sum1,zdiff,zthere);
-      if (sum1)
+      int k;
+      for (k=begin;k<end;k++)
+        fitGradient(pts[k],corr);
+    });
+    parallelFor(pts.size(),[&](int begin,int end,int thread)
+    {
+      int k;
+      for (k=begin;k<end;k++)
       {
-	sum1++; //add the point i to the set
-	sumx/=sum1;
-	sumy/=sum1;
-	sumz/=sum1;
-	sumxx/=sum1;
-	sumyy/=sum1;
-	sumzz/=sum1;
-	sumxy/=sum1;
-	sumxz/=sum1;
-	sumyz/=sum1;
-	sumxx-=sumx*sumx;
-	sumyy-=sumy*sumy;
-	sumzz-=sumz*sumz;
-	sumxy-=sumx*sumy;
-	sumxz-=sumx*sumz;
-	sumyz-=sumy*sumz;
-	/* Gradient is computed by this matrix equation:
-	(xx xy)   (gradx)
-	(     ) × (     ) = (xz yz)
-	(xy yy)   (grady) */
-	i->second.newgradient=xy(sumxz/sumxx,sumyz/sumyy);
-	/*if (i->first==63)
-	printf("sumxz %f sumxx %f sumyz %f sumyy %f\n",sumxz,sumxx,sumyz,sumyy);*/
+        pts[k]->oldgradient=pts[k]->gradient;
+        pts[k]->gradient=pts[k]->newgradient;
+        threadMax[thread]=max(threadMax[thread],dist(pts[k]->gradient,pts[k]->oldgradient));
       }
-      else
-	fprintf(stderr,"Warning: point at address %p has no edges that don't cross breaklines\n",static_cast<void*>(&i->second));
+    });
+    n++;
+    entry.maxChange=*max_element(threadMax.begin(),threadMax.end());
+    entry.seconds=chrono::duration<double>(chrono::steady_clock::now()-start).count();
+    gradLog.push_back(entry);
+    if (entry.maxChange<=tolerance)
+      break;
+  }
+  return n;
+}
+
+void pointlist::resurface(vector<triangle *> &changed,vector<point *> moved)
+/* After editing the TIN, refits the gradients at the corners of the changed
+ * triangles and at the moved points, then redoes the control points, edge
+ * extrema, critical points, and subdivisions of the triangles touching them,
+ * and adds those triangles to the dirty region. The gradients are fit as by
+ * makegrad, holding the gradients elsewhere fixed.
+ */
+{
+  int i,j,n;
+  double maxChange;
+  edge *e;
+  triangle *t;
+  unordered_set<point *> pointSet;
+  unordered_set<triangle *> triSet;
+  unordered_set<edge *> edgeSet;
+  vector<point *> pts;
+  vector<triangle *> tris;
+  vector<edge *> sides;
+  for (i=0;i<changed.size();i++)
+  {
+    moved.push_back(changed[i]->a);
+    moved.push_back(changed[i]->b);
+    moved.push_back(changed[i]->c);
+  }
+  for (i=0;i<moved.size();i++)
+    if (pointSet.insert(moved[i]).second)
+      pts.push_back(moved[i]);
+  for (i=0;i<pts.size();i++)
+    for (j=0,e=pts[i]->line;e && (j==0 || e!=pts[i]->line);j++,e=e->next(pts[i]))
+    {
+      if (e->tria && triSet.insert(e->tria).second)
+        tris.push_back(e->tria);
+      if (e->trib && triSet.insert(e->trib).second)
+        tris.push_back(e->trib);
     }
-    for (i=points.begin();i!=points.end();i++)
+  for (i=0;i<tris.size();i++)
+  {
+    t=tris[i];
+    e=findEdge(t->a,t->b);
+    if (edgeSet.insert(e).second)
+      sides.push_back(e);
+    e=findEdge(t->b,t->c);
+    if (edgeSet.insert(e).second)
+      sides.push_back(e);
+    e=findEdge(t->c,t->a);
+    if (edgeSet.insert(e).second)
+      sides.push_back(e);
+  }
+  for (n=0;n<10;n++)
+  {
+    for (i=0;i<pts.size();i++)
+      fitGradient(pts[i],gradCorr);
+    for (maxChange=i=0;i<pts.size();i++)
     {
-      i->second.oldgradient=i->second.gradient;
-      i->second.gradient=i->second.newgradient;
+      pts[i]->oldgradient=pts[i]->gradient;
+      pts[i]->gradient=pts[i]->newgradient;
+      maxChange=max(maxChange,dist(pts[i]->gradient,pts[i]->oldgradient));
     }
+    if (maxChange<=1e-9)
+      break;
+  }
+  for (i=0;i<tris.size();i++)
+  {
+    t=tris[i];
+    t->setgradient(*t->a,t->a->gradient);
+    t->setgradient(*t->b,t->b->gradient);
+    t->setgradient(*t->c,t->c->gradient);
+    t->setcentercp();
+  }
+  for (i=0;i<sides.size();i++)
+    sides[i]->findextrema();
+  for (i=0;i<tris.size();i++)
+  {
+    t=tris[i];
+    t->findcriticalpts();
+    t->subdivide();
+    dirtyRegion.include(*t->a);
+    dirtyRegion.include(*t->b);
+    dirtyRegion.include(*t->c);
   }
 }
 
@@ -1087,6 +1428,7 @@ void pointlist::maketriangles()
   edge *e;
   triangle cib,*t;
   triangles.clear();
+  contourTriangles.clear();
   for (i=0;i<edges.size();i++)
   {
     a=edges[i].a;
@@ -1137,40 +1479,87 @@ void pointlist::maketriangles()
     edges[i].setNeighbors();
 }
 
+struct xyHash
+/* Hashes the coordinates, so that corners of triangles read from a file
+ * can be welded into points. 0.0 is added so that -0 hashes like 0.
+ */
+{
+  size_t operator()(const xy &pnt) const
+  {
+    hash<double> h;
+    return h(pnt.east()+0.)*0x9e3779b1^h(pnt.north()+0.);
+  }
+};
+
+struct PointPairHash
+{
+  size_t operator()(const array<point *,2> &ends) const
+  {
+    hash<point *> h;
+    return h(ends[0])*0x9e3779b1^h(ends[1]);
+  }
+};
+
+struct Spoke
+// An edge seen from one end, for sorting the edges around a point by bearing.
+{
+  point *end;
+  int bearing;
+  edge *spoke;
+  Spoke(point *e,int b,edge *s)
+  {
+    end=e;
+    bearing=b;
+    spoke=s;
+  }
+  bool operator<(const Spoke &r) const
+  {
+    less<point *> lt;
+    if (end!=r.end)
+      return lt(end,r.end);
+    return bearing<r.bearing;
+  }
+};
+
 void pointlist::makeBareTriangles(vector<array<xyz,3> > bareTriangles)
 /* Assigns point numbers to the corners of the triangles. Makes a qindex and
  * a map of triangles, but no edges. Can throw samePoints or badData.
+ * Corners are welded into points by looking up their horizontal coordinates
+ * in a hash table; each corner occurs in about six triangles. Corners that
+ * differ only in elevation are welded, and the point gets the elevation of
+ * the first.
  */
 {
   int i,j;
   vector<xy> corners;
+  unordered_map<xy,point *,xyHash> welded;
+  unordered_map<xy,point *,xyHash>::iterator k;
   point *pont[3];
   triangle newtri;
   clear();
   for (i=0;i<bareTriangles.size();i++)
     for (j=0;j<3;j++)
-    {
       if (outOfGeoRange(bareTriangles[i][j].east(),
 			bareTriangles[i][j].north(),
 			bareTriangles[i][j].elev()))
 	throw BeziExcept(badData);
-      corners.push_back(bareTriangles[i][j]);
-    }
-  qinx.sizefit(corners);
-  qinx.split(corners);
+  welded.reserve(bareTriangles.size());
   for (i=0;i<bareTriangles.size();i++)
   {
     if (area3(bareTriangles[i][0],bareTriangles[i][1],bareTriangles[i][2])<0)
       swap(bareTriangles[i][0],bareTriangles[i][2]);
     for (j=0;j<3;j++)
     {
-      pont[j]=qinx.findp(bareTriangles[i][j]);
-      if (!pont[j])
+      k=welded.find(bareTriangles[i][j]);
+      if (k==welded.end())
       {
 	addpoint(1,point(bareTriangles[i][j],""));
 	pont[j]=&points[points.size()];
-	qinx.insertPoint(pont[j]);
+	welded[bareTriangles[i][j]]=pont[j];
+	corners.push_back(bareTriangles[i][j]);
       }
+      else
+	pont[j]=k->second;
     }
     newtri.a=pont[0];
     newtri.b=pont[1];
@@ -1178,6 +1567,8 @@ void pointlist::makeBareTriangles(vector<array<xyz,3> > bareTriangles)
     newtri.flatten();
     triangles[triangles.size()]=newtri;
   }
+  qinx.sizefit(corners);
+  qinx.split(corners);
   qinx.clearLeaves();
 }
 
@@ -1308,59 +1699,89 @@ void pointlist::triangulatePolygon(vector<point *> poly)
 void pointlist::makeEdges()
 /* The points and triangles are present, but the edges are not, or some
  * triangles have been added to make the TIN convex, but their edges haven't.
- * Add the edges.
+ * Add the edges. Edges are looked up by their ends in a hash table, then
+ * the edges around each point that got a new one are sorted by bearing and
+ * linked, so this takes linear time, however many edges a point has.
  */
 {
-  int i;
+  int i,j,n;
   edge newedge;
   edge *edg;
+  point *corners[3];
+  array<point *,2> ends;
+  unordered_map<array<point *,2>,edge *,PointPairHash> edgeMap;
+  unordered_map<array<point *,2>,edge *,PointPairHash>::iterator k;
+  unordered_set<point *> oldFans;
+  vector<edge *> newEdges;
+  vector<Spoke> spokes;
+  less<point *> lt;
   //dumptriangles();
+  edgeMap.reserve(edges.size()+triangles.size()*3/2);
+  for (i=0;i<edges.size();i++)
+  {
+    ends={edges[i].a,edges[i].b};
+    if (lt(ends[1],ends[0]))
+      swap(ends[0],ends[1]);
+    edgeMap[ends]=&edges[i];
+  }
   for (i=0;i<triangles.size();i++)
   {
     if (triangles[i].sarea<1e-6)
       cerr<<"tiny triangle "<<triangles[i].a<<' '<<triangles[i].b<<' '<<triangles[i].c<<'\n';
-    if (!triangles[i].a->isNeighbor(triangles[i].b))
-    {
-      newedge.a=triangles[i].a;
-      newedge.b=triangles[i].b;
-      edges[edges.size()]=newedge;
-      triangles[i].a->insertEdge(&edges[edges.size()-1]);
-      triangles[i].b->insertEdge(&edges[edges.size()-1]);
-    }
-    if (!triangles[i].b->isNeighbor(triangles[i].c))
+    corners[0]=triangles[i].a;
+    corners[1]=triangles[i].b;
+    corners[2]=triangles[i].c;
+    for (j=0;j<3;j++)
     {
-      newedge.a=triangles[i].b;
-      newedge.b=triangles[i].c;
-      edges[edges.size()]=newedge;
-      triangles[i].b->insertEdge(&edges[edges.size()-1]);
-      triangles[i].c->insertEdge(&edges[edges.size()-1]);
+      ends={corners[j],corners[(j+1)%3]};
+      if (lt(ends[1],ends[0]))
+	swap(ends[0],ends[1]);
+      k=edgeMap.find(ends);
+      if (k==edgeMap.end())
+      {
+	newedge.a=corners[j];
+	newedge.b=corners[(j+1)%3];
+	edges[edges.size()]=newedge;
+	edg=&edges[edges.size()-1];
+	edgeMap[ends]=edg;
+	newEdges.push_back(edg);
+      }
+      else
+	edg=k->second;
+      if (edg->a==corners[j])
+	edg->trib=&triangles[i];
+      else
+	edg->tria=&triangles[i];
+      edg->setNeighbors();
     }
-    if (!triangles[i].c->isNeighbor(triangles[i].a))
+  }
+  for (i=0;i<newEdges.size();i++)
+  {
+    spokes.push_back(Spoke(newEdges[i]->a,newEdges[i]->bearing(newEdges[i]->a),newEdges[i]));
+    spokes.push_back(Spoke(newEdges[i]->b,newEdges[i]->bearing(newEdges[i]->b),newEdges[i]));
+    for (j=0;j<2;j++)
     {
-      newedge.a=triangles[i].c;
-      newedge.b=triangles[i].a;
-      edges[edges.size()]=newedge;
-      triangles[i].c->insertEdge(&edges[edges.size()-1]);
-      triangles[i].a->insertEdge(&edges[edges.size()-1]);
+      corners[0]=j?newEdges[i]->b:newEdges[i]->a;
+      if (corners[0]->line && oldFans.insert(corners[0]).second)
+      {
+	edg=corners[0]->line;
+	do
+	{
+	  spokes.push_back(Spoke(corners[0],edg->bearing(corners[0]),edg));
+	  edg=edg->next(corners[0]);
+	} while (edg!=corners[0]->line);
+      }
     }
-    edg=triangles[i].a->isNeighbor(triangles[i].b);
-    if (edg->a==triangles[i].a)
-      edg->trib=&triangles[i];
-    else
-      edg->tria=&triangles[i];
-    edg->setNeighbors();
-    edg=triangles[i].b->isNeighbor(triangles[i].c);
-    if (edg->a==triangles[i].b)
-      edg->trib=&triangles[i];
-    else
-      edg->tria=&triangles[i];
-    edg->setNeighbors();
-    edg=triangles[i].c->isNeighbor(triangles[i].a);
-    if (edg->a==triangles[i].c)
-      edg->trib=&triangles[i];
-    else
-      edg->tria=&triangles[i];
-    edg->setNeighbors();
+  }
+  sort(spokes.begin(),spokes.end());
+  for (i=0;i<spokes.size();i=j)
+  {
+    for (j=i+1;j<spokes.size() && spokes[j].end==spokes[i].end;j++)
+      if (spokes[j].bearing==spokes[j-1].bearing)
+	throw BeziExcept(flatTriangle);
+    for (n=i;n<j;n++)
+      spokes[n].spoke->setnext(spokes[n].end,spokes[(n+1<j)?n+1:i].spoke);
+    spokes[i].end->line=spokes[i].spoke;
   }
 }
 
@@ -1374,11 +1795,8 @@ void pointlist::deleteOrphanPoints()
   ptlist::iterator j;
   int i;
   for (j=points.begin();j!=points.end();j++)
-    if (j->second.line==nullptr)
-    {
-      delenda.push_back(j->first);
-      revpoints.erase(&j->second);
-    }
+    if (j->line==nullptr)
+      delenda.push_back(j->num);
   for (i=0;i<delenda.size();i++)
     points.erase(delenda[i]);
 }
@@ -1419,9 +1837,9 @@ void pointlist::fillInBareTin()
 double pointlist::totalEdgeLength()
 {
   vector<double> edgeLengths;
-  map<int,edge>::iterator i;
-  for (i=edges.begin();i!=edges.end();i++)
-    edgeLengths.push_back(i->second.length());
+  int i;
+  for (i=0;i<edges.size();i++)
+    edgeLengths.push_back(edges[i].length());
   return pairwisesum(edgeLengths);
 }
 
@@ -67,6 +67,7 @@ public:
    * when writing an STL file.
    */
   short flipcnt;
+  unsigned int localMark; // equals pointlist::localEpoch if the edge is in localEdges
   edge();
   void flip(pointlist *topopoints);
   void reverse();
@@ -85,6 +86,7 @@ public:
   double length();
   segment getsegment();
   std::array<double,4> ctrlpts();
+  std::array<double,2> elevRange();
   xyz critpoint(int i);
   void findextrema();
   void clearmarks();
@@ -95,4 +97,7 @@ public:
 
 typedef std::pair<double,point*> ipoint;
 
+unsigned long long hilbertKey(xy pnt,xy corner,double side);
+std::vector<int> hilbertSort(const std::vector<xy> &pnts);
+
 #endif
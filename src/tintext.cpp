@@ -147,9 +147,9 @@ void writeTinText(string outputFile,pointlist &pl,double outUnit,int flags)
   for (i=0;i<pl.triangles.size();i++)
     if (pl.shouldWrite(i,flags,false))
     {
-      tinFile<<pl.revpoints[pl.triangles[i].a]<<' ';
-      tinFile<<pl.revpoints[pl.triangles[i].b]<<' ';
-      tinFile<<pl.revpoints[pl.triangles[i].c]<<'\n';
+      tinFile<<pl.triangles[i].a->num<<' ';
+      tinFile<<pl.triangles[i].b->num<<' ';
+      tinFile<<pl.triangles[i].c->num<<'\n';
     }
   tinFile<<"ENDT\n";
 }
@@ -32,6 +32,7 @@
 #include "color.h"
 #include "penwidth.h"
 #include "dxf.h"
+#include "threads.h"
 
 #define CACHEDRAW
 
@@ -590,7 +591,7 @@ void TopoCanvas::makeTin()
   if (doc.pl[plnum].size()<3)
     tinerror=notri;
   else
-    startPoint=doc.pl[1].points.begin()->second;
+    startPoint=*doc.pl[1].points.begin();
   if (makeTinCheckEdited())
   {
     try
@@ -809,6 +810,8 @@ void TopoCanvas::roughContours()
   if (tinValid)
     tinlohi=doc.pl[plnum].lohi();
   doc.pl[plnum].contours.clear();
+  doc.pl[plnum].contourTriangles.clear();
+  doc.pl[plnum].contourPyramids.clear();
   elevLo=floor(tinlohi[0]/conterval);
   elevHi=ceil(tinlohi[1]/conterval);
   progInx=elevLo;
@@ -830,7 +833,17 @@ void TopoCanvas::roughContours()
 
 void TopoCanvas::rough1Contour()
 {
-  rough1contour(doc.pl[plnum],progInx*conterval);
+  vector<polyline> ctours;
+  int i;
+  if (progInx==elevLo)
+  {
+    elevIndex.build(doc.pl[plnum]);
+    contourMarks.setup(doc.pl[plnum]);
+  }
+  rough1contour(doc.pl[plnum],progInx*conterval,ctours,contourMarks,&elevIndex,
+                &doc.pl[plnum].contourTriangles);
+  for (i=0;i<ctours.size();i++)
+    doc.pl[plnum].contours.push_back(ctours[i]);
   if (++progInx>elevHi)
   {
     disconnect(timer,SIGNAL(timeout()),this,SLOT(rough1Contour()));
@@ -878,6 +891,7 @@ void TopoCanvas::smoothContours()
     progressDialog->show();
   }
   progInx=0;
+  doc.pl[plnum].contourPyramids.clear();
   progressDialog->setRange(0,doc.pl[plnum].contours.size());
   progressDialog->setValue(0);
   progressDialog->setWindowTitle(tr("Drawing contours"));
@@ -897,10 +911,13 @@ void TopoCanvas::smoothContours()
 
 void TopoCanvas::smooth1Contour()
 {
+  int end;
   if (progInx<doc.pl[plnum].contours.size())
   {
-    smooth1contour(doc.pl[plnum],conterval,progInx,contoursShouldBeCurvy,dummyPs,0,0,0,0);
-    progressDialog->setValue(++progInx);
+    end=min<int>(progInx+threadCount(),doc.pl[plnum].contours.size());
+    smoothcontours(doc.pl[plnum],conterval,progInx,end,contoursShouldBeCurvy,false);
+    progInx=end;
+    progressDialog->setValue(progInx);
   }
   else
   {
@@ -922,6 +939,8 @@ void TopoCanvas::smoothContoursFinish()
       break;
   }
   disconnect(timer,SIGNAL(timeout()),0,0);
+  buildpyramids(doc.pl[plnum],conterval*PYRAMIDBASE);
+  contourCache.clear();
   smoothContoursValid=true;
   update();
 }
@@ -991,7 +1010,7 @@ void TopoCanvas::paintEvent(QPaintEvent *event)
   double r;
   bezier3d b3d;
   ptlist::iterator j;
-  set<edge *>::iterator e;
+  vector<edge *>::iterator e;
   RenderItem ri;
   QElapsedTimer paintTime,subTime;
   QPen itemPen;
@@ -1006,7 +1025,7 @@ void TopoCanvas::paintEvent(QPaintEvent *event)
   {
     doc.pl[plnum].setLocalSets(worldCenter,viewableRadius());
     if (doc.pl[plnum].triangles.size())
-      if (doc.pl[plnum].localEdges.count(nullptr))
+      if (doc.pl[plnum].localAll())
 	for (i=0;plnum>=0 && i<doc.pl[plnum].edges.size();i++)
 	{
 	  seg=doc.pl[plnum].edges[i].getsegment();
@@ -1043,50 +1062,54 @@ void TopoCanvas::paintEvent(QPaintEvent *event)
         for (i=0;i<3;i++)
         {
           painter.setPen(circlePen[i]);
-          r=(i+1)*5+sin((double)j->first*(1<<2*i));
+          r=(i+1)*5+sin((double)j->num*(1<<2*i));
           // The radius variation is so that, if two points coincide, it's obvious.
-          painter.drawEllipse(worldToWindow(j->second),r,r);
+          painter.drawEllipse(worldToWindow(*j),r,r);
         }
 #ifdef CACHEDRAW
-    contourCache.clearPresent();
-    subTime.start();
-    for (i=0;i<doc.pl[plnum].contours.size();i++)
-    {
-      contourType=doc.pl[plnum].contourInterval.contourType(doc.pl[plnum].contours[i].getElevation());
-      contourCache.checkInObject(&doc.pl[plnum].contours[i],pixelScale(),
-                                 -1,contourColor[contourType&31],contourThickness[contourType>>8],contourLineType[contourType>>8]);
-    }
-    contourCache.deleteAbsent();
-    renderTime+=subTime.elapsed();
-    do
-    {
-      ri=contourCache.nextRenderItem();
-      for (i=0;ri.present && i<ri.rendering.size();i++)
+    if (doc.pl[plnum].contourPyramids.size()!=doc.pl[plnum].contours.size())
+    { // No pyramids, so approximating the contours at each scale is slow.
+      contourCache.clearPresent();
+      subTime.start();
+      for (i=0;i<doc.pl[plnum].contours.size();i++)
+      {
+        contourType=doc.pl[plnum].contourInterval.contourType(doc.pl[plnum].contours[i].getElevation());
+        contourCache.checkInObject(&doc.pl[plnum].contours[i],pixelScale(),
+                                   -1,contourColor[contourType&31],contourThickness[contourType>>8],contourLineType[contourType>>8]);
+      }
+      contourCache.deleteAbsent();
+      renderTime+=subTime.elapsed();
+      do
       {
-        setColor(itemPen,ri.rendering[i].color);
-        setWidth(itemPen,ri.rendering[i].width);
-        setLineType(itemPen,ri.rendering[i].linetype);
-        b3d=ri.rendering[i].path;
-        subTime.start();
-        path=QPainterPath();
-        for (k=0;k<b3d.size();k++)
+        ri=contourCache.nextRenderItem();
+        for (i=0;ri.present && i<ri.rendering.size();i++)
         {
-          beziseg=b3d[k];
-          if (k==0)
-            path.moveTo(worldToWindow(beziseg[0]));
-          path.cubicTo(worldToWindow(beziseg[1]),worldToWindow(beziseg[2]),worldToWindow(beziseg[3]));
+          setColor(itemPen,ri.rendering[i].color);
+          setWidth(itemPen,ri.rendering[i].width);
+          setLineType(itemPen,ri.rendering[i].linetype);
+          b3d=ri.rendering[i].path;
+          subTime.start();
+          path=QPainterPath();
+          for (k=0;k<b3d.size();k++)
+          {
+            beziseg=b3d[k];
+            if (k==0)
+              path.moveTo(worldToWindow(beziseg[0]));
+            path.cubicTo(worldToWindow(beziseg[1]),worldToWindow(beziseg[2]),worldToWindow(beziseg[3]));
+          }
+          if (!b3d.isopen())
+            path.closeSubpath();
+          pathTime+=subTime.restart();
+          painter.strokePath(path,itemPen);
+          strokeTime+=subTime.elapsed();
         }
-        if (!b3d.isopen())
-          path.closeSubpath();
-        pathTime+=subTime.restart();
-        painter.strokePath(path,itemPen);
-        strokeTime+=subTime.elapsed();
-      }
-    } while (ri.present);
-#else
+      } while (ri.present);
+    }
+    else
+#endif
     for (i=0;i<doc.pl[plnum].contours.size();i++)
     {
-      b3d=doc.pl[plnum].contours[i].approx3d(pixelScale());
+      b3d=doc.pl[plnum].contourApprox(i,pixelScale());
       path=QPainterPath();
       for (k=0;k<b3d.size();k++)
       {
@@ -1100,7 +1123,6 @@ void TopoCanvas::paintEvent(QPaintEvent *event)
       contourType=doc.pl[plnum].contourInterval.contourType(doc.pl[plnum].contours[i].getElevation());
       painter.strokePath(path,contourPen[contourType>>8][contourType&31]);
     }
-#endif
   }
   else
     ; // nothing to paint, since plnum is not the index of a pointlist
@@ -146,6 +146,8 @@ private:
   int progInx; // used in progress bar loops
   int elevHi,elevLo; // in contour interval unit
   std::array<double,2> tinlohi;
+  ElevationIndex elevIndex; // built when rough contours start
+  ContourMarks contourMarks;
   bool pointsValid; // If false, to make TIN, must first copy points.
   bool tinValid; // If false, to set gradient, must first make TIN.
   bool surfaceValid; // If false, to do rough contours, must first set gradient.